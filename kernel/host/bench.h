@@ -0,0 +1,37 @@
+/// Timing for the host benchmarks.
+#pragma once
+
+#include "shims.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace host {
+
+struct timing
+{
+    u64 best_ns;
+    u64 median_ns;
+    size_t runs;
+};
+
+/// Runs `fn` repeatedly for about `budget_ns`, and at least five times. `reset` runs after each
+/// run, outside the timed part.
+template<typename F, typename R>
+timing
+measure(F&& fn, R&& reset, u64 budget_ns)
+{
+    std::vector<u64> runs;
+    u64 start = now_ns();
+    do {
+        u64 before = now_ns();
+        fn();
+        runs.push_back(now_ns() - before);
+        reset();
+    } while (now_ns() - start < budget_ns || runs.size() < 5);
+
+    std::sort(runs.begin(), runs.end());
+    return { runs.front(), runs[runs.size() / 2], runs.size() };
+}
+
+}
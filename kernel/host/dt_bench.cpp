@@ -0,0 +1,97 @@
+/// Measures `dt::parse_from_blob` in nanoseconds per node and per property, on the QEMU virt blob
+/// and on synthetic blobs with thousands of nodes.
+///
+/// Usage: dt_bench [qemu_virt.dtb]
+
+#include "bench.h"
+#include "fdt_builder.h"
+#include "shims.h"
+
+#include <devices/device_tree.h>
+#include <devices/fdt.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+struct tree_size
+{
+    size_t nodes = 0;
+    size_t properties = 0;
+};
+
+void
+count(fdt::node node, tree_size* size)
+{
+    size->nodes++;
+    node.for_each_property([&](fdt::property) { size->properties++; });
+    node.for_each_child([&](fdt::node child) { count(child, size); });
+}
+
+/// Parses `blob` repeatedly for about `budget_ns` and prints the fastest and the median run.
+bool
+bench(const char* name, const host::blob_buffer& blob, u64 budget_ns)
+{
+    fdt::blob opened;
+    error err = fdt::blob::open(blob.data(), &opened);
+    if (err.is_err()) {
+        std::printf("%s: %s\n", name, err.str().data());
+        return false;
+    }
+    tree_size size;
+    count(opened.root(), &size);
+
+    // A first run grows the module's arrays and tables, which release() keeps for the next parse.
+    err = dt::parse_from_blob(blob.data());
+    dt::release();
+    size_t allocations = host::live_allocations();
+
+    host::timing timing =
+      host::measure([&] { err = dt::parse_from_blob(blob.data()); }, dt::release, budget_ns);
+    if (err.is_err()) {
+        std::printf("%s: %s\n", name, err.str().data());
+        return false;
+    }
+    if (host::live_allocations() != allocations) {
+        std::printf("%s: dt::release leaked %zu pmm allocations\n",
+                    name,
+                    host::live_allocations() - allocations);
+        return false;
+    }
+
+    std::printf("%-16s %8zu nodes %8zu props %6zu runs  best %9.1f us  median %9.1f us  "
+                "%7.1f ns/node  %6.1f ns/prop\n",
+                name,
+                size.nodes,
+                size.properties,
+                timing.runs,
+                timing.best_ns / 1e3,
+                timing.median_ns / 1e3,
+                static_cast<double>(timing.median_ns) / size.nodes,
+                static_cast<double>(timing.median_ns) / size.properties);
+    return true;
+}
+}
+
+int
+main(int argc, char** argv)
+{
+    host::initialize(true);
+    const char* qemu_path = argc > 1 ? argv[1] : QEMU_VIRT_DTB;
+    constexpr u64 BUDGET_NS = 500000000;
+
+    bool ok = true;
+    host::blob_buffer qemu;
+    if (host::read_file(qemu_path, &qemu)) {
+        ok &= bench("qemu_virt", qemu, BUDGET_NS);
+    } else {
+        std::printf("qemu_virt: can't read %s\n", qemu_path);
+        ok = false;
+    }
+    for (size_t devices : { 1000, 4000, 16000, 64000 }) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "synthetic-%zu", devices);
+        ok &= bench(name, host::synthetic_blob(devices), BUDGET_NS);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,74 @@
+/// Compares a cold `dt::parse_from_blob` with `dt::load_from_cache` of the image `dt::save_cache`
+/// wrote for the same blob, on the QEMU virt blob and on synthetic blobs.
+///
+/// Usage: dt_cache_bench [qemu_virt.dtb]
+
+#include "bench.h"
+#include "fdt_builder.h"
+#include "shims.h"
+
+#include <devices/device_tree.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+bool
+bench(const char* name, const host::blob_buffer& blob, u64 budget_ns)
+{
+    error err = dt::parse_from_blob(blob.data());
+    host::blob_buffer image(err.is_ok() ? dt::cache_size() : 0);
+    if (err.is_ok()) {
+        err = dt::save_cache(image.data(), image.size());
+    }
+    dt::release();
+    if (err.is_err()) {
+        std::printf("%s: %s\n", name, err.str().data());
+        return false;
+    }
+
+    host::timing cold =
+      host::measure([&] { err = dt::parse_from_blob(blob.data()); }, dt::release, budget_ns);
+    error cache_err = error();
+    host::timing cached = host::measure(
+      [&] { cache_err = dt::load_from_cache(image.data(), image.size(), blob.data()); },
+      dt::release,
+      budget_ns);
+    if (err.is_err() || cache_err.is_err()) {
+        std::printf("%s: %s\n", name, (err.is_err() ? err : cache_err).str().data());
+        return false;
+    }
+
+    std::printf("%-16s blob %8zu B  image %8zu B  cold %9.1f us  cache %9.1f us  %5.2fx\n",
+                name,
+                blob.size(),
+                image.size(),
+                cold.median_ns / 1e3,
+                cached.median_ns / 1e3,
+                static_cast<double>(cold.median_ns) / cached.median_ns);
+    return true;
+}
+}
+
+int
+main(int argc, char** argv)
+{
+    host::initialize(true);
+    const char* qemu_path = argc > 1 ? argv[1] : QEMU_VIRT_DTB;
+    constexpr u64 BUDGET_NS = 500000000;
+
+    bool ok = true;
+    host::blob_buffer qemu;
+    if (host::read_file(qemu_path, &qemu)) {
+        ok &= bench("qemu_virt", qemu, BUDGET_NS);
+    } else {
+        std::printf("qemu_virt: can't read %s\n", qemu_path);
+        ok = false;
+    }
+    for (size_t devices : { 1000, 4000, 16000 }) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "synthetic-%zu", devices);
+        ok &= bench(name, host::synthetic_blob(devices), BUDGET_NS);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,348 @@
+/// Fuzzes `dt::parse_from_blob` and, for blobs it accepts, the lookups over the parsed tree and
+/// `dt::load_from_cache` of corrupted cache images. The lazy `fdt` cursors get every blob
+/// `fdt::blob::open` accepts, and must agree with the parser.
+///
+/// Built with clang this is a libFuzzer target (`dt_fuzz corpus/`). Other compilers get a small
+/// driver instead, which mutates the QEMU blob and synthetic blobs with a fixed seed and fails if
+/// any input crashes or takes more than `MAX_NS_PER_BYTE` to parse:
+///
+///     dt_fuzz [-runs=N] [-seed=S] [files to replay...]
+
+#include "fdt_builder.h"
+#include "shims.h"
+
+#include <devices/device_tree.h>
+#include <devices/fdt.h>
+#include <riscv/isa.h>
+#include <types/hash.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace {
+/// A node found compatible, with what its `reg` decodes to.
+struct match
+{
+    u32 offset;
+    size_t reg_count;
+    fdt::reg_entry reg;
+
+    bool operator==(const match& other) const
+    {
+        return offset == other.offset && reg_count == other.reg_count &&
+               reg.address == other.reg.address && reg.size == other.reg.size;
+    }
+};
+
+match
+describe(fdt::node node)
+{
+    match m = { node.offset(), node.reg_count(), {} };
+    (void)node.reg(0, &m.reg);
+    return m;
+}
+
+/// Walks everything below `node` with the cursors, collecting the nodes compatible with
+/// `compatible` in DFS order.
+void
+walk(fdt::node node, str_view compatible, std::vector<match>* matches)
+{
+    node.for_each_property([](fdt::property prop) {
+        (void)prop.as_string();
+        prop.for_each_string([](str_view) {});
+    });
+    fdt::range_entry range;
+    for (size_t i = 0; i < node.range_count(); i++) {
+        (void)node.range(i, &range);
+    }
+    (void)node.is_enabled();
+    if (node.is_compatible(compatible)) {
+        matches->push_back(describe(node));
+    }
+    node.for_each_child([&](fdt::node child) { walk(child, compatible, matches); });
+}
+
+/// Walks the blob with the cursors. Returns false if `fdt::blob::open` accepts a blob the parser
+/// rejects, or if `find_compatible` disagrees with a plain walk of the tree.
+bool
+exercise_cursors(const u8* dtb, bool parsed)
+{
+    fdt::blob blob;
+    if (fdt::blob::open(dtb, &blob).is_err()) {
+        return !parsed;
+    }
+    for (str_view compatible : { str_view("vendor,generic"), str_view("riscv,cpu-intc"),
+                                 str_view("virtio,mmio") }) {
+        std::vector<match> walked;
+        walk(blob.root(), compatible, &walked);
+        std::vector<match> found;
+        for (fdt::node node = blob.find_compatible(compatible); node;
+             node = blob.find_compatible(compatible, node)) {
+            found.push_back(describe(node));
+        }
+        if (found != walked) {
+            return false;
+        }
+    }
+    (void)blob.find_path("/soc/pci@30000000");
+    (void)blob.find_path("/cpus/cpu@0/interrupt-controller");
+    blob.for_each_reserved_region([](paddr_t, size_t) {});
+    (void)riscv::common_isa_extensions(blob);
+    return true;
+}
+
+void
+exercise_tree()
+{
+    for (str_view compatible : { str_view("vendor,generic"), str_view("ns16550a"),
+                                 str_view("virtio,mmio"), str_view("riscv,cpu-intc") }) {
+        dt::node_list list = dt::find_compatible(compatible);
+        for (size_t i = 0; i < list.count; i++) {
+            size_t irqs = dt::interrupt_count(list[i]);
+            for (size_t irq = 0; irq < irqs; irq++) {
+                dt::interrupt_route route;
+                (void)dt::interrupt(list[i], irq, &route);
+            }
+            (void)dt::node_path(list[i]);
+        }
+    }
+    (void)dt::find_by_path("/");
+    (void)dt::find_by_path("serial0");
+    (void)dt::find_by_phandle(1);
+    dt::print_device_tree();
+}
+
+/// Saves the parsed tree, reloads it, then loads copies of the image corrupted as `input`
+/// dictates. Their checksum is patched, so that they get past it to the loader's bounds checks.
+/// Returns false if the round trip fails, or if a failed load leaves a tree behind.
+bool
+exercise_cache(const u8* dtb, const u8* input, size_t size)
+{
+    // Mirrors `cache_header`: the image checksum is the u64 at offset 8, and covers what follows.
+    constexpr size_t CHECKSUM_OFFSET = 8;
+    constexpr size_t CHECKED_FROM = CHECKSUM_OFFSET + sizeof(u64);
+
+    host::blob_buffer image(dt::cache_size());
+    if (dt::save_cache(image.data(), image.size()).is_err() ||
+        dt::load_from_cache(image.data(), image.size(), dtb).is_err()) {
+        return false;
+    }
+    exercise_tree();
+
+    u64 state = hash_details::hash_bytes(input, size);
+    host::blob_buffer corrupt(image.size());
+    for (int round = 0; round < 4; round++) {
+        std::memcpy(corrupt.data(), image.data(), image.size());
+        for (int flips = 1 + round * 2; flips > 0; flips--) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t at = CHECKED_FROM + (state >> 33) % (image.size() - CHECKED_FROM);
+            corrupt.data()[at] ^= static_cast<u8>(state >> 8) | 1;
+        }
+        u64 checksum =
+          hash_details::hash_bytes(corrupt.data() + CHECKED_FROM, image.size() - CHECKED_FROM);
+        std::memcpy(corrupt.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+
+        if (dt::load_from_cache(corrupt.data(), corrupt.size(), dtb).is_ok()) {
+            exercise_tree();
+        } else if (dt::find_by_path("/") != nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+extern "C" int
+LLVMFuzzerTestOneInput(const u8* data, size_t size)
+{
+    static bool initialized = (host::initialize(true), true);
+    (void)initialized;
+    if (size < sizeof(fdt::header)) {
+        return 0;
+    }
+
+    // The parser trusts `total_size` for how far it may read, so it must match the input.
+    host::blob_buffer dtb(size);
+    std::memcpy(dtb.data(), data, size);
+    u32 total_size = num::flip_endianness(static_cast<u32>(size));
+    std::memcpy(dtb.data() + offsetof(fdt::header, total_size), &total_size, sizeof(u32));
+
+    bool parsed = dt::parse_from_blob(dtb.data()).is_ok();
+    if (parsed) {
+        exercise_tree();
+        if (!exercise_cache(dtb.data(), data, size)) {
+            __builtin_trap();
+        }
+    }
+    dt::release();
+    if (!exercise_cursors(dtb.data(), parsed)) {
+        __builtin_trap();
+    }
+    return 0;
+}
+
+#if !defined(HOST_LIBFUZZER)
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+/// Parsing is linear in the blob size, a quadratic or exponential path stands out by orders of
+/// magnitude over this.
+constexpr double MAX_NS_PER_BYTE = 2000;
+/// Inputs faster than this are never flagged, the clock and the first allocations dominate them.
+constexpr u64 MIN_FLAGGED_NS = 2000000;
+
+class xorshift
+{
+public:
+    explicit xorshift(u64 seed)
+      : m_state(seed == 0 ? 1 : seed)
+    {
+    }
+
+    u64 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state;
+    }
+
+    size_t below(size_t bound) { return bound == 0 ? 0 : next() % bound; }
+
+private:
+    u64 m_state;
+};
+
+void
+mutate(xorshift* rng, std::vector<u8>* input)
+{
+    static constexpr u32 INTERESTING[] = { 0,          1,          2,          3,
+                                           4,          9,          0x10,       0x7f,
+                                           0x80,       0xffff,     0x7fffffff, 0x80000000,
+                                           0xfffffffc, 0xffffffff };
+    size_t mutations = 1 + rng->below(8);
+    for (size_t i = 0; i < mutations && input->size() >= sizeof(fdt::header); i++) {
+        u8* bytes = input->data();
+        size_t size = input->size();
+        size_t at = rng->below(size);
+        size_t cell = at & ~(sizeof(u32) - 1);
+        switch (rng->below(6)) {
+        case 0:
+            bytes[at] ^= static_cast<u8>(1 << rng->below(8));
+            break;
+        case 1:
+            bytes[at] = static_cast<u8>(rng->next());
+            break;
+        case 2:
+        case 3:
+            if (cell + sizeof(u32) <= size) {
+                u32 value = rng->below(4) == 0
+                              ? static_cast<u32>(rng->below(size))
+                              : INTERESTING[rng->below(sizeof(INTERESTING) / sizeof(u32))];
+                value = num::flip_endianness(value);
+                std::memcpy(bytes + cell, &value, sizeof(u32));
+            }
+            break;
+        case 4: {
+            // Copies a cell aligned chunk elsewhere, which splices whole tokens and properties.
+            size_t from = rng->below(size) & ~(sizeof(u32) - 1);
+            size_t length = std::min<size_t>(rng->below(64), size - std::max(from, cell));
+            std::memmove(bytes + cell, bytes + from, length);
+            break;
+        }
+        default:
+            input->resize(std::max(sizeof(fdt::header), size - rng->below(64)));
+            break;
+        }
+    }
+}
+
+/// Runs one input, returns false if it took too long.
+bool
+run(const std::vector<u8>& input)
+{
+    u64 best = ~u64(0);
+    // Retried once before flagging, so a preempted run doesn't fail the test.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        u64 before = host::now_ns();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+        best = std::min(best, host::now_ns() - before);
+        if (best < MIN_FLAGGED_NS || best < MAX_NS_PER_BYTE * input.size()) {
+            return true;
+        }
+    }
+    std::printf("slow input: %zu bytes took %llu ns\n",
+                input.size(),
+                static_cast<unsigned long long>(best));
+    return false;
+}
+
+bool
+replay(const char* path)
+{
+    host::blob_buffer file;
+    if (!host::read_file(path, &file)) {
+        std::printf("can't read %s\n", path);
+        return false;
+    }
+    return run(std::vector<u8>(file.data(), file.data() + file.size()));
+}
+
+std::vector<u8>
+to_vector(const host::blob_buffer& blob)
+{
+    return std::vector<u8>(blob.data(), blob.data() + blob.size());
+}
+}
+
+int
+main(int argc, char** argv)
+{
+    size_t runs = 20000;
+    u64 seed = 0x5eed;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = std::strtoull(argv[i] + 6, nullptr, 0);
+        } else if (std::strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = std::strtoull(argv[i] + 6, nullptr, 0);
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (!files.empty()) {
+        bool ok = true;
+        for (const char* path : files) {
+            ok &= replay(path);
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::vector<std::vector<u8>> seeds;
+    host::blob_buffer qemu;
+    if (!host::read_file(QEMU_VIRT_DTB, &qemu)) {
+        std::printf("can't read %s\n", QEMU_VIRT_DTB);
+        return EXIT_FAILURE;
+    }
+    seeds.push_back(to_vector(qemu));
+    seeds.push_back(to_vector(host::synthetic_blob(40)));
+    seeds.push_back(to_vector(host::synthetic_blob(2000)));
+
+    xorshift rng(seed);
+    size_t slow = 0;
+    for (size_t i = 0; i < runs; i++) {
+        // The big seed is mostly there to catch blow-ups, a few runs of it are enough.
+        size_t which = rng.below(64) == 0 ? 2 : rng.below(2);
+        std::vector<u8> input = seeds[which];
+        mutate(&rng, &input);
+        if (!run(input)) {
+            slow++;
+        }
+    }
+    std::printf("%zu runs, %zu slow inputs\n", runs, slow);
+    return slow == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
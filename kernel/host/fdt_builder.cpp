@@ -0,0 +1,272 @@
+#include "fdt_builder.h"
+
+#include <devices/fdt.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr u32 PLIC_PHANDLE = 1;
+constexpr u32 FIRST_INTC_PHANDLE = 2;
+constexpr u32 HARTS = 4;
+constexpr size_t DEVICES_PER_BUS = 64;
+
+void
+put_big_endian(u8* out, u32 value)
+{
+    out[0] = static_cast<u8>(value >> 24);
+    out[1] = static_cast<u8>(value >> 16);
+    out[2] = static_cast<u8>(value >> 8);
+    out[3] = static_cast<u8>(value);
+}
+
+std::string
+unit_name(const char* name, u64 address)
+{
+    char buffer[64];
+    std::snprintf(
+      buffer, sizeof(buffer), "%s@%llx", name, static_cast<unsigned long long>(address));
+    return buffer;
+}
+}
+
+void
+host::fdt_builder::push_u32(u32 value)
+{
+    size_t at = m_structs.size();
+    m_structs.resize(at + sizeof(u32));
+    put_big_endian(m_structs.data() + at, value);
+}
+
+u32
+host::fdt_builder::string_offset(std::string_view name)
+{
+    // Reuses names already in the table, as dtc does, which keeps big blobs' strings block small.
+    std::string key(name);
+    key.push_back('\0');
+    size_t found = m_strings.find(key);
+    if (found != std::string::npos && (found == 0 || m_strings[found - 1] == '\0')) {
+        return static_cast<u32>(found);
+    }
+    u32 offset = static_cast<u32>(m_strings.size());
+    m_strings += key;
+    return offset;
+}
+
+void
+host::fdt_builder::begin_node(std::string_view name)
+{
+    push_u32(fdt::TOKEN_BEGIN_NODE);
+    m_structs.insert(m_structs.end(), name.begin(), name.end());
+    m_structs.push_back(0);
+    m_structs.resize(align_up(m_structs.size(), fdt::CELL_ALIGN), 0);
+}
+
+void
+host::fdt_builder::end_node()
+{
+    push_u32(fdt::TOKEN_END_NODE);
+}
+
+void
+host::fdt_builder::property(std::string_view name, const void* data, size_t size)
+{
+    push_u32(fdt::TOKEN_PROP);
+    push_u32(static_cast<u32>(size));
+    push_u32(string_offset(name));
+    const u8* bytes = static_cast<const u8*>(data);
+    m_structs.insert(m_structs.end(), bytes, bytes + size);
+    m_structs.resize(align_up(m_structs.size(), fdt::CELL_ALIGN), 0);
+}
+
+void
+host::fdt_builder::property_cells(std::string_view name, std::initializer_list<u32> cells)
+{
+    property_cells(name, std::vector<u32>(cells));
+}
+
+void
+host::fdt_builder::property_cells(std::string_view name, const std::vector<u32>& cells)
+{
+    std::vector<u8> data(cells.size() * sizeof(u32));
+    for (size_t i = 0; i < cells.size(); i++) {
+        put_big_endian(data.data() + i * sizeof(u32), cells[i]);
+    }
+    property(name, data.data(), data.size());
+}
+
+void
+host::fdt_builder::property_strings(std::string_view name,
+                                    std::initializer_list<std::string_view> strings)
+{
+    std::string data;
+    for (std::string_view str : strings) {
+        data += str;
+        data.push_back('\0');
+    }
+    property(name, data.data(), data.size());
+}
+
+void
+host::fdt_builder::reserve(u64 address, u64 size)
+{
+    m_reserved.push_back(address);
+    m_reserved.push_back(size);
+}
+
+host::blob_buffer
+host::fdt_builder::finish()
+{
+    push_u32(fdt::TOKEN_END);
+
+    size_t offset_rsvmap = align_up(sizeof(fdt::header), 2 * sizeof(u64));
+    size_t rsvmap_size = (m_reserved.size() + 2) * sizeof(u64);
+    size_t offset_structs = offset_rsvmap + rsvmap_size;
+    size_t offset_strings = offset_structs + m_structs.size();
+    size_t total_size = offset_strings + m_strings.size();
+
+    blob_buffer blob(total_size);
+    u8* out = blob.data();
+    u32 fields[] = { fdt::MAGIC,
+                     static_cast<u32>(total_size),
+                     static_cast<u32>(offset_structs),
+                     static_cast<u32>(offset_strings),
+                     static_cast<u32>(offset_rsvmap),
+                     fdt::MIN_VERSION,
+                     16,
+                     0,
+                     static_cast<u32>(m_strings.size()),
+                     static_cast<u32>(m_structs.size()) };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        put_big_endian(out + i * sizeof(u32), fields[i]);
+    }
+    for (size_t i = 0; i < m_reserved.size(); i++) {
+        u8* entry = out + offset_rsvmap + i * sizeof(u64);
+        put_big_endian(entry, static_cast<u32>(m_reserved[i] >> 32));
+        put_big_endian(entry + sizeof(u32), static_cast<u32>(m_reserved[i]));
+    }
+    std::memcpy(out + offset_structs, m_structs.data(), m_structs.size());
+    std::memcpy(out + offset_strings, m_strings.data(), m_strings.size());
+    return blob;
+}
+
+host::blob_buffer
+host::synthetic_blob(size_t devices)
+{
+    fdt_builder builder;
+    builder.reserve(0x80000000, 0x80000);
+
+    builder.begin_node("");
+    builder.property_u32("#address-cells", 2);
+    builder.property_u32("#size-cells", 2);
+    builder.property_strings("compatible", { "synthetic,soc" });
+    builder.property_strings("model", { "synthetic" });
+
+    builder.begin_node("aliases");
+    builder.property_strings("serial0", { "/soc/bus@0/device@0" });
+    builder.property_strings("pci0", { "/soc/pci@30000000" });
+    builder.end_node();
+
+    builder.begin_node("chosen");
+    builder.property_strings("stdout-path", { "serial0" });
+    builder.end_node();
+
+    builder.begin_node("cpus");
+    builder.property_u32("#address-cells", 1);
+    builder.property_u32("#size-cells", 0);
+    builder.property_u32("timebase-frequency", 10000000);
+    for (u32 hart = 0; hart < HARTS; hart++) {
+        builder.begin_node(unit_name("cpu", hart));
+        builder.property_strings("device_type", { "cpu" });
+        builder.property_u32("reg", hart);
+        builder.property_strings("compatible", { "riscv" });
+        builder.property_strings("riscv,isa", { "rv64imafdc_zicsr_zifencei_zba_zbb" });
+        builder.property_strings("mmu-type", { "riscv,sv39" });
+        builder.property_strings("status", { "okay" });
+        builder.begin_node("interrupt-controller");
+        builder.property_u32("#interrupt-cells", 1);
+        builder.property_empty("interrupt-controller");
+        builder.property_strings("compatible", { "riscv,cpu-intc" });
+        builder.property_u32("phandle", FIRST_INTC_PHANDLE + hart);
+        builder.end_node();
+        builder.end_node();
+    }
+    builder.end_node();
+
+    builder.begin_node("memory@80000000");
+    builder.property_strings("device_type", { "memory" });
+    builder.property_cells("reg", { 0, 0x80000000, 0, 0x40000000 });
+    builder.end_node();
+
+    builder.begin_node("soc");
+    builder.property_u32("#address-cells", 2);
+    builder.property_u32("#size-cells", 2);
+    builder.property_strings("compatible", { "simple-bus" });
+    builder.property_empty("ranges");
+
+    builder.begin_node("plic@c000000");
+    builder.property_u32("phandle", PLIC_PHANDLE);
+    builder.property_u32("#interrupt-cells", 1);
+    builder.property_u32("#address-cells", 0);
+    builder.property_empty("interrupt-controller");
+    builder.property_strings("compatible", { "sifive,plic-1.0.0", "riscv,plic0" });
+    builder.property_cells("reg", { 0, 0xc000000, 0, 0x600000 });
+    builder.property_u32("riscv,ndev", 1023);
+    std::vector<u32> contexts;
+    for (u32 hart = 0; hart < HARTS; hart++) {
+        contexts.insert(contexts.end(),
+                        { FIRST_INTC_PHANDLE + hart, 11, FIRST_INTC_PHANDLE + hart, 9 });
+    }
+    builder.property_cells("interrupts-extended", contexts);
+    builder.end_node();
+
+    // A PCI host bridge routing INTA-INTD of every slot to four PLIC sources.
+    builder.begin_node("pci@30000000");
+    builder.property_strings("device_type", { "pci" });
+    builder.property_strings("compatible", { "pci-host-ecam-generic" });
+    builder.property_u32("#address-cells", 3);
+    builder.property_u32("#size-cells", 2);
+    builder.property_u32("#interrupt-cells", 1);
+    builder.property_cells("reg", { 0, 0x30000000, 0, 0x10000000 });
+    builder.property_cells("interrupt-map-mask", { 0x1800, 0, 0, 7 });
+    std::vector<u32> map;
+    for (u32 slot = 0; slot < 4; slot++) {
+        for (u32 pin = 1; pin <= 4; pin++) {
+            map.insert(map.end(),
+                       { slot << 11, 0, 0, pin, PLIC_PHANDLE, 0x20 + (slot + pin - 1) % 4 });
+        }
+    }
+    builder.property_cells("interrupt-map", map);
+    builder.end_node();
+
+    size_t buses = (devices + DEVICES_PER_BUS - 1) / DEVICES_PER_BUS;
+    for (size_t bus = 0; bus < buses; bus++) {
+        u64 bus_base = 0x100000000 + bus * 0x1000000;
+        builder.begin_node(unit_name("bus", bus));
+        builder.property_strings("compatible", { "simple-bus" });
+        builder.property_u32("#address-cells", 1);
+        builder.property_u32("#size-cells", 1);
+        builder.property_cells(
+          "ranges", { 0, static_cast<u32>(bus_base >> 32), static_cast<u32>(bus_base), 0x1000000 });
+        builder.property_u32("interrupt-parent", PLIC_PHANDLE);
+
+        size_t end = bus * DEVICES_PER_BUS + DEVICES_PER_BUS;
+        for (size_t device = bus * DEVICES_PER_BUS; device < end && device < devices; device++) {
+            u32 offset = static_cast<u32>(device % DEVICES_PER_BUS) * 0x1000;
+            char compatible[32];
+            std::snprintf(compatible, sizeof(compatible), "vendor,device-%zu", device % 8);
+            builder.begin_node(unit_name("device", offset));
+            builder.property_strings("compatible", { compatible, "vendor,generic" });
+            builder.property_cells("reg", { offset, 0x1000 });
+            builder.property_u32("interrupts", static_cast<u32>(1 + device % 1022));
+            builder.property_u32("clock-frequency", 3686400);
+            builder.property_strings("status", { device % 16 == 15 ? "disabled" : "okay" });
+            builder.end_node();
+        }
+        builder.end_node();
+    }
+    builder.end_node();
+
+    builder.end_node();
+    return builder.finish();
+}
@@ -0,0 +1,51 @@
+/// Builds flattened device tree blobs in memory, for benchmarks and fuzzer seeds that need trees
+/// larger or stranger than the QEMU one.
+#pragma once
+
+#include "shims.h"
+
+#include <types/number.h>
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace host {
+
+class fdt_builder
+{
+public:
+    void begin_node(std::string_view name);
+    void end_node();
+
+    void property(std::string_view name, const void* data, size_t size);
+    void property_empty(std::string_view name) { property(name, nullptr, 0); }
+    void property_u32(std::string_view name, u32 value) { property_cells(name, { value }); }
+    void property_cells(std::string_view name, std::initializer_list<u32> cells);
+    void property_cells(std::string_view name, const std::vector<u32>& cells);
+    /// Writes a string list property, e.g. `compatible`.
+    void property_strings(std::string_view name, std::initializer_list<std::string_view> strings);
+
+    /// Adds an entry to the memory reservation block.
+    void reserve(u64 address, u64 size);
+
+    /// Returns the finished blob. The builder must not be used afterwards.
+    blob_buffer finish();
+
+private:
+    void push_u32(u32 value);
+    u32 string_offset(std::string_view name);
+
+    std::vector<u8> m_structs;
+    std::string m_strings;
+    std::vector<u64> m_reserved;
+};
+
+/// Returns a blob shaped like a large SoC: a few harts and a PLIC, then `devices` devices spread
+/// over simple-buses, each with `compatible`, `reg`, `interrupts` and `status`, plus a PCI host
+/// bridge with an `interrupt-map` and a set of aliases.
+blob_buffer
+synthetic_blob(size_t devices);
+
+}
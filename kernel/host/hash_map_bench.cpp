@@ -0,0 +1,165 @@
+/// Measures `hash_map<str_view, u32>::find` against a linear `str_view::compare` scan, over the
+/// distinct property names of the QEMU virt blob, the set the device tree parser interns. Lookups
+/// of those names are the hits, lookups of the node names that aren't also property names the
+/// misses.
+///
+/// Usage: hash_map_bench [qemu_virt.dtb]
+
+#include "bench.h"
+#include "shims.h"
+
+#include <devices/fdt.h>
+#include <types/hash_map.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr size_t LOOKUPS = 1000000;
+constexpr u32 NOT_FOUND = ~u32(0);
+
+bool
+contains(const std::vector<str_view>& names, str_view name)
+{
+    for (str_view other : names) {
+        if (str_view::compare(other, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+collect(fdt::node node, std::vector<str_view>* properties, std::vector<str_view>* nodes)
+{
+    node.for_each_property([&](fdt::property prop) {
+        if (!contains(*properties, prop.name())) {
+            properties->push_back(prop.name());
+        }
+    });
+    if (!contains(*nodes, node.name())) {
+        nodes->push_back(node.name());
+    }
+    node.for_each_child([&](fdt::node child) { collect(child, properties, nodes); });
+}
+
+u32
+linear_find(const std::vector<str_view>& names, str_view name)
+{
+    for (u32 i = 0; i < names.size(); i++) {
+        if (str_view::compare(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return NOT_FOUND;
+}
+
+u32
+map_find(const hash_map<str_view, u32>& map, str_view name)
+{
+    const u32* index = map.find(name);
+    return (index != nullptr) ? *index : NOT_FOUND;
+}
+
+/// Looks up every name of `queries` with both methods, checks that they agree, and prints the time
+/// per lookup of each.
+bool
+bench(const char* name,
+      const std::vector<str_view>& names,
+      const hash_map<str_view, u32>& map,
+      const std::vector<str_view>& queries)
+{
+    for (str_view query : queries) {
+        if (linear_find(names, query) != map_find(map, query)) {
+            std::printf("%s: hash_map and linear search disagree\n", name);
+            return false;
+        }
+    }
+
+    // The sums keep the lookups from being optimized away.
+    constexpr u64 BUDGET_NS = 300000000;
+    u64 linear_sum = 0;
+    u64 map_sum = 0;
+    host::timing linear = host::measure(
+      [&] {
+          for (str_view query : queries) {
+              linear_sum += linear_find(names, query);
+          }
+      },
+      [] {},
+      BUDGET_NS);
+    host::timing hashed = host::measure(
+      [&] {
+          for (str_view query : queries) {
+              map_sum += map_find(map, query);
+          }
+      },
+      [] {},
+      BUDGET_NS);
+
+    asm volatile("" : : "r"(linear_sum), "r"(map_sum));
+    double linear_ns = static_cast<double>(linear.median_ns) / queries.size();
+    double map_ns = static_cast<double>(hashed.median_ns) / queries.size();
+    std::printf("%-8s %3zu names  linear %6.1f ns/lookup  hash_map %6.1f ns/lookup  %5.2fx\n",
+                name,
+                names.size(),
+                linear_ns,
+                map_ns,
+                linear_ns / map_ns);
+    return true;
+}
+
+/// Returns `LOOKUPS` names drawn from `pool` with a fixed seed, so that runs compare.
+std::vector<str_view>
+draw(const std::vector<str_view>& pool)
+{
+    std::vector<str_view> queries;
+    queries.reserve(LOOKUPS);
+    u64 state = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        queries.push_back(pool[(state >> 33) % pool.size()]);
+    }
+    return queries;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    host::initialize(true);
+    const char* path = argc > 1 ? argv[1] : QEMU_VIRT_DTB;
+
+    host::blob_buffer dtb;
+    fdt::blob blob;
+    if (!host::read_file(path, &dtb) || fdt::blob::open(dtb.data(), &blob).is_err()) {
+        std::printf("can't open %s\n", path);
+        return EXIT_FAILURE;
+    }
+    std::vector<str_view> properties;
+    std::vector<str_view> nodes;
+    collect(blob.root(), &properties, &nodes);
+
+    std::vector<str_view> misses;
+    for (str_view node : nodes) {
+        if (!contains(properties, node)) {
+            misses.push_back(node);
+        }
+    }
+
+    hash_map<str_view, u32> map;
+    for (u32 i = 0; i < properties.size(); i++) {
+        error err = map.insert(properties[i], i);
+        if (err.is_err()) {
+            std::printf("insert: %s\n", err.str().data());
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool ok = bench("hits", properties, map, draw(properties));
+    ok &= bench("misses", properties, map, draw(misses));
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
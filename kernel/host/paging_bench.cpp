@@ -0,0 +1,247 @@
+/// Measures mapping a region of scattered 4 KiB pages, as `kvspace::map_region` does: one
+/// `map_small_page` and `flush_tlb_page` per page, against one `map_range` walk with a page source
+/// and a single flush. The page tables are real (pmm shim), the physical pages are made up, since
+/// nothing reads through the mappings. Hosts have no TLB to flush, so the per-page numbers leave
+/// out the cost of its `sfence.vma`s and the gap on hardware is wider. Also checks that a mapping
+/// whose page source fails is undone, that a root sharing the kernel half follows it, and that a
+/// failed `pin_tables` gives back what it took.
+///
+/// Usage: paging_bench
+
+#include "bench.h"
+#include "shims.h"
+
+#include <riscv/paging.h>
+#include <riscv/table_pool.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using namespace riscv::paging;
+
+/// Where the regions are mapped, the start of the kvspace window.
+constexpr vaddr_t REGION_BASE = 0xFFFFFFE000000000;
+constexpr u64 FLAGS = TEF_READ | TEF_WRITE | TEF_GLOBAL | TEF_ACCESSED | TEF_DIRTY;
+/// Physical pages the regions pretend to be backed by.
+constexpr paddr_t FAKE_MEMORY_BASE = 0x80000000;
+
+/// Returns the page backing `offset` of a region of `pages` pages: the pages in reverse order, so
+/// no two neighbours are contiguous.
+paddr_t
+backing_page(size_t offset, size_t pages)
+{
+    return FAKE_MEMORY_BASE + (pages - 1 - offset / PAGE_SIZE) * PAGE_SIZE;
+}
+
+error
+next_page(size_t offset, paddr_t* pa, void* context)
+{
+    *pa = backing_page(offset, *static_cast<size_t*>(context));
+    return ErrorCode::SUCCESS;
+}
+
+error
+map_per_page(page_table* root, size_t size)
+{
+    size_t pages = size / PAGE_SIZE;
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        error err = map_small_page(root, REGION_BASE + offset, backing_page(offset, pages), FLAGS);
+        if (err.is_err()) {
+            return err;
+        }
+        flush_tlb_page(REGION_BASE + offset);
+    }
+    return ErrorCode::SUCCESS;
+}
+
+error
+map_batched(page_table* root, size_t size)
+{
+    size_t pages = size / PAGE_SIZE;
+    return map_range(root, REGION_BASE, size, FLAGS, next_page, nullptr, &pages);
+}
+
+/// Checks that the mapping of `size` bytes at REGION_BASE has every page where it belongs.
+bool
+check(page_table* root, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+        if (virt_to_phys(root, REGION_BASE + offset) != backing_page(offset, size / PAGE_SIZE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// A page source that runs dry after `limit` pages, and counts the pages it gets back.
+struct failing_source
+{
+    size_t limit;
+    size_t handed_out = 0;
+    size_t given_back = 0;
+
+    static error next(size_t, paddr_t* pa, void* context)
+    {
+        failing_source* source = static_cast<failing_source*>(context);
+        if (source->handed_out == source->limit) {
+            return ErrorCode::PMM_OUT_OF_MEM;
+        }
+        *pa = FAKE_MEMORY_BASE + source->handed_out++ * PAGE_SIZE;
+        return ErrorCode::SUCCESS;
+    }
+
+    static void give_back(paddr_t, size_t, void* context)
+    {
+        static_cast<failing_source*>(context)->given_back++;
+    }
+};
+
+/// Checks that a mapping whose page source fails halfway leaves nothing mapped, and hands back
+/// every page it got.
+bool
+check_failure(page_table* root)
+{
+    failing_source source = { 1000 };
+    error err = map_range(root,
+                          REGION_BASE,
+                          MEGAPAGE_SIZE * 2,
+                          FLAGS,
+                          failing_source::next,
+                          failing_source::give_back,
+                          &source);
+    if (err.is_ok() || source.given_back != source.handed_out ||
+        virt_to_phys(root, REGION_BASE) != static_cast<paddr_t>(-1)) {
+        std::printf("a failed map_range left pages behind\n");
+        return false;
+    }
+    return true;
+}
+
+/// Checks that a root created from `kernel` sees what `kernel` maps in its pinned tables after
+/// the fact, and that neither unmapping there nor destroying the shared root frees those tables.
+bool
+check_shared_root(page_table* kernel)
+{
+    constexpr vaddr_t USER_BASE = 0x10000;
+    constexpr size_t SIZE = 64 * 1024;
+    table_entry* kernel_entry = &(*kernel)[vpn(REGION_BASE, LEVELS - 1)];
+    page_table* user;
+    error err = pin_tables(kernel, REGION_BASE, GIGAPAGE_SIZE);
+    if (err.is_ok()) {
+        err = create_root(&user, kernel);
+    }
+    if (err.is_err()) {
+        std::printf("shared root: %s\n", err.str().data());
+        return false;
+    }
+
+    bool ok = map_batched(kernel, SIZE).is_ok() && check(user, SIZE) &&
+              map_small_page(user, USER_BASE, FAKE_MEMORY_BASE, FLAGS & ~TEF_GLOBAL).is_ok() &&
+              virt_to_phys(kernel, USER_BASE) == static_cast<paddr_t>(-1) &&
+              unmap_range(kernel, REGION_BASE, SIZE).is_ok() &&
+              virt_to_phys(user, REGION_BASE) == static_cast<paddr_t>(-1) &&
+              kernel_entry->is_valid();
+    destroy_root(user);
+    if (!ok || !kernel_entry->is_valid()) {
+        std::printf("a shared root lost track of the kernel half\n");
+        return false;
+    }
+    return true;
+}
+
+/// Checks that `pin_tables` over a range with a gigapage in the middle fails, and leaves no table
+/// behind under the entries before it.
+bool
+check_pin_failure()
+{
+    constexpr vaddr_t LEAF = REGION_BASE + 2 * GIGAPAGE_SIZE;
+    page_table* root;
+    error err = create_root(&root);
+    if (err.is_ok()) {
+        err = map_gigapage(root, LEAF, FAKE_MEMORY_BASE & ~(GIGAPAGE_SIZE - 1), FLAGS);
+    }
+    if (err.is_err()) {
+        std::printf("pin failure: %s\n", err.str().data());
+        return false;
+    }
+
+    size_t free_tables = riscv::paging::table_pool::free_tables();
+    bool ok = pin_tables(root, REGION_BASE, 4 * GIGAPAGE_SIZE).is_err() &&
+              !(*root)[vpn(REGION_BASE, LEVELS - 1)].is_valid() &&
+              !(*root)[vpn(REGION_BASE + GIGAPAGE_SIZE, LEVELS - 1)].is_valid() &&
+              riscv::paging::table_pool::free_tables() == free_tables;
+    err = unmap_range(root, LEAF, GIGAPAGE_SIZE);
+    destroy_root(root);
+    if (!ok || err.is_err()) {
+        std::printf("a failed pin_tables left tables behind\n");
+        return false;
+    }
+    return true;
+}
+
+bool
+bench(page_table* root, const char* name, size_t size)
+{
+    constexpr u64 BUDGET_NS = 1000000000;
+    error err = error();
+    auto unmap = [&] {
+        if (unmap_range(root, REGION_BASE, size).is_err()) {
+            std::abort();
+        }
+    };
+
+    for (auto map : { map_per_page, map_batched }) {
+        err = map(root, size);
+        if (err.is_err() || !check(root, size)) {
+            std::printf("%s: mapping failed: %s\n", name, err.str().data());
+            return false;
+        }
+        unmap();
+    }
+
+    host::timing per_page =
+      host::measure([&] { err = map_per_page(root, size); }, unmap, BUDGET_NS);
+    host::timing batched =
+      host::measure([&] { err = map_batched(root, size); }, unmap, BUDGET_NS);
+    if (err.is_err()) {
+        std::printf("%s: %s\n", name, err.str().data());
+        return false;
+    }
+
+    size_t pages = size / PAGE_SIZE;
+    std::printf("%-8s %7zu pages  per page %9.1f us %5.1f ns/page  batched %9.1f us %5.1f ns/page"
+                "  %5.2fx\n",
+                name,
+                pages,
+                per_page.median_ns / 1e3,
+                static_cast<double>(per_page.median_ns) / pages,
+                batched.median_ns / 1e3,
+                static_cast<double>(batched.median_ns) / pages,
+                static_cast<double>(per_page.median_ns) / batched.median_ns);
+    return true;
+}
+
+} // namespace
+
+int
+main()
+{
+    host::initialize(true);
+    page_table* root;
+    error err = create_root(&root);
+    if (err.is_err()) {
+        std::printf("create_root: %s\n", err.str().data());
+        return EXIT_FAILURE;
+    }
+
+    bool ok = check_failure(root);
+    ok &= check_shared_root(root);
+    ok &= check_pin_failure();
+    ok &= bench(root, "64 KiB", 64 * 1024);
+    ok &= bench(root, "2 MiB", MEGAPAGE_SIZE);
+    ok &= bench(root, "1 GiB", GIGAPAGE_SIZE);
+    destroy_root(root);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
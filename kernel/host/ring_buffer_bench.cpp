@@ -0,0 +1,134 @@
+/// Measures the throughput of `spsc_ring` and `mpsc_ring` of u64, one element at a time and in
+/// batches of 32. "same thread" alternates pushing and popping a batch on one thread, which is
+/// the cost of the ring itself. "threaded" runs the producers and the consumer on their own
+/// threads, which adds the cache line transfers between cores, and is only meaningful on a machine
+/// with a core per thread.
+///
+/// Usage: ring_buffer_bench [elements]
+
+#include "shims.h"
+
+#include <types/ring_buffer.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t CAPACITY = 1024;
+
+void
+report(const char* ring, const char* mode, size_t batch, size_t elements, u64 ns)
+{
+    std::printf("%-4s %-12s batch %2zu  %8.1f M elements/s  %6.2f ns/element\n",
+                ring,
+                mode,
+                batch,
+                elements / (ns / 1e3),
+                static_cast<double>(ns) / elements);
+}
+
+/// Pushes and pops `elements` elements through `ring`, `batch` at a time, on the calling thread.
+template<typename Ring, typename Push>
+u64
+same_thread(Ring* ring, Push&& push, size_t batch, size_t elements)
+{
+    u64 values[32];
+    u64 sum = 0;
+    u64 start = host::now_ns();
+    for (size_t done = 0; done < elements; done += batch) {
+        for (size_t i = 0; i < batch; i++) {
+            values[i] = done + i;
+        }
+        push(values, batch);
+        size_t popped = ring->pop_batch(values, batch);
+        for (size_t i = 0; i < popped; i++) {
+            sum += values[i];
+        }
+    }
+    u64 ns = host::now_ns() - start;
+    asm volatile("" : : "r"(sum));
+    return ns;
+}
+
+/// Runs `producers` threads pushing `elements` elements in total through `ring`, `batch` at a
+/// time, while the calling thread pops them.
+template<typename Ring, typename Push>
+u64
+threaded(Ring* ring, Push&& push, size_t producers, size_t batch, size_t elements)
+{
+    // Whole batches only, so that the ring is empty again for the next run.
+    size_t per_producer = elements / producers / batch * batch;
+    std::vector<std::thread> threads;
+    u64 start = host::now_ns();
+    for (size_t p = 0; p < producers; p++) {
+        threads.emplace_back([&] {
+            u64 values[32] = {};
+            for (size_t done = 0; done < per_producer; done += batch) {
+                while (!push(values, batch)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    u64 values[32];
+    for (size_t received = 0; received < per_producer * producers;) {
+        size_t popped = ring->pop_batch(values, batch);
+        if (popped == 0) {
+            std::this_thread::yield();
+        }
+        received += popped;
+    }
+    u64 ns = host::now_ns() - start;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return ns;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    host::initialize(true);
+    size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 20000000;
+
+    static spsc_ring<u64, CAPACITY> spsc;
+    static mpsc_ring<u64, CAPACITY> mpsc;
+    // The SPSC push takes what fits; a threaded producer retries the rest.
+    auto spsc_push = [](const u64* values, size_t count) {
+        for (size_t pushed = 0; pushed < count;) {
+            size_t n = spsc.push_batch(values + pushed, count - pushed);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            pushed += n;
+        }
+        return true;
+    };
+    auto mpsc_push = [](const u64* values, size_t count) {
+        return mpsc.push_batch(values, count);
+    };
+
+    for (size_t batch : { 1, 32 }) {
+        u64 ns = same_thread(&spsc, spsc_push, batch, elements);
+        report("spsc", "same thread", batch, elements, ns);
+        ns = same_thread(&mpsc, mpsc_push, batch, elements);
+        report("mpsc", "same thread", batch, elements, ns);
+    }
+    for (size_t batch : { 1, 32 }) {
+        u64 ns = threaded(&spsc, spsc_push, 1, batch, elements);
+        report("spsc", "threaded", batch, elements, ns);
+        for (size_t producers : { 1, 2, 4 }) {
+            char mode[32];
+            std::snprintf(mode, sizeof(mode), "threaded x%zu", producers);
+            ns = threaded(&mpsc, mpsc_push, producers, batch, elements);
+            report("mpsc", mode, batch, elements, ns);
+        }
+    }
+    return EXIT_SUCCESS;
+}
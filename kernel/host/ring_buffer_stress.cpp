@@ -0,0 +1,190 @@
+/// Stress test of `spsc_ring` and `mpsc_ring` with real threads standing in for harts. Producers
+/// push numbered elements in batches of random sizes through small rings, so that they wrap and
+/// fill up all the time, and the consumer checks that every element arrives exactly once, intact
+/// and in order (per producer for the MPSC ring).
+///
+/// Usage: ring_buffer_stress [elements per producer]
+
+#include "shims.h"
+
+#include <types/ring_buffer.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t MPSC_PRODUCERS = 4;
+/// Largest batch a side pushes or pops at once. Above the SPSC capacity, so that full batches get
+/// split.
+constexpr size_t MAX_BATCH = 48;
+
+/// An element that can tell whether it was copied whole.
+struct element
+{
+    u64 producer;
+    u64 sequence;
+    u64 check;
+};
+
+u64
+check_of(u64 producer, u64 sequence)
+{
+    return (producer * 0x9E3779B97F4A7C15ULL) ^ ~sequence;
+}
+
+element
+make_element(u64 producer, u64 sequence)
+{
+    return { producer, sequence, check_of(producer, sequence) };
+}
+
+/// A tiny PRNG per thread, seeded differently for each.
+struct rng
+{
+    u64 state;
+
+    size_t batch()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return 1 + (state >> 33) % MAX_BATCH;
+    }
+};
+
+bool
+stress_spsc(size_t elements)
+{
+    static spsc_ring<element, 32> ring;
+    std::thread producer([&] {
+        rng random = { 1 };
+        element batch[MAX_BATCH];
+        for (size_t next = 0; next < elements;) {
+            size_t count = num::min(random.batch(), elements - next);
+            for (size_t i = 0; i < count; i++) {
+                batch[i] = make_element(0, next + i);
+            }
+            size_t pushed = ring.push_batch(batch, count);
+            next += pushed;
+            if (pushed == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    rng random = { 2 };
+    element batch[MAX_BATCH];
+    bool ok = true;
+    for (size_t expected = 0; expected < elements;) {
+        size_t count = ring.pop_batch(batch, random.batch());
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < count && ok; i++, expected++) {
+            const element& e = batch[i];
+            if (e.sequence != expected || e.check != check_of(0, expected)) {
+                std::printf("spsc: expected element %zu, got %llu (check %s)\n",
+                            expected,
+                            (unsigned long long)e.sequence,
+                            e.check == check_of(e.producer, e.sequence) ? "ok" : "torn");
+                ok = false;
+            }
+        }
+        if (!ok) {
+            // The producer would spin forever on a ring nobody drains.
+            std::_Exit(EXIT_FAILURE);
+        }
+    }
+    producer.join();
+    if (!ring.empty()) {
+        std::printf("spsc: %zu elements left over\n", ring.size());
+        ok = false;
+    }
+    return ok;
+}
+
+bool
+stress_mpsc(size_t elements)
+{
+    static mpsc_ring<element, 64> ring;
+    std::vector<std::thread> producers;
+    for (u64 id = 0; id < MPSC_PRODUCERS; id++) {
+        producers.emplace_back([id, elements] {
+            // Runs are all or nothing, and can't exceed the capacity.
+            rng random = { 3 + id };
+            element batch[MAX_BATCH];
+            for (size_t next = 0; next < elements;) {
+                size_t count = num::min(random.batch(), elements - next);
+                for (size_t i = 0; i < count; i++) {
+                    batch[i] = make_element(id, next + i);
+                }
+                if (ring.push_batch(batch, count)) {
+                    next += count;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    rng random = { 2 };
+    element batch[MAX_BATCH];
+    u64 expected[MPSC_PRODUCERS] = {};
+    bool ok = true;
+    for (size_t received = 0; ok && received < elements * MPSC_PRODUCERS;) {
+        size_t count = ring.pop_batch(batch, random.batch());
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < count && ok; i++, received++) {
+            const element& e = batch[i];
+            if (e.producer >= MPSC_PRODUCERS || e.check != check_of(e.producer, e.sequence)) {
+                std::printf("mpsc: torn element after %zu\n", received);
+                ok = false;
+            } else if (e.sequence != expected[e.producer]) {
+                std::printf("mpsc: producer %llu: expected element %llu, got %llu\n",
+                            (unsigned long long)e.producer,
+                            (unsigned long long)expected[e.producer],
+                            (unsigned long long)e.sequence);
+                ok = false;
+            } else {
+                expected[e.producer]++;
+            }
+        }
+    }
+    if (!ok) {
+        // The producers would spin forever on a ring nobody drains.
+        std::_Exit(EXIT_FAILURE);
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    if (ring.pop_batch(batch, 1) != 0) {
+        std::printf("mpsc: elements left over\n");
+        ok = false;
+    }
+    return ok;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    host::initialize(true);
+    size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 0) : 1000000;
+
+    bool ok = stress_spsc(elements);
+    if (ok) {
+        ok = stress_mpsc(elements);
+    }
+    if (!ok) {
+        return EXIT_FAILURE;
+    }
+    std::printf("spsc: %zu elements, mpsc: %zu producers x %zu elements, all in order\n",
+                elements,
+                MPSC_PRODUCERS,
+                elements);
+    return EXIT_SUCCESS;
+}
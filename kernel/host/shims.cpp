@@ -0,0 +1,124 @@
+#include "shims.h"
+
+#include <fmt/assert.h>
+#include <fmt/print.h>
+#include <limine/platform_info.h>
+#include <pmm.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace {
+size_t allocations = 0;
+
+void
+put_stdout(char c)
+{
+    std::putchar(c);
+}
+
+void
+put_nothing(char)
+{
+}
+}
+
+namespace pmm {
+error
+alloc_aligned(size_t size, size_t alignment, paddr_t* ret)
+{
+    alignment = alignment < 0x1000 ? 0x1000 : alignment;
+    size = align_up(size == 0 ? 1 : size, alignment);
+    void* ptr = std::aligned_alloc(alignment, size);
+    if (ptr == nullptr) {
+        return ErrorCode::PMM_OUT_OF_MEM;
+    }
+    std::memset(ptr, 0, size);
+    allocations++;
+    *ret = reinterpret_cast<paddr_t>(ptr);
+    return ErrorCode::SUCCESS;
+}
+
+error
+alloc(size_t size, paddr_t* ret)
+{
+    return alloc_aligned(size, 0x1000, ret);
+}
+
+paddr_t
+alloc_aligned_noerr(size_t size, size_t alignment)
+{
+    paddr_t ret = 0;
+    return alloc_aligned(size, alignment, &ret).is_ok() ? ret : 0;
+}
+
+paddr_t
+alloc_noerr(size_t size)
+{
+    return alloc_aligned_noerr(size, 0x1000);
+}
+
+error
+free(paddr_t ret)
+{
+    if (ret == 0) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    allocations--;
+    std::free(reinterpret_cast<void*>(ret));
+    return ErrorCode::SUCCESS;
+}
+}
+
+namespace limine {
+void*
+hhdm_phys_to_virt(paddr_t pa)
+{
+    return reinterpret_cast<void*>(pa);
+}
+
+paddr_t
+hhdm_virt_to_phys(void* ptr)
+{
+    return reinterpret_cast<paddr_t>(ptr);
+}
+}
+
+void
+host::initialize(bool quiet)
+{
+    error err = fmt::initialize(quiet ? put_nothing : put_stdout);
+    assert_err(err);
+}
+
+size_t
+host::live_allocations()
+{
+    return allocations;
+}
+
+u64
+host::now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<u64>(ts.tv_sec) * 1000000000 + static_cast<u64>(ts.tv_nsec);
+}
+
+bool
+host::read_file(const char* path, blob_buffer* out)
+{
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    out->resize(size < 0 ? 0 : static_cast<size_t>(size));
+    bool ok = size >= 0 && std::fread(out->data(), 1, out->size(), file) == out->size();
+    std::fclose(file);
+    return ok;
+}
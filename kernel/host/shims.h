@@ -0,0 +1,53 @@
+/// Stand-ins for the boot environment, so kernel code that never touches the hardware can run as a
+/// normal x86-64 Linux program (benchmarks, stress tests and fuzzers).
+///
+/// The pmm hands out zeroed, page aligned heap memory and the HHDM is the identity, so physical and
+/// virtual addresses are the same host pointers.
+#pragma once
+
+#include <types/number.h>
+
+#include <vector>
+
+namespace host {
+
+/// Routes `fmt::print` to stdout, or drops everything when `quiet` (e.g. the parsers' warnings
+/// about unhandled properties while fuzzing).
+void
+initialize(bool quiet);
+
+/// Returns the number of pmm allocations not freed yet.
+size_t
+live_allocations();
+
+/// Returns a monotonic timestamp in nanoseconds.
+u64
+now_ns();
+
+/// A byte buffer aligned for the FDT and the cache image, which are read with 8-byte loads.
+class blob_buffer
+{
+public:
+    blob_buffer() = default;
+    explicit blob_buffer(size_t size) { resize(size); }
+
+    void resize(size_t size)
+    {
+        m_words.assign((size + sizeof(u64) - 1) / sizeof(u64), 0);
+        m_size = size;
+    }
+
+    u8* data() { return reinterpret_cast<u8*>(m_words.data()); }
+    const u8* data() const { return reinterpret_cast<const u8*>(m_words.data()); }
+    size_t size() const { return m_size; }
+
+private:
+    std::vector<u64> m_words;
+    size_t m_size = 0;
+};
+
+/// Reads the whole file at `path` into `out`. Returns false if it can't be read.
+bool
+read_file(const char* path, blob_buffer* out);
+
+}
@@ -0,0 +1,83 @@
+/// Checks that `small_vector` can push one of its own elements while it grows, from the inline
+/// storage to the heap and from one heap buffer to the next, as `std::vector` allows. Run under the
+/// sanitizers, which catch reads of a freed buffer, and with an element type that notices being
+/// copied from after it was destroyed.
+///
+/// Usage: small_vector_test
+
+#include "shims.h"
+
+#include <types/small_vector.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+/// An element that isn't trivially copyable, and remembers whether it is alive.
+struct tracked
+{
+    static constexpr u64 ALIVE = 0xA11CE;
+    static constexpr u64 DEAD = 0xDEAD;
+
+    u64 value;
+    u64 state = ALIVE;
+
+    explicit tracked(u64 value)
+      : value(value)
+    {
+    }
+
+    tracked(const tracked& other)
+      : value(other.value)
+      , state(other.state == ALIVE ? ALIVE : DEAD)
+    {
+    }
+
+    tracked(tracked&& other)
+      : tracked(static_cast<const tracked&>(other))
+    {
+    }
+
+    ~tracked() { state = DEAD; }
+};
+
+/// Pushes copies of the last element until the vector has left its inline storage and moved to a
+/// larger heap buffer twice, then checks every element. `value_of` reads an element's value.
+template<typename T, size_t N, typename Value>
+bool
+push_back_own(const char* name, Value value_of)
+{
+    small_vector<T, N> vector;
+    vector.push_back(T(7));
+    size_t moves = 0;
+    while (moves < 3) {
+        T* data = vector.data();
+        vector.push_back(vector[vector.size() - 1]);
+        moves += vector.data() != data;
+    }
+    for (const T& element : vector) {
+        if (!value_of(element)) {
+            std::printf("%s: an element pushed while growing is wrong\n", name);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int
+main()
+{
+    host::initialize(true);
+    bool ok = push_back_own<u64, 4>("u64", [](const u64& value) { return value == 7; });
+    ok &= push_back_own<tracked, 4>("tracked", [](const tracked& element) {
+        return element.value == 7 && element.state == tracked::ALIVE;
+    });
+    if (host::live_allocations() != 0) {
+        std::printf("%zu pmm allocations leaked\n", host::live_allocations());
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -16,6 +16,9 @@ public:
     /// Frees the allocated memory.
     ~bump_alloc();
 
+    /// Returns every region to the pmm. The allocator starts over empty on the next allocation.
+    void release();
+
     /// Grows the allocator by one pages
     error grow();
 
@@ -41,6 +44,9 @@ private:
         struct region* next;
     };
 
+    /// Appends a region that fits `size` bytes aligned to `alignment`, and makes it current.
+    error add_region(size_t size, size_t alignment);
+
     struct region* m_region_list;
     struct region* m_current_region;
 };
\ No newline at end of file
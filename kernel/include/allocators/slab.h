@@ -32,7 +32,7 @@ public:
 
         // Set up the Region structure
         slab_region* new_region = reinterpret_cast<slab_region*>(ptr);
-        buffer_size -= sizeof(slab_region);
+        buffer_size -= align_up(sizeof(slab_region), s_BLOCK_ALIGN);
         ptr += align_up(sizeof(slab_region), s_BLOCK_ALIGN);
 
         // Calculate the number of blocks in the buffer
@@ -42,7 +42,7 @@ public:
 
         // Enque the blocks in the region free list
         slab_block* block = new_region->m_blocks = reinterpret_cast<slab_block*>(ptr);
-        for (size_t i = 0; i < new_region->m_total; i++) {
+        for (size_t i = 1; i < new_region->m_total; i++) {
             ptr += s_BLOCK_SZ;
             block->hdr.m_next = reinterpret_cast<slab_block*>(ptr);
             block = reinterpret_cast<slab_block*>(ptr);
@@ -82,8 +82,26 @@ public:
     /// Returns an object of type `T` to the allocator.
     constexpr error free(T* obj)
     {
-        (void)obj;
-        return ErrorCode::NOT_IMPLEMENTED;
+        if (obj == nullptr)
+            return ErrorCode::NULL_ARGUMENT;
+
+        // Find the region the block was carved from and push it back onto its free list.
+        u8* block_addr = reinterpret_cast<u8*>(obj);
+        for (slab_region* region = m_regions; region != nullptr; region = region->m_next) {
+            u8* first =
+              reinterpret_cast<u8*>(region) + align_up(sizeof(slab_region), s_BLOCK_ALIGN);
+            u8* end = first + region->m_total * s_BLOCK_SZ;
+            if (block_addr < first || block_addr >= end)
+                continue;
+
+            slab_block* b = reinterpret_cast<slab_block*>(block_addr);
+            b->hdr.m_next = region->m_blocks;
+            region->m_blocks = b;
+            ++region->m_free;
+            m_free++;
+            return ErrorCode::SUCCESS;
+        }
+        return ErrorCode::SLAB_NOT_OWNED;
     }
 
     /// The count of free blocks managed by the allocator.
@@ -2,15 +2,103 @@
 
 #include <types/byte_view.h>
 #include <types/dynamic_array.h>
+#include <types/str_view.h>
 
 namespace dt {
 
+struct node;
+
+/// The nodes sharing a compatible string, in DFS order.
+struct node_list
+{
+    /// Indices into the node array.
+    const u32* indices;
+    size_t count;
+
+    const struct node* operator[](size_t i) const;
+};
+
 /// Initializes the device tree structure by parsing the device tree blob. This procedure allocates
 /// its own memory for its internal structures.
 error
 parse_from_blob(const u8* dtb);
 
+/// Returns the size of the cache image `save_cache` writes for the parsed tree.
+size_t
+cache_size();
+
+/// Serializes the parsed tree into a position independent cache image, which a later boot can hand
+/// to `load_from_cache` instead of parsing the blob again.
+error
+save_cache(u8* buffer, size_t capacity);
+
+/// Initializes the device tree structure from a cache image written by `save_cache`. The image is
+/// checksummed and bounds checked, then copied, so it can be discarded afterwards, but `dtb` can't.
+/// Fails with DT_CACHE_STALE if `dtb` isn't the blob the image was made from, and with
+/// DT_CACHE_INVALID if the image is corrupt. Either way the caller should fall back to
+/// `parse_from_blob`.
+error
+load_from_cache(const u8* image, size_t size, const u8* dtb);
+
+/// Drops the parsed tree and everything allocated for it, leaving the module as if nothing had
+/// been parsed. A failed `parse_from_blob` or `load_from_cache` already does this.
+void
+release();
+
+/// Returns the node with the given phandle, or nullptr.
+const struct node*
+find_by_phandle(u32 phandle);
+
+/// Returns the node at `path`, or nullptr. The path is either absolute (`/soc/serial@10000000`)
+/// or starts with an alias (`serial0`, `serial0/child`). Components without a unit address match
+/// nodes that have one (`/memory` finds `/memory@80000000`).
+const struct node*
+find_by_path(str_view path);
+
+/// Returns every node that lists `compatible` among its compatible strings.
+node_list
+find_compatible(str_view compatible);
+
+/// Returns the name of the node, including its unit address.
+str_view
+node_name(const struct node* node);
+
+/// Returns the absolute path of the node.
+str_view
+node_path(const struct node* node);
+
+/// Where a device interrupt is delivered.
+struct interrupt_route
+{
+    /// The interrupt controller, the end of the interrupt tree walk.
+    const struct node* controller;
+    /// The interrupt number within `controller`, the first cell of its specifier.
+    u32 hwirq;
+    /// The second specifier cell, usually the trigger type. 0 for one-cell controllers.
+    u32 flags;
+};
+
+/// Returns the number of interrupts the node lists in `interrupts` or `interrupts-extended`.
+size_t
+interrupt_count(const struct node* node);
+
+/// Returns the route of interrupt `index` of the node. Routes are resolved through interrupt-parent
+/// and interrupt-map at parse time, so this is a lookup. Returns false if there is no such
+/// interrupt or it doesn't reach a controller.
+bool
+interrupt(const struct node* node, size_t index, interrupt_route* route);
+
+/// Routes an interrupt raised in the domain of `parent`, typically an interrupt-map nexus such as
+/// a PCI host bridge whose children aren't in the tree, from the child's unit address and
+/// interrupt specifier.
+bool
+map_interrupt(const struct node* parent,
+              u128 address,
+              const u32* specifier,
+              size_t n_cells,
+              interrupt_route* route);
+
 void
 print_device_tree();
 
-}
\ No newline at end of file
+}
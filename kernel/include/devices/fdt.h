@@ -0,0 +1,340 @@
+/// Lazy, allocation free access to a flattened device tree (FDT) blob.
+///
+/// Nodes and properties are small cursors pointing straight into the blob, and nothing is decoded
+/// until it is asked for. This makes it usable before the pmm exists (e.g. to find the UART and
+/// the memory nodes during early boot), and cheap for the many properties no driver ever reads.
+/// `dt::parse_from_blob` builds the fully decoded tree on top of the same blob format.
+#pragma once
+
+#include <memory.h>
+#include <types/byte_view.h>
+#include <types/error.h>
+#include <types/number.h>
+#include <types/str_view.h>
+
+namespace fdt {
+
+/// The FDT header, all fields are big endian.
+struct header
+{
+    /// The magic number for this forrmat, must contain the value 0xD00DFEED (big-endian).
+    u32 magic;
+    /// The total size in bytes of the device tree structure.
+    u32 total_size;
+    /// Offset in bytes to the structure block.
+    u32 offset_structs;
+    /// Offset in bytes to the strings block.
+    u32 offset_strings;
+    /// Offset in bytes to the memory reservation block.
+    u32 offset_rsvmap;
+    /// The version of the devicetree data structure.
+    u32 version;
+    u32 compatible_version;
+    u32 boot_cpuid;
+    u32 size_strings;
+    u32 size_structs;
+};
+
+constexpr u32 MAGIC = 0xD00DFEED;
+/// Oldest blob version with `size_structs`, which the cursors rely on.
+constexpr u32 MIN_VERSION = 17;
+
+/// Structure block tokens.
+constexpr u32 TOKEN_BEGIN_NODE = 0x01;
+constexpr u32 TOKEN_END_NODE = 0x02;
+constexpr u32 TOKEN_PROP = 0x03;
+constexpr u32 TOKEN_NOP = 0x04;
+constexpr u32 TOKEN_END = 0x09;
+
+/// Structure block tokens and property cells are always 4-byte aligned within the blob.
+constexpr size_t CELL_ALIGN = sizeof(u32);
+
+/// Values of `#address-cells` and `#size-cells` when a node doesn't specify them.
+constexpr u32 DEFAULT_ADDRESS_CELLS = 2;
+constexpr u32 DEFAULT_SIZE_CELLS = 1;
+
+/// Deepest node nesting a validated blob may have. Real trees are a handful of levels deep, the cap
+/// keeps node paths and walks of the tree bounded on malformed blobs.
+constexpr size_t MAX_DEPTH = 64;
+
+/// Checks the header of the blob at `dtb`, and that the blocks it points to lie within the blob and
+/// are aligned for word reads.
+error
+validate_header(const u8* dtb);
+
+/// Checks the structure block before anything trusts it: tokens, names and values lie within their
+/// blocks, nodes are balanced under a single root, at most MAX_DEPTH deep, and list their
+/// properties before their children. Neither allocates, so both work before the pmm exists.
+///
+/// Also counts the nodes and properties into `n_nodes` and `n_properties` when they're not null,
+/// so that the parser can allocate its arrays once, at their final size.
+error
+validate_structures(byte_view structures,
+                    byte_view strings,
+                    size_t* n_nodes = nullptr,
+                    size_t* n_properties = nullptr);
+
+/// Returns the value of `cells` (at most 4) big endian cells starting at `data`.
+inline u128
+read_cells(const u8* data, u32 cells)
+{
+    u128 value = 0;
+    for (u32 i = 0; i < cells; i++) {
+        value = (value << 32) | num::read_big_endian<u32, CELL_ALIGN>(data + i * sizeof(u32));
+    }
+    return value;
+}
+
+/// One (address, size) pair of a `reg` property.
+struct reg_entry
+{
+    u128 address;
+    u64 size;
+};
+
+/// One (child address, parent address, size) triple of a `ranges` property.
+struct range_entry
+{
+    u128 child_address;
+    u128 parent_address;
+    u64 size;
+};
+
+class blob;
+
+/// A property of a node. Default constructed (or not found) properties are empty and convert to
+/// false.
+class property
+{
+public:
+    constexpr property() = default;
+
+    explicit operator bool() const { return m_name.data() != nullptr; }
+
+    str_view name() const { return m_name; }
+
+    /// Returns the raw value.
+    byte_view value() const { return m_value; }
+
+    /// Returns the value as a single cell.
+    u32 as_u32() const { return num::read_big_endian<u32, CELL_ALIGN>(m_value.data()); }
+
+    /// Returns the value as a string, without its null terminator.
+    str_view as_string() const;
+
+    /// Calls `fn(str_view)` for each string of a string list value (e.g. `compatible`).
+    template<typename F>
+    void for_each_string(F&& fn) const;
+
+    /// Checks whether the string list value contains `str`.
+    bool contains_string(str_view str) const;
+
+private:
+    friend class node;
+
+    constexpr property(str_view name, byte_view value)
+      : m_name(name)
+      , m_value(value)
+    {
+    }
+
+    str_view m_name = str_view();
+    byte_view m_value = byte_view(nullptr, 0);
+};
+
+/// A node of the tree. Default constructed (or not found) nodes convert to false.
+class node
+{
+public:
+    constexpr node() = default;
+
+    explicit operator bool() const { return m_blob != nullptr; }
+
+    /// Returns the node name, including the unit address (e.g. `serial@10000000`).
+    str_view name() const;
+
+    /// Returns the property called `name`, or an empty property.
+    property find_property(str_view name) const;
+
+    /// Calls `fn(property)` for each property of the node.
+    template<typename F>
+    void for_each_property(F&& fn) const;
+
+    /// Returns the first child, or an empty node.
+    node first_child() const;
+
+    /// Returns the next sibling, or an empty node.
+    node next_sibling() const;
+
+    /// Calls `fn(node)` for each child of the node.
+    template<typename F>
+    void for_each_child(F&& fn) const;
+
+    /// Returns the child called `name`. A `name` without a unit address also matches children that
+    /// have one.
+    node find_child(str_view name) const;
+
+    /// Returns the `#address-cells` this node specifies for its children.
+    u32 address_cells() const;
+
+    /// Returns the `#size-cells` this node specifies for its children.
+    u32 size_cells() const;
+
+    /// Checks whether `compatible` is one of the node's compatible strings.
+    bool is_compatible(str_view compatible) const;
+
+    /// Returns false if the node has a `status` other than "okay".
+    bool is_enabled() const;
+
+    /// Returns the number of entries of the `reg` property.
+    size_t reg_count() const;
+
+    /// Decodes entry `index` of the `reg` property. Returns false if there is no such entry.
+    bool reg(size_t index, reg_entry* entry) const;
+
+    /// Returns the number of entries of the `ranges` property.
+    size_t range_count() const;
+
+    /// Decodes entry `index` of the `ranges` property. Returns false if there is no such entry.
+    bool range(size_t index, range_entry* entry) const;
+
+    /// Returns the offset of the node in the structure block, which orders nodes in DFS order.
+    u32 offset() const { return m_offset; }
+
+private:
+    friend class blob;
+
+    constexpr node(const blob* owner, u32 offset, u32 parent_address_cells, u32 parent_size_cells)
+      : m_blob(owner)
+      , m_offset(offset)
+      , m_parent_address_cells(parent_address_cells)
+      , m_parent_size_cells(parent_size_cells)
+    {
+    }
+
+    /// Returns the property starting at the PROP token at `offset`, and moves `offset` past it.
+    property property_at(u32* offset) const;
+
+    /// Returns the offset of the first property token.
+    u32 properties_begin() const;
+
+    const blob* m_blob = nullptr;
+    /// Offset of the BEGIN_NODE token in the structure block.
+    u32 m_offset = 0;
+    /// Cell counts the parent specifies, which apply to this node's `reg`.
+    u32 m_parent_address_cells = DEFAULT_ADDRESS_CELLS;
+    u32 m_parent_size_cells = DEFAULT_SIZE_CELLS;
+};
+
+/// A validated device tree blob.
+class blob
+{
+public:
+    constexpr blob() = default;
+
+    /// Validates the blob at `dtb` (see `validate_header` and `validate_structures`) and opens it.
+    /// The cursors trust what was validated, and don't check bounds again.
+    static error open(const u8* dtb, blob* out);
+
+    /// Returns the root node.
+    node root() const;
+
+    /// Returns the node at the absolute `path` (e.g. `/soc/serial@10000000`), or an empty node.
+    node find_path(str_view path) const;
+
+    /// Returns the first node after `after` in DFS order that is compatible with `compatible`, or
+    /// an empty node. Pass an empty node to search from the start. The search resumes at `after`,
+    /// so iterating over every match is a single pass over the blob.
+    node find_compatible(str_view compatible, node after = node()) const;
+
+    /// Calls `fn(paddr_t address, size_t size)` for each entry of the memory reservation block.
+    template<typename F>
+    void for_each_reserved_region(F&& fn) const;
+
+private:
+    friend class node;
+    friend class property;
+
+    u32 token(u32 offset) const
+    {
+        return num::read_big_endian<u32, CELL_ALIGN>(m_structs + offset);
+    }
+
+    /// Returns the offset past the node name starting at `offset`.
+    u32 skip_name(u32 offset) const;
+
+    /// Returns the offset of the first token at or after `offset` that is not a NOP.
+    u32 skip_nops(u32 offset) const;
+
+    /// Returns the offset of the first token at or after `offset` that is neither a NOP nor a
+    /// property.
+    u32 skip_properties(u32 offset) const;
+
+    /// Returns the offset just past the END_NODE token matching the BEGIN_NODE at `offset`.
+    u32 skip_node(u32 offset) const;
+
+    /// Returns the node whose BEGIN_NODE token is at `offset`, walking down from the root to learn
+    /// the cell counts of its parent.
+    node node_at(u32 offset) const;
+
+    const u8* m_structs = nullptr;
+    const u8* m_strings = nullptr;
+    const u8* m_rsvmap = nullptr;
+    /// End of the blob, which bounds a reservation block missing its terminator.
+    const u8* m_end = nullptr;
+};
+
+template<typename F>
+void
+property::for_each_string(F&& fn) const
+{
+    const char* data = reinterpret_cast<const char*>(m_value.data());
+    size_t length = m_value.length();
+    for (size_t i = 0; i < length;) {
+        // Bounded by the value, the last string of a malformed list may be unterminated.
+        size_t str_length = mem::find_byte(data + i, 0, length - i);
+        fn(str_view(data + i, str_length));
+        i += str_length + 1;
+    }
+}
+
+template<typename F>
+void
+node::for_each_property(F&& fn) const
+{
+    u32 offset = properties_begin();
+    while (m_blob->token(offset) == TOKEN_PROP) {
+        fn(property_at(&offset));
+        offset = m_blob->skip_nops(offset);
+    }
+}
+
+template<typename F>
+void
+node::for_each_child(F&& fn) const
+{
+    u32 address_cells = this->address_cells();
+    u32 size_cells = this->size_cells();
+    u32 offset = m_blob->skip_properties(properties_begin());
+    while (m_blob->token(offset) == TOKEN_BEGIN_NODE) {
+        fn(node(m_blob, offset, address_cells, size_cells));
+        offset = m_blob->skip_nops(m_blob->skip_node(offset));
+    }
+}
+
+template<typename F>
+void
+blob::for_each_reserved_region(F&& fn) const
+{
+    // The reservation block is a list of (address, size) pairs terminated by an all-zero entry.
+    for (const u8* entry = m_rsvmap; entry + 2 * sizeof(u64) <= m_end; entry += 2 * sizeof(u64)) {
+        u64 address = num::read_big_endian<u64, sizeof(u64)>(entry);
+        u64 size = num::read_big_endian<u64, sizeof(u64)>(entry + sizeof(u64));
+        if (address == 0 && size == 0) {
+            return;
+        }
+        fn(static_cast<paddr_t>(address), static_cast<size_t>(size));
+    }
+}
+
+}
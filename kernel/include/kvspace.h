@@ -0,0 +1,86 @@
+// Kernel Virtual Address Space management functions.
+#pragma once
+
+#include <limine/platform_info.h>
+#include <riscv/asid.h>
+#include <riscv/paging.h>
+#include <types/error.h>
+#include <types/number.h>
+
+namespace kvspace {
+
+/// Start of the window of kernel virtual address space handed out by this allocator. It sits well
+/// above the hhdm and below the kernel image.
+constexpr vaddr_t WINDOW_BASE = 0xFFFFFFE000000000;
+/// End (exclusive) of the kernel virtual address space window.
+constexpr vaddr_t WINDOW_END = 0xFFFFFFFF00000000;
+
+/// Builds the kernel's own root page table and switches `satp` to it, leaving Limine's tables
+/// behind. The table holds the direct map at the hhdm base in gigapages, and the kernel image with
+/// text read/execute, rodata read-only and data/bss read/write, plus tables for the whole window
+/// that are never freed, so address spaces can share them. Every mapping is global. Must run
+/// after the pmm is initialized and before any other mapping is made.
+error
+initialize(const limine::platform_info* pinfo);
+
+/// Creates an address space whose lower half is empty and whose upper half is the kernel's: it
+/// shares the kernel root's top-level entries, so whatever the kernel maps, before or after, is
+/// mapped in it too. Regions are mapped through the kernel root whichever address space is current.
+error
+create_address_space(riscv::address_space* ret);
+
+/// Tears down an address space made by `create_address_space`, handing every page mapped in its
+/// lower half to `on_unmap` (if non-null). The kernel's half is left alone. `space` must not be
+/// the current address space.
+void
+destroy_address_space(riscv::address_space* space,
+                      riscv::paging::unmap_callback on_unmap = nullptr,
+                      void* context = nullptr);
+
+/// Reserves a range of `size` bytes of kernel virtual address space aligned to `alignment`, a power
+/// of two. The free range that fits most tightly is used, and the region is followed by an unmapped
+/// guard page. Nothing is mapped in the range until `map_region` is called.
+error
+reserve_region(size_t size, size_t alignment, vaddr_t* ret);
+
+/// Backs the page-aligned range [region_base, region_base + size) of a reserved region with freshly
+/// allocated, zeroed physical pages.
+error
+map_region(vaddr_t region_base, size_t size);
+
+/// Reserves a region and maps all of it.
+error
+reserve_and_map_region(size_t size, size_t alignment, vaddr_t* ret);
+
+/// Unmaps the page-aligned range [region_base, region_base + size) and frees the backing pages.
+error
+unmap_region(vaddr_t region_base, size_t size);
+
+/// Returns a reserved region to the allocator, where it merges with the free space around it.
+/// `size` must be the size it was reserved with. Any mapped pages must have been unmapped first.
+error
+release_region(vaddr_t region_base, size_t size);
+
+/// Resizes the mapped start [region_base, region_base + old_size) of a reserved region to
+/// `new_size` bytes, keeping its contents, and returns the region's base in `ret`. Shrinking unmaps
+/// and frees the tail. Growing within the reservation maps fresh, zeroed pages after the old ones.
+/// Growing past it reserves a new region of `new_reserved` bytes (at least `new_size`), moves the
+/// pages there by remapping them, so nothing is copied, maps fresh pages after them, and releases
+/// the old region. On failure the region is left as it was.
+error
+reallocate(vaddr_t region_base,
+           size_t old_size,
+           size_t new_size,
+           size_t new_reserved,
+           vaddr_t* ret);
+
+/// Allocates `size` bytes of kernel memory that are virtually contiguous but backed by individual
+/// pages, so large buffers don't need physically contiguous memory.
+error
+vmalloc(size_t size, void** ret);
+
+/// Frees memory returned by `vmalloc`.
+error
+vfree(void* ptr);
+
+} // namespace kvspace
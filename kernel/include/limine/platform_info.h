@@ -1,11 +1,17 @@
 #pragma once
 
 #include <limine/limine.h>
+#include <riscv/paging.h>
 #include <types/error.h>
 #include <types/number.h>
 
 namespace limine {
 
+#if defined(__riscv)
+/// The paging mode the kernel page tables are built for, requested from the bootloader.
+constexpr u64 KERNEL_PAGING_MODE = LIMINE_PAGING_MODE_RISCV_SV39 + (riscv::paging::LEVELS - 3);
+#endif
+
 struct platform_info
 {
     /// Framebuffer
@@ -22,8 +28,17 @@ struct platform_info
     /// Device Tree Blob
     void* device_tree_blob;
 
+    /// Device tree cache image from a previous boot (the module with the `dt-cache` cmdline), or
+    /// nullptr.
+    void* device_tree_cache;
+    u64 device_tree_cache_size;
+
     /// Higher Half Direct Mapping Base
     u64 hhdm_base;
+
+    /// Where the kernel image was loaded, and the address it is linked at.
+    paddr_t kernel_physical_base;
+    vaddr_t kernel_virtual_base;
 };
 
 const struct platform_info*
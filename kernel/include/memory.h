@@ -16,4 +16,32 @@ copy(const void* src, void* dst, size_t count);
 size_t
 strlen(const char* src);
 
+/// Returns the index of the first byte equal to `c` within the first `count` bytes of `src`, or
+/// `count` if there is no such byte.
+size_t
+find_byte(const void* src, u8 c, size_t count);
+
+/// The available implementations of the string scanning primitives (`strlen` and `find_byte`).
+enum class string_impl
+{
+    /// One byte per iteration, works everywhere.
+    BYTEWISE,
+    /// Eight bytes per iteration using aligned loads and the has-zero-byte trick. The default.
+    SWAR,
+    /// Eight bytes per iteration using the Zbb `orc.b` and `ctz` instructions.
+    ZBB,
+    /// VLEN/8 bytes per iteration using the vector extension. The caller must have enabled the
+    /// vector unit in `sstatus.VS` before selecting this.
+    RVV,
+};
+
+/// Selects the implementation used by `strlen` and `find_byte`. Only select ZBB or RVV if the
+/// harts actually implement the extension (see `riscv::common_isa_extensions`).
+void
+select_string_impl(string_impl impl);
+
+/// Returns the implementation currently used by `strlen` and `find_byte`.
+string_impl
+current_string_impl();
+
 }
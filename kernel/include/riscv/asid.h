@@ -0,0 +1,41 @@
+/// Address space identifiers.
+///
+/// Each address space gets an ASID, so its TLB entries are tagged and survive switching to another
+/// one. ASIDs are handed out in generations: once they run out, a new generation starts with one
+/// full flush, and every address space gets a fresh ASID the next time it is switched to.
+///
+/// There is a single hart for now. With several, the rollover would have to flush every hart and
+/// the ASID of each hart's current address space would have to be carried into the new generation.
+#pragma once
+
+#include <riscv/paging.h>
+#include <types/number.h>
+
+namespace riscv {
+
+/// A root page table and the ASID it was last given.
+struct address_space
+{
+    paging::page_table* root;
+    /// The ASID in the low bits and the generation it belongs to above them. 0 until the first
+    /// switch.
+    u64 context = 0;
+};
+
+/// Probes how many ASID bits the hart implements by writing all ones into the ASID field of
+/// `satp` and reading back what stuck. Must run once, after the kernel page table is installed
+/// and before the first `switch_address_space`.
+void
+initialize_asids();
+
+/// Returns the number of implemented ASID bits, from 0 to 16.
+size_t
+asid_bits();
+
+/// Installs `space` in `satp`. Switching doesn't flush the TLB while `space` still holds an ASID
+/// of the current generation. Otherwise it is given a new one, which may start a new generation.
+/// Without ASID support, every switch flushes the whole TLB.
+void
+switch_address_space(address_space* space);
+
+} // namespace riscv
@@ -0,0 +1,38 @@
+/// The ISA extensions of the harts, as the device tree describes them.
+///
+/// Each cpu node lists its extensions in `riscv,isa-extensions` (one string each, e.g. "zbb"), or,
+/// in older trees, in a single `riscv,isa` string (e.g. "rv64imafdcv_zicsr_zbb"). The kernel only
+/// uses what every hart implements, so that code picked at boot runs the same on all of them.
+#pragma once
+
+#include <devices/fdt.h>
+#include <types/number.h>
+#include <types/str_view.h>
+
+namespace riscv {
+
+/// The extensions the kernel has a use for, as bits of an extension mask.
+enum IsaExtensions : u32
+{
+    /// Basic bit manipulation, used by the string routines (`orc.b`, `ctz`).
+    ISA_ZBB = 1 << 0,
+    /// The vector extension, used by the string routines.
+    ISA_V = 1 << 1,
+};
+
+/// Returns the mask of the known extensions named in a `riscv,isa` string. Single letter extensions
+/// follow the `rv32`/`rv64` prefix, multi-letter ones are separated by underscores.
+u32
+parse_isa_string(str_view isa);
+
+/// Returns the mask of the known extensions every enabled cpu node under `/cpus` lists, or 0 if
+/// there are none. Doesn't allocate, so it works before the pmm exists.
+u32
+common_isa_extensions(const fdt::blob& blob);
+
+/// Turns the vector unit on by moving `sstatus.VS` from Off to Initial. Vector instructions trap
+/// until this ran on the hart.
+void
+enable_vector_unit();
+
+} // namespace riscv
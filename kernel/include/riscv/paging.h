@@ -0,0 +1,278 @@
+/// RISC-V page tables for the Sv39, Sv48 and Sv57 modes.
+///
+/// The modes only differ in their number of levels, so the walks are templates over it and are
+/// unrolled at compile time. The kernel runs in one mode, picked at build time with the
+/// KERNEL_PAGING_MODE CMake option: `LEVELS` is its level count and the default template
+/// argument of every walk. paging.cpp instantiates the walks for all three modes.
+#pragma once
+
+#include <cstddef>
+#include <types/error.h>
+#include <types/number.h>
+#include <types/static_array.h>
+
+#ifndef PAGING_LEVELS
+#define PAGING_LEVELS 3
+#endif
+
+namespace riscv::paging {
+constexpr size_t PAGE_SIZE = 0x1000;
+constexpr size_t MEGAPAGE_SIZE = 0x200000;
+constexpr size_t GIGAPAGE_SIZE = 0x40000000;
+
+/// Number of levels of the kernel's page tables: 3 for Sv39, 4 for Sv48 and 5 for Sv57. Level 0
+/// holds the small pages, level 1 the megapages, level 2 the gigapages and so on up to the root.
+constexpr int LEVELS = PAGING_LEVELS;
+static_assert(LEVELS >= 3 && LEVELS <= 5, "PAGING_LEVELS must be 3 (Sv39), 4 (Sv48) or 5 (Sv57)");
+
+/// Returns the number of virtual address bits translated by a `levels` deep table.
+constexpr int
+va_bits(int levels)
+{
+    return 12 + 9 * levels;
+}
+
+/// Returns the MODE field of `satp` selecting the `levels` deep mode (8 for Sv39, 9, 10).
+constexpr u64
+satp_mode(int levels)
+{
+    return static_cast<u64>(levels + 5) << 60;
+}
+
+/// Returns the start of the upper half of the `levels` deep address space, where the kernel lives.
+constexpr vaddr_t
+upper_half_base(int levels)
+{
+    return ~0ULL << (va_bits(levels) - 1);
+}
+
+/// Returns true if the bits of `va` above the translated ones are copies of the top translated
+/// bit, as the `levels` deep mode requires.
+constexpr bool
+is_canonical(vaddr_t va, int levels)
+{
+    int unused_bits = 64 - va_bits(levels);
+    return static_cast<vaddr_t>(static_cast<i64>(va << unused_bits) >> unused_bits) == va;
+}
+
+/// The MODE field of `satp` for the kernel's page tables.
+constexpr u64 SATP_MODE = satp_mode(LEVELS);
+
+/// Returns the index of `va` in the page table at `level`.
+constexpr size_t
+vpn(vaddr_t va, int level)
+{
+    return (va >> (12 + 9 * level)) & 0x1FF;
+}
+
+/// Returns the size of the page mapped by a leaf entry at `level`.
+constexpr size_t
+level_page_size(int level)
+{
+    return PAGE_SIZE << (9 * level);
+}
+
+enum TableEntryFlags : u64
+{
+    /// Valid bit
+    TEF_VALID = 0b00000001,
+    /// Read bit
+    TEF_READ = 0b00000010,
+    /// Write bit
+    TEF_WRITE = 0b00000100,
+    /// Execute bit
+    TEF_EXECUTE = 0b00001000,
+    /// User bit
+    TEF_USER = 0b00010000,
+    /// Global bit
+    TEF_GLOBAL = 0b00100000,
+    /// Accessed bit
+    TEF_ACCESSED = 0b01000000,
+    /// Dirty bit
+    TEF_DIRTY = 0b10000000,
+};
+
+/// An entry of a page table, whose format is the same in every mode.
+struct table_entry
+{
+public:
+    /// Default constructs a nulled-out table_entry.
+    constexpr table_entry() noexcept
+      : m_entry(0)
+    {
+    }
+    /// Constructs a table_entry with a paddr_t and the given flags.
+    constexpr table_entry(paddr_t page_address, u64 flags)
+      : m_entry((page_address >> 2) | flags)
+    {
+    }
+    /// Returns the physical address of the next level page_table, or of the page a leaf maps,
+    /// whatever its size.
+    constexpr paddr_t get_address() const { return ((m_entry >> 10) & PPN_MASK) << 12; }
+    /// Returns the flag bits, including the two bits reserved for software.
+    constexpr u64 get_flags() const { return m_entry & FLAGS_MASK; }
+    /// Returns true if this entry is valid.
+    constexpr bool is_valid() const { return 0 != (m_entry & TEF_VALID); }
+    /// Returns true if the entry points to a readable page.
+    constexpr bool is_readable() const { return 0 != (m_entry & TEF_READ); }
+    /// Returns true if the entry points to a writable page.
+    constexpr bool is_writable() const { return 0 != (m_entry & TEF_WRITE); }
+    /// Returns true if the entry points to an executable page.
+    constexpr bool is_executable() const { return 0 != (m_entry & TEF_EXECUTE); }
+    /// Returns true if the entry points to a leaf node
+    constexpr bool is_leaf() const { return is_readable() || is_writable() || is_executable(); }
+
+private:
+    /// The 44 bits of the PPN, above them are the reserved and Svpbmt/Svnapot bits.
+    static constexpr u64 PPN_MASK = (1ULL << 44) - 1;
+    static constexpr u64 FLAGS_MASK = 0x3FF;
+
+    u64 m_entry;
+};
+
+constexpr table_entry NULL_TABLE_ENTRY = table_entry(0, 0);
+constexpr size_t TABLE_ENTRY_COUNT = 512;
+
+/// The page table is effectively page aligned set of 512 table_entries.
+using page_table = static_array<table_entry, TABLE_ENTRY_COUNT>;
+
+/// Mapos a page into the virtual address space, given a root page table. If any level of the page
+/// table doesn't exist, then it is created.
+template<int Levels = LEVELS>
+error
+map_small_page(page_table* root, vaddr_t va, paddr_t pa, u64 flags);
+
+/// Maps a 2 MiB megapage, `va` and `pa` must be 2 MiB aligned. Fails with PAGING_MAP_EXISTS if any
+/// part of the range is already mapped.
+template<int Levels = LEVELS>
+error
+map_megapage(page_table* root, vaddr_t va, paddr_t pa, u64 flags);
+
+/// Maps a 1 GiB gigapage, `va` and `pa` must be 1 GiB aligned. Fails with PAGING_MAP_EXISTS if any
+/// part of the range is already mapped.
+template<int Levels = LEVELS>
+error
+map_gigapage(page_table* root, vaddr_t va, paddr_t pa, u64 flags);
+
+/// Maps [va, va + size) to [pa, pa + size). Each chunk uses the largest page size that `va` and
+/// `pa` are both aligned to and that fits in what remains, so a large, well aligned range takes
+/// gigapages and only its ends fall back to smaller pages. The tables are walked once for the whole
+/// range and the TLB is flushed once at the end. On failure, the part of the range that was already
+/// mapped is unmapped again.
+template<int Levels = LEVELS>
+error
+map_range(page_table* root, vaddr_t va, paddr_t pa, size_t size, u64 flags);
+
+/// Called by `unmap_range` with the physical address and size of each page it unmaps. It runs
+/// before the TLB is flushed, so stale translations to the page remain until `unmap_range` returns.
+using unmap_callback = void (*)(paddr_t pa, size_t size, void* context);
+
+/// Called by the `map_range` overload below for each 4 KiB page of its range, in address order,
+/// with the page's offset from the start. Returns the physical page to map there in `pa`, or an
+/// error, which stops the mapping.
+using page_source = error (*)(size_t offset, paddr_t* pa, void* context);
+
+/// Maps [va, va + size) one 4 KiB page at a time, to the pages `source` hands out, for ranges that
+/// aren't physically contiguous (e.g. freshly allocated pages). As with the contiguous
+/// `map_range`, the tables are walked once and the TLB is flushed once at the end. On failure, the
+/// pages `source` handed out, mapped or not, are passed to `on_unmap` (if non-null) and the range
+/// is left unmapped.
+template<int Levels = LEVELS>
+error
+map_range(page_table* root,
+          vaddr_t va,
+          size_t size,
+          u64 flags,
+          page_source source,
+          unmap_callback on_unmap,
+          void* context);
+
+/// Removes every mapping in [va, va + size), skipping the holes, and frees the intermediate tables
+/// that end up empty. Superpages straddling either end are split first. `on_unmap`, if non-null,
+/// is called for each page removed.
+template<int Levels = LEVELS>
+error
+unmap_range(page_table* root,
+            vaddr_t va,
+            size_t size,
+            unmap_callback on_unmap = nullptr,
+            void* context = nullptr);
+
+/// Replaces the flags of every mapping in [va, va + size) with `flags`, skipping the holes.
+/// Superpages straddling either end are split first.
+template<int Levels = LEVELS>
+error
+protect_range(page_table* root, vaddr_t va, size_t size, u64 flags);
+
+/// Removes the 4 KiB mapping of `va` and flushes it from the TLB, freeing the tables it leaves
+/// empty. The physical page it pointed to is returned through `pa` (if non-null) and is not freed.
+template<int Levels = LEVELS>
+error
+unmap_small_page(page_table* root, vaddr_t va, paddr_t* pa);
+
+/// Allocates an empty root table. Tables come from `table_pool`, which tracks how many entries of
+/// each are in use, so every table the walks touch, roots included, must be allocated here.
+error
+create_root(page_table** root);
+
+/// Allocates a root table whose upper half is shared with `kernel_root`: the top-level entries are
+/// copied, so the new address space sees the kernel's mappings, and those made later under the
+/// tables it shares. Only the lower half may be changed through the new root. The upper-half
+/// top-level entries of `kernel_root` must not change afterwards, see `pin_tables`.
+template<int Levels = LEVELS>
+error
+create_root(page_table** root, const page_table* kernel_root);
+
+/// Gives every top-level entry of `root` that [va, va + size) touches a table, and pins these
+/// tables so unmaps never free them. The range can then be mapped and unmapped at will in a root
+/// that others share the upper half of. Pins are only taken once every table is in place: on
+/// failure nothing is pinned, and the tables added are freed again.
+template<int Levels = LEVELS>
+error
+pin_tables(page_table* root, vaddr_t va, size_t size);
+
+/// Tears down the lower half of the address space of `root` in one pass: calls `on_unmap` (if
+/// non-null) for every leaf, then frees every table, `root` included, after a single TLB flush.
+/// The upper half belongs to the kernel and is shared by every root (see `create_root`), so it is
+/// left alone. `root` must not be the table in `satp`.
+template<int Levels = LEVELS>
+void
+destroy_root(page_table* root, unmap_callback on_unmap = nullptr, void* context = nullptr);
+
+// Host builds (see kernel/host) run the walks on tables no hart uses, and have no TLB to flush.
+
+/// Flushes the translation for `va` from the local hart's TLB.
+inline void
+flush_tlb_page([[maybe_unused]] vaddr_t va)
+{
+#if defined(__riscv)
+    asm volatile("sfence.vma %0, zero" : : "r"(va) : "memory");
+#endif
+}
+
+/// Flushes the local hart's whole TLB, including the cached non-leaf entries a per-page flush
+/// leaves alone.
+inline void
+flush_tlb_all()
+{
+#if defined(__riscv)
+    asm volatile("sfence.vma zero, zero" : : : "memory");
+#endif
+}
+
+/// Walks a page table translating a vaddr_t to a paddr_t if the mapping is present, if the mapping
+/// is not present it returns ((paddr_t)-1). Works for pages of every size.
+template<int Levels = LEVELS>
+paddr_t
+virt_to_phys(page_table* root, vaddr_t va);
+
+/// Returns the root page table currently installed in `satp`, through the hhdm.
+page_table*
+current_page_table();
+
+/// Installs `root`, accessed through the hhdm, in `satp` and flushes the whole TLB. `root` must
+/// map the code and stack of the caller.
+void
+switch_page_table(page_table* root);
+
+} // namespace riscv::paging
@@ -0,0 +1,56 @@
+/// Page table pages.
+///
+/// Tables come from chunks of `CHUNK_PAGES` pages allocated from the pmm in one go. The first page
+/// of each chunk is its header: which of the other pages are free, and for each page in use the
+/// number of valid entries in it. The walks keep these counts up to date, so an unmap can tell in
+/// O(1) that a table became empty and give it back.
+///
+/// Free pages are always zero. Chunks come zeroed from the pmm, and a table is only freed once
+/// its count drops to 0, that is once every entry was cleared again, so handing out a page never
+/// needs a fill.
+#pragma once
+
+#include <riscv/paging.h>
+#include <types/error.h>
+#include <types/number.h>
+
+namespace riscv::paging::table_pool {
+
+/// Pages per chunk, the header included.
+constexpr size_t CHUNK_PAGES = 64;
+constexpr size_t CHUNK_SIZE = CHUNK_PAGES * PAGE_SIZE;
+
+/// Hands out an empty table, through the hhdm.
+error
+alloc(page_table** table);
+
+/// Gives back `table`, which must be empty. The chunk goes back to the pmm once none of its tables
+/// are in use, unless it is the last chunk with free tables.
+void
+free(page_table* table);
+
+/// Returns the number of valid entries in `table`, plus one if it is pinned.
+u32
+entry_count(const page_table* table);
+
+/// Records that an entry of `table` became valid.
+void
+entry_added(page_table* table);
+
+/// Records that an entry of `table` was cleared, and returns the number of valid entries left.
+u32
+entry_removed(page_table* table);
+
+/// Records that `table` was filled with `count` valid entries at once.
+void
+set_entry_count(page_table* table, u32 count);
+
+/// Pins `table`: its count never drops to 0, so the walks never find it empty and free it.
+void
+pin(page_table* table);
+
+/// Returns the number of free tables in the pool.
+size_t
+free_tables();
+
+} // namespace riscv::paging::table_pool
@@ -0,0 +1,108 @@
+/// Atomic integers and pointers built directly on the GCC `__atomic` builtins, so they work without
+/// libatomic. Everything up to 8 bytes is lock-free on rv64 with the A extension.
+#pragma once
+
+#include <types/number.h>
+
+/// Size of a cache line. Data written by different harts is kept this far apart to avoid false
+/// sharing.
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/// Memory orderings, with the meaning of the C++ memory model. Under RVWMO an acquire load is a
+/// load followed by `fence r,rw` and a release store is a `fence rw,w` followed by the store, so
+/// anything weaker than SEQ_CST is noticeably cheaper.
+enum class memory_order : int
+{
+    RELAXED = __ATOMIC_RELAXED,
+    ACQUIRE = __ATOMIC_ACQUIRE,
+    RELEASE = __ATOMIC_RELEASE,
+    ACQ_REL = __ATOMIC_ACQ_REL,
+    SEQ_CST = __ATOMIC_SEQ_CST,
+};
+
+template<typename T>
+class atomic
+{
+    static_assert(sizeof(T) <= sizeof(u64), "atomic<T> must not need libatomic");
+
+public:
+    constexpr atomic()
+      : m_value()
+    {
+    }
+
+    constexpr atomic(T value)
+      : m_value(value)
+    {
+    }
+
+    atomic(const atomic&) = delete;
+    atomic& operator=(const atomic&) = delete;
+
+    T load(memory_order order = memory_order::SEQ_CST) const
+    {
+        return __atomic_load_n(&m_value, static_cast<int>(order));
+    }
+
+    void store(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        __atomic_store_n(&m_value, value, static_cast<int>(order));
+    }
+
+    T exchange(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        return __atomic_exchange_n(&m_value, value, static_cast<int>(order));
+    }
+
+    /// Replaces the value with `desired` if it equals `expected`. On failure `expected` is updated
+    /// with the current value. May fail spuriously, so it belongs in a retry loop.
+    bool compare_exchange_weak(T& expected,
+                               T desired,
+                               memory_order success = memory_order::SEQ_CST,
+                               memory_order failure = memory_order::RELAXED)
+    {
+        return __atomic_compare_exchange_n(&m_value,
+                                           &expected,
+                                           desired,
+                                           true,
+                                           static_cast<int>(success),
+                                           static_cast<int>(failure));
+    }
+
+    /// Like `compare_exchange_weak`, but only fails if the value differs from `expected`.
+    bool compare_exchange_strong(T& expected,
+                                 T desired,
+                                 memory_order success = memory_order::SEQ_CST,
+                                 memory_order failure = memory_order::RELAXED)
+    {
+        return __atomic_compare_exchange_n(&m_value,
+                                           &expected,
+                                           desired,
+                                           false,
+                                           static_cast<int>(success),
+                                           static_cast<int>(failure));
+    }
+
+    T fetch_add(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        return __atomic_fetch_add(&m_value, value, static_cast<int>(order));
+    }
+
+    T fetch_sub(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        return __atomic_fetch_sub(&m_value, value, static_cast<int>(order));
+    }
+
+    T fetch_and(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        return __atomic_fetch_and(&m_value, value, static_cast<int>(order));
+    }
+
+    T fetch_or(T value, memory_order order = memory_order::SEQ_CST)
+    {
+        return __atomic_fetch_or(&m_value, value, static_cast<int>(order));
+    }
+
+private:
+    T m_value;
+};
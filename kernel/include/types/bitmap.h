@@ -0,0 +1,268 @@
+/// Bitmaps scanned a 64-bit word at a time. Finding the next set (or clear) bit skips whole empty
+/// words and uses `num::count_trailing_zeros` (a single `ctz` with Zbb) on the first interesting
+/// one.
+///
+/// `bitmap<N>` owns its storage, `bitmap_view` works on words owned by someone else (e.g. a frame
+/// bitmap sized at boot). Both share their operations through `bitmap_ops`.
+///
+/// The `atomic_*` operations may be used concurrently from several harts. All reads, including the
+/// ones in the `find_*` scans, are at least relaxed atomic loads (plain `ld` on rv64), so scanning
+/// while other harts update the bitmap is safe, the result just may be stale.
+#pragma once
+
+#include <fmt/assert.h>
+#include <types/atomic.h>
+#include <types/number.h>
+
+namespace bitmap_details {
+
+constexpr size_t BITS_PER_WORD = 64;
+
+constexpr size_t
+word_count(size_t bits)
+{
+    return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD;
+}
+
+constexpr u64
+bit_mask(size_t bit)
+{
+    return 1ULL << (bit % BITS_PER_WORD);
+}
+
+/// Mask of the bits from `bit % 64` up to the top of the word.
+constexpr u64
+mask_from(size_t bit)
+{
+    return ~0ULL << (bit % BITS_PER_WORD);
+}
+
+/// Mask of the bits below `bit % 64`, or all of them if `bit` is word aligned.
+constexpr u64
+mask_until(size_t bit)
+{
+    return (bit % BITS_PER_WORD == 0) ? ~0ULL : ~mask_from(bit);
+}
+
+} // namespace bitmap_details
+
+/// Bitmap operations shared by `bitmap` and `bitmap_view`. `Derived` provides `words()` and
+/// `size()`.
+template<typename Derived>
+class bitmap_ops
+{
+public:
+    /// Returns the value of bit `i`.
+    bool test(size_t i) const { return (load(i / BITS) & bitmap_details::bit_mask(i)) != 0; }
+
+    void set(size_t i)
+    {
+        assert(i < size());
+        words()[i / BITS] |= bitmap_details::bit_mask(i);
+    }
+
+    void clear(size_t i)
+    {
+        assert(i < size());
+        words()[i / BITS] &= ~bitmap_details::bit_mask(i);
+    }
+
+    /// Sets bits [first, first + count).
+    void set_range(size_t first, size_t count) { update_range(first, count, true); }
+
+    /// Clears bits [first, first + count).
+    void clear_range(size_t first, size_t count) { update_range(first, count, false); }
+
+    /// Sets every bit.
+    void set_all() { update_range(0, size(), true); }
+
+    /// Clears every bit.
+    void clear_all() { update_range(0, size(), false); }
+
+    /// Returns the index of the first set bit at or after `from`, or `size()` if there is none.
+    size_t find_next_set(size_t from) const { return find_next(from, 0); }
+
+    /// Returns the index of the first clear bit at or after `from`, or `size()` if there is none.
+    size_t find_next_zero(size_t from) const { return find_next(from, ~0ULL); }
+
+    size_t find_first_set() const { return find_next_set(0); }
+    size_t find_first_zero() const { return find_next_zero(0); }
+
+    /// Returns the start of the first run of `count` clear bits at or after `from`, or `size()` if
+    /// there is none.
+    size_t find_zero_range(size_t from, size_t count) const;
+
+    /// Atomically sets bit `i` and returns its previous value.
+    bool atomic_test_and_set(size_t i, memory_order order = memory_order::ACQ_REL)
+    {
+        assert(i < size());
+        u64 mask = bitmap_details::bit_mask(i);
+        return (__atomic_fetch_or(&words()[i / BITS], mask, static_cast<int>(order)) & mask) != 0;
+    }
+
+    /// Atomically clears bit `i` and returns its previous value.
+    bool atomic_test_and_clear(size_t i, memory_order order = memory_order::ACQ_REL)
+    {
+        assert(i < size());
+        u64 mask = bitmap_details::bit_mask(i);
+        return (__atomic_fetch_and(&words()[i / BITS], ~mask, static_cast<int>(order)) & mask) !=
+               0;
+    }
+
+    void atomic_set(size_t i, memory_order order = memory_order::RELEASE)
+    {
+        atomic_test_and_set(i, order);
+    }
+
+    void atomic_clear(size_t i, memory_order order = memory_order::RELEASE)
+    {
+        atomic_test_and_clear(i, order);
+    }
+
+    /// Atomically finds a clear bit at or after `from` and sets it. Returns its index, or `size()`
+    /// if every bit was set. This hands out IDs (ASIDs, IRQs, ...) without a lock.
+    size_t atomic_claim_zero(size_t from = 0);
+
+private:
+    static constexpr size_t BITS = bitmap_details::BITS_PER_WORD;
+
+    u64* words() { return static_cast<Derived*>(this)->words(); }
+    const u64* words() const { return static_cast<const Derived*>(this)->words(); }
+    size_t size() const { return static_cast<const Derived*>(this)->size(); }
+
+    u64 load(size_t word) const { return __atomic_load_n(&words()[word], __ATOMIC_RELAXED); }
+
+    /// Finds the first bit at or after `from` that is set in the bitmap XOR `flip`.
+    size_t find_next(size_t from, u64 flip) const;
+
+    void update_range(size_t first, size_t count, bool value);
+};
+
+template<typename Derived>
+size_t
+bitmap_ops<Derived>::find_next(size_t from, u64 flip) const
+{
+    size_t bits = size();
+    if (from >= bits) {
+        return bits;
+    }
+
+    size_t word = from / BITS;
+    u64 value = (load(word) ^ flip) & bitmap_details::mask_from(from);
+    size_t last_word = bitmap_details::word_count(bits) - 1;
+    while (value == 0) {
+        if (word == last_word) {
+            return bits;
+        }
+        value = load(++word) ^ flip;
+    }
+
+    // Padding bits past the end may look clear (or set), so clamp.
+    return num::min(word * BITS + num::count_trailing_zeros(value), bits);
+}
+
+template<typename Derived>
+size_t
+bitmap_ops<Derived>::find_zero_range(size_t from, size_t count) const
+{
+    size_t bits = size();
+    while (true) {
+        size_t start = find_next_zero(from);
+        if (start == bits || bits - start < count) {
+            return bits;
+        }
+        size_t end = find_next_set(start);
+        if (end - start >= count) {
+            return start;
+        }
+        from = end;
+    }
+}
+
+template<typename Derived>
+void
+bitmap_ops<Derived>::update_range(size_t first, size_t count, bool value)
+{
+    assert(first <= size() && count <= size() - first);
+    if (count == 0) {
+        return;
+    }
+
+    u64* w = words();
+    size_t last = first + count;
+    size_t first_word = first / BITS;
+    size_t last_word = (last - 1) / BITS;
+    u64 fill = value ? ~0ULL : 0;
+
+    u64 head = bitmap_details::mask_from(first);
+    u64 tail = bitmap_details::mask_until(last);
+    if (first_word == last_word) {
+        head &= tail;
+    }
+    w[first_word] = (w[first_word] & ~head) | (fill & head);
+    if (first_word == last_word) {
+        return;
+    }
+    for (size_t i = first_word + 1; i < last_word; i++) w[i] = fill;
+    w[last_word] = (w[last_word] & ~tail) | (fill & tail);
+}
+
+template<typename Derived>
+size_t
+bitmap_ops<Derived>::atomic_claim_zero(size_t from)
+{
+    size_t bits = size();
+    while (true) {
+        size_t i = find_next_zero(from);
+        if (i == bits) {
+            return bits;
+        }
+        if (!atomic_test_and_set(i, memory_order::ACQUIRE)) {
+            return i;
+        }
+        // Another hart took it first; look again from the same spot.
+        from = i;
+    }
+}
+
+/// Bitmap of `N` bits with inline storage, all clear initially.
+template<size_t N>
+class bitmap : public bitmap_ops<bitmap<N>>
+{
+public:
+    constexpr bitmap() = default;
+
+    /// Returns the number of bits.
+    static constexpr size_t size() { return N; }
+
+    u64* words() { return m_words; }
+    const u64* words() const { return m_words; }
+
+private:
+    u64 m_words[bitmap_details::word_count(N)] = {};
+};
+
+/// Bitmap over `bits` bits of caller-owned storage, which must hold at least
+/// `bitmap_view::words_for(bits)` words.
+class bitmap_view : public bitmap_ops<bitmap_view>
+{
+public:
+    constexpr bitmap_view(u64* words, size_t bits)
+      : m_words(words)
+      , m_bits(bits)
+    {
+    }
+
+    /// Returns the number of words needed to hold `bits` bits.
+    static constexpr size_t words_for(size_t bits) { return bitmap_details::word_count(bits); }
+
+    /// Returns the number of bits.
+    size_t size() const { return m_bits; }
+
+    u64* words() { return m_words; }
+    const u64* words() const { return m_words; }
+
+private:
+    u64* m_words;
+    size_t m_bits;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstring>
+#include <memory.h>
 #include <types/number.h>
 
 class byte_view
@@ -81,12 +82,19 @@ byte_view::subview(size_t start, size_t len) const
 constexpr size_t
 byte_view::find(u8 val, size_t start) const
 {
-    for (size_t i = start; i < m_size; i++) {
-        if (m_data[i] == val) {
-            return i;
+    if consteval {
+        for (size_t i = start; i < m_size; i++) {
+            if (m_data[i] == val) {
+                return i;
+            }
         }
+        return s_sentinel;
+    } else {
+        if (start >= m_size)
+            return s_sentinel;
+        size_t i = mem::find_byte(m_data + start, val, m_size - start);
+        return (i == m_size - start) ? s_sentinel : start + i;
     }
-    return s_sentinel;
 }
 
 constexpr ssize_t
@@ -0,0 +1,29 @@
+/// Helpers for intrusive containers, which link objects through a node embedded in the object.
+#pragma once
+
+#include <types/number.h>
+
+namespace intrusive_details {
+
+/// Returns the byte offset of the member `Member` within `T`.
+template<typename T, typename M, M T::*Member>
+inline size_t
+member_offset()
+{
+    alignas(T) static constexpr u8 probe[sizeof(T)] = {};
+    const T* obj = reinterpret_cast<const T*>(probe);
+    return reinterpret_cast<const u8*>(&(obj->*Member)) - probe;
+}
+
+/// Returns the object of type `T` whose member `Member` is `node`, or nullptr for a null `node`.
+template<typename T, typename M, M T::*Member>
+inline T*
+container_of(M* node)
+{
+    if (node == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<T*>(reinterpret_cast<u8*>(node) - member_offset<T, M, Member>());
+}
+
+} // namespace intrusive_details
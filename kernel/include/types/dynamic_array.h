@@ -1,14 +1,24 @@
 // Kernel Dynamic Array collection, relies on the pmm and hhdm for memory allocations.
+//
+// Small arrays live in physically contiguous pmm memory accessed through the hhdm and grow by
+// copying. Once an array outgrows `s_RESERVE_THRESHOLD` bytes it moves (one last copy) into a range
+// of kernel virtual address space reserved up front, after which growth only maps new pages at the
+// end of the buffer and never copies again. An array that fills its reservation has its pages
+// remapped into a larger one (see `kvspace::reallocate`).
 #pragma once
 
 #include <fmt/assert.h>
+#include <kvspace.h>
 #include <limine/platform_info.h>
 #include <memory.h>
+#include <new>
 #include <pmm.h>
-#include <riscv/sv39.h>
+#include <riscv/paging.h>
+#include <type_traits>
 #include <types/error.h>
 #include <types/number.h>
 #include <types/result.h>
+#include <utility>
 
 template<typename T>
 class dynamic_array
@@ -20,24 +30,77 @@ public:
     /// Creates a dynamic array by allocating a number of physical pages from the pmm
     static result<dynamic_array> create_with_min_size(size_t minimum_size);
 
+    /// Move constructor.
+    dynamic_array(dynamic_array&& other) noexcept;
+
+    dynamic_array(const dynamic_array&) = delete;
+
     /// Frees a dynamic array, returning the pages to the pmm
     ~dynamic_array();
 
+    /// Move assignment.
+    dynamic_array& operator=(dynamic_array&& other) noexcept;
+
+    dynamic_array& operator=(const dynamic_array&) = delete;
+
     T& operator[](size_t index);
     const T& operator[](size_t index) const;
 
     /// Asserts to test failure
     void push_back(T val);
 
+    /// Constructs a value in place at the end of the array, asserting if the array can't grow.
+    /// Returns the address of the new value.
+    template<typename... Args>
+    T* emplace_back(Args&&... args);
+
+    /// Destroys the last element.
+    void pop_back();
+
+    /// Grows the array with a 3/2 growth rate.
     error grow();
 
+    /// Grows the array so that it can hold at least `minimum_capacity` elements.
+    error reserve(size_t minimum_capacity);
+
+    T* begin() { return m_buffer; }
+    T* end() { return m_buffer + m_size; }
+    const T* begin() const { return m_buffer; }
+    const T* end() const { return m_buffer + m_size; }
+
+    T* data() { return m_buffer; }
+    const T* data() const { return m_buffer; }
+
+    size_t size() const { return m_size; }
+
     size_t m_capacity;
     size_t m_size;
 
-    static_assert(sizeof(T) <= riscv::sv39::PAGE_SIZE);
+    static_assert(sizeof(T) <= riscv::paging::PAGE_SIZE);
+
+    /// Buffers larger than this are moved into a virtual address space reservation.
+    static constexpr size_t s_RESERVE_THRESHOLD = 16 * riscv::paging::PAGE_SIZE;
+    /// Size of the first virtual address space reservation made for large arrays. Each following
+    /// one is twice as large.
+    static constexpr size_t s_RESERVATION_SIZE = riscv::paging::GIGAPAGE_SIZE;
 
 private:
+    /// Moves `count` elements from `src` into uninitialized memory at `dst`.
+    static void relocate(T* src, T* dst, size_t count);
+
+    /// Destroys the elements and returns all memory, leaving the array empty.
+    void release();
+
+    /// Number of bytes of the buffer that are backed by memory.
+    size_t mapped_size() const
+    {
+        return align_up(m_capacity * sizeof(T), riscv::paging::PAGE_SIZE);
+    }
+
     T* m_buffer;
+    /// Size in bytes of the virtual address space reservation backing `m_buffer`, or zero if the
+    /// buffer is contiguous memory from the pmm.
+    size_t m_reserved;
 };
 
 template<typename T>
@@ -45,6 +108,7 @@ dynamic_array<T>::dynamic_array()
   : m_capacity(0)
   , m_size(0)
   , m_buffer(nullptr)
+  , m_reserved(0)
 {
 }
 
@@ -52,21 +116,92 @@ template<typename T>
 result<dynamic_array<T>>
 dynamic_array<T>::create_with_min_size(size_t minimum_size)
 {
-    size_t size = align_up(minimum_size * sizeof(T), riscv::sv39::PAGE_SIZE);
-    size_t count = size / sizeof(T);
-    paddr_t pa;
-    error err = pmm::alloc(size, &pa);
+    dynamic_array array;
+    error err = array.reserve(minimum_size);
     if (err.is_err()) {
-        return result<dynamic_array>::make_err(err.push(ErrorCode::DYN_ARR_ALLOC_FAILURE));
+        return err.push(ErrorCode::DYN_ARR_ALLOC_FAILURE);
     }
-    void* buffer = limine::hhdm_phys_to_virt(pa);
-    return result<dynamic_array>::make_some({ .m_capacity = count, .m_buffer = buffer });
+    return result<dynamic_array>::make_some(std::move(array));
+}
+
+template<typename T>
+dynamic_array<T>::dynamic_array(dynamic_array&& other) noexcept
+  : m_capacity(other.m_capacity)
+  , m_size(other.m_size)
+  , m_buffer(other.m_buffer)
+  , m_reserved(other.m_reserved)
+{
+    other.m_capacity = 0;
+    other.m_size = 0;
+    other.m_buffer = nullptr;
+    other.m_reserved = 0;
 }
 
 template<typename T>
 dynamic_array<T>::~dynamic_array()
 {
-    todo("Implement this!");
+    release();
+}
+
+template<typename T>
+dynamic_array<T>&
+dynamic_array<T>::operator=(dynamic_array&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_capacity = other.m_capacity;
+        m_size = other.m_size;
+        m_buffer = other.m_buffer;
+        m_reserved = other.m_reserved;
+        other.m_capacity = 0;
+        other.m_size = 0;
+        other.m_buffer = nullptr;
+        other.m_reserved = 0;
+    }
+    return *this;
+}
+
+template<typename T>
+void
+dynamic_array<T>::relocate(T* src, T* dst, size_t count)
+{
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        mem::copy(src, dst, count * sizeof(T));
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            new (&dst[i]) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+template<typename T>
+void
+dynamic_array<T>::release()
+{
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (size_t i = 0; i < m_size; i++) {
+            m_buffer[i].~T();
+        }
+    }
+
+    if (m_buffer != nullptr) {
+        error err;
+        if (m_reserved != 0) {
+            vaddr_t base = reinterpret_cast<vaddr_t>(m_buffer);
+            err = kvspace::unmap_region(base, mapped_size());
+            assert_err(err);
+            err = kvspace::release_region(base, m_reserved);
+        } else {
+            err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        }
+        assert_err(err);
+    }
+
+    m_capacity = 0;
+    m_size = 0;
+    m_buffer = nullptr;
+    m_reserved = 0;
 }
 
 template<typename T>
@@ -85,29 +220,107 @@ dynamic_array<T>::operator[](size_t index) const
 
 template<typename T>
 error
-dynamic_array<T>::grow()
+dynamic_array<T>::reserve(size_t minimum_capacity)
 {
-    size_t current_size = align_up(m_capacity * sizeof(T), riscv::sv39::PAGE_SIZE);
-    size_t new_size = align_up((current_size * 3) / 2, riscv::sv39::PAGE_SIZE);
-    size_t new_count = new_size / sizeof(T);
-    void* old_buffer = m_buffer;
-    paddr_t new_pa;
-    error err = pmm::alloc(new_size, &new_pa);
-    if (err.is_err()) {
-        return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+    if (minimum_capacity <= m_capacity) {
+        return ErrorCode::SUCCESS;
     }
-    void* new_buffer = limine::hhdm_phys_to_virt(new_pa);
-    mem::copy(old_buffer, new_buffer, m_capacity * sizeof(T));
-    err = pmm::free(limine::hhdm_virt_to_phys(old_buffer));
-    if (err.is_err()) {
-        return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+
+    size_t current_size = mapped_size();
+    size_t new_size = align_up(minimum_capacity * sizeof(T), riscv::paging::PAGE_SIZE);
+
+    // Already in a reservation: kvspace backs the new tail with pages, or once the reservation is
+    // full, moves the pages into one twice as large by remapping them. That moves the elements
+    // bytewise, so only trivially copyable ones may outgrow their reservation.
+    if (m_reserved != 0) {
+        size_t new_reserved = m_reserved;
+        if (new_size > m_reserved) {
+            if constexpr (!std::is_trivially_copyable_v<T>) {
+                return ErrorCode::DYN_ARR_RESERVATION_FULL;
+            }
+            new_reserved = num::max(2 * m_reserved, align_up(new_size, s_RESERVATION_SIZE));
+        }
+        vaddr_t base;
+        error err = kvspace::reallocate(
+          reinterpret_cast<vaddr_t>(m_buffer), current_size, new_size, new_reserved, &base);
+        if (err.is_err()) {
+            return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+        }
+        m_buffer = reinterpret_cast<T*>(base);
+        m_capacity = new_size / sizeof(T);
+        m_reserved = new_reserved;
+        return ErrorCode::SUCCESS;
+    }
+
+    T* new_buffer;
+    size_t new_reserved = 0;
+    if (new_size > s_RESERVE_THRESHOLD) {
+        new_reserved = align_up(new_size, s_RESERVATION_SIZE);
+        vaddr_t base;
+        error err = kvspace::reserve_region(new_reserved, riscv::paging::PAGE_SIZE, &base);
+        if (err.is_err()) {
+            return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+        }
+        err = kvspace::map_region(base, new_size);
+        if (err.is_err()) {
+            error undo = kvspace::release_region(base, new_reserved);
+            assert_err(undo);
+            return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+        }
+        new_buffer = reinterpret_cast<T*>(base);
+    } else {
+        paddr_t new_pa;
+        error err = pmm::alloc(new_size, &new_pa);
+        if (err.is_err()) {
+            return err.push(ErrorCode::DYN_ARR_REALLOC_FAILURE);
+        }
+        new_buffer = static_cast<T*>(limine::hhdm_phys_to_virt(new_pa));
+    }
+
+    if (m_buffer != nullptr) {
+        relocate(m_buffer, new_buffer, m_size);
+        error err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        assert_err(err);
     }
     m_buffer = new_buffer;
-    m_capacity = new_count;
+    m_capacity = new_size / sizeof(T);
+    m_reserved = new_reserved;
+    return ErrorCode::SUCCESS;
+}
+
+template<typename T>
+error
+dynamic_array<T>::grow()
+{
+    return reserve(m_capacity + m_capacity / 2 + 1);
+}
+
+template<typename T>
+void
+dynamic_array<T>::push_back(T value)
+{
+    emplace_back(std::move(value));
+}
+
+template<typename T>
+template<typename... Args>
+T*
+dynamic_array<T>::emplace_back(Args&&... args)
+{
+    if (m_size == m_capacity) [[unlikely]] {
+        error err = grow();
+        assert(err.is_ok(), err.str());
+    }
+    T* obj = new (&m_buffer[m_size]) T{ std::forward<Args>(args)... };
+    m_size++;
+    return obj;
 }
 
 template<typename T>
 void
-push_back(T value)
+dynamic_array<T>::pop_back()
 {
-}
\ No newline at end of file
+    assert(m_size > 0);
+    m_size--;
+    m_buffer[m_size].~T();
+}
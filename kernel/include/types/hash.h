@@ -0,0 +1,78 @@
+/// Hash functions and key equality used by the kernel's associative containers.
+#pragma once
+
+#include <types/number.h>
+#include <types/str_view.h>
+
+/// Defines how to hash values of type T, allowing for specialization by each type.
+template<typename T>
+struct hash;
+
+/// Defines how to compare keys of type T for equality. Defaults to `operator==`.
+template<typename T>
+struct key_equal
+{
+    static bool equal(const T& lhs, const T& rhs) { return lhs == rhs; }
+};
+
+namespace hash_details {
+
+constexpr u64 K0 = 0x9E3779B97F4A7C15ULL;
+constexpr u64 K1 = 0xBF58476D1CE4E5B9ULL;
+
+/// Folds the full 128-bit product of `lhs` and `rhs` into 64 bits. On rv64 this is a `mul` and a
+/// `mulhu`.
+inline u64
+mix(u64 lhs, u64 rhs)
+{
+    u128 product = static_cast<u128>(lhs) * rhs;
+    return static_cast<u64>(product) ^ static_cast<u64>(product >> 64);
+}
+
+/// Hashes `len` bytes a word at a time.
+inline u64
+hash_bytes(const void* data, size_t len)
+{
+    const u8* bytes = static_cast<const u8*>(data);
+    u64 h = K0 ^ (len * K1);
+    for (; len >= sizeof(u64); len -= sizeof(u64), bytes += sizeof(u64)) {
+        h = mix(h ^ num::read_little_endian<u64>(bytes), K1);
+    }
+    if (len != 0) {
+        u64 tail = 0;
+        for (size_t i = 0; i < len; i++) {
+            tail |= static_cast<u64>(bytes[i]) << (8 * i);
+        }
+        h = mix(h ^ tail, K1);
+    }
+    return mix(h, K0);
+}
+
+} // namespace hash_details
+
+template<Unsigned T>
+struct hash<T>
+{
+    static u64 get(T value)
+    {
+        return hash_details::mix(static_cast<u64>(value) ^ hash_details::K1, hash_details::K0);
+    }
+};
+
+template<>
+struct hash<str_view>
+{
+    static u64 get(str_view value)
+    {
+        return hash_details::hash_bytes(value.data(), value.length());
+    }
+};
+
+template<>
+struct key_equal<str_view>
+{
+    static bool equal(str_view lhs, str_view rhs)
+    {
+        return lhs.length() == rhs.length() && str_view::compare(lhs, rhs) == 0;
+    }
+};
@@ -0,0 +1,442 @@
+/// Open addressing hash map in the style of a Swiss table: a byte of control metadata per slot
+/// holding 7 bits of the hash, scanned 8 slots at a time with SWAR tricks so that most lookups
+/// only ever compare the one key that actually matches. Relies on the pmm and hhdm for memory.
+#pragma once
+
+#include <fmt/assert.h>
+#include <limine/platform_info.h>
+#include <memory.h>
+#include <new>
+#include <pmm.h>
+#include <riscv/paging.h>
+#include <type_traits>
+#include <types/error.h>
+#include <types/hash.h>
+#include <types/number.h>
+#include <utility>
+
+namespace hash_map_details {
+
+/// Control byte of a slot that has never been used. Probe sequences stop at these.
+constexpr u8 CTRL_EMPTY = 0x80;
+/// Control byte of a slot whose entry was erased. Probe sequences continue past these.
+constexpr u8 CTRL_DELETED = 0xFE;
+
+/// Slots are probed in aligned groups of this many, one u64 of control bytes at a time.
+constexpr size_t GROUP_WIDTH = sizeof(u64);
+
+constexpr u64 LOW_BITS = 0x0101010101010101ULL;
+constexpr u64 HIGH_BITS = 0x8080808080808080ULL;
+
+/// Sets the high bit of every byte in `group` that equals `h2`. May report false positives on
+/// full slots above a real match, which the key comparison filters out.
+inline u64
+match(u64 group, u8 h2)
+{
+    u64 x = group ^ (LOW_BITS * h2);
+    return (x - LOW_BITS) & ~x & HIGH_BITS;
+}
+
+/// Sets the high bit of every EMPTY byte in `group`.
+inline u64
+match_empty(u64 group)
+{
+    return group & ~(group << 6) & HIGH_BITS;
+}
+
+/// Sets the high bit of every EMPTY or DELETED byte in `group`.
+inline u64
+match_empty_or_deleted(u64 group)
+{
+    return group & ~(group << 7) & HIGH_BITS;
+}
+
+/// Returns the index of the lowest byte flagged in a `match*` mask.
+inline size_t
+first_byte(u64 mask)
+{
+    return num::count_trailing_zeros(mask) / 8;
+}
+
+} // namespace hash_map_details
+
+template<typename K, typename V, typename Hash = hash<K>, typename Eq = key_equal<K>>
+class hash_map
+{
+public:
+    struct entry
+    {
+        K key;
+        V value;
+    };
+
+    /// Creates an empty map. No memory is allocated until the first insertion.
+    hash_map();
+
+    /// Move constructor.
+    hash_map(hash_map&& other) noexcept;
+
+    hash_map(const hash_map&) = delete;
+
+    /// Destroys all entries and returns the table to the pmm.
+    ~hash_map();
+
+    /// Move assignment.
+    hash_map& operator=(hash_map&& other) noexcept;
+
+    hash_map& operator=(const hash_map&) = delete;
+
+    /// Makes room for at least `count` entries without rehashing.
+    error reserve(size_t count);
+
+    /// Inserts `key` with `value`, replacing the value if the key is already present.
+    error insert(K key, V value);
+
+    /// Returns a pointer to the value stored for `key`, or nullptr if it isn't present.
+    V* find(const K& key);
+    const V* find(const K& key) const;
+
+    /// Returns true if `key` is present.
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    /// Removes `key`, returning true if it was present.
+    bool erase(const K& key);
+
+    /// Removes all entries, keeping the table.
+    void clear();
+
+    /// Calls `fn(key, value)` for every entry, in no particular order.
+    template<typename F>
+    void for_each(F&& fn);
+
+    /// Returns the number of entries.
+    size_t size() const { return m_size; }
+
+    /// Returns the number of slots in the table.
+    size_t capacity() const { return m_capacity; }
+
+    /// Checks whether the container is empty.
+    bool empty() const { return m_size == 0; }
+
+private:
+    /// Returns the index of the slot holding `key`, or `s_NOT_FOUND`.
+    size_t find_index(const K& key, u64 hash) const;
+
+    /// Returns the index of the first free slot on the probe sequence of `hash`.
+    size_t find_free_index(u64 hash) const;
+
+    /// Sets the control byte of slot `index`.
+    void set_ctrl(size_t index, u8 ctrl) { m_ctrl[index] = ctrl; }
+
+    /// Loads the aligned group of control bytes with index `group`.
+    u64 load_group(size_t group) const
+    {
+        using word_t = u64 __attribute__((may_alias));
+        return reinterpret_cast<const word_t*>(m_ctrl)[group];
+    }
+
+    /// Replaces the table with one of `new_capacity` slots and reinserts every entry.
+    error rehash(size_t new_capacity);
+
+    /// Destroys all entries and frees the table.
+    void release();
+
+    /// Maximum number of entries in a table with `capacity` slots (a 7/8 load factor).
+    static constexpr size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+    /// Byte offset of the slot array in the table allocation.
+    static constexpr size_t slots_offset(size_t capacity)
+    {
+        return align_up(capacity, alignof(entry));
+    }
+
+    static u64 h1(u64 hash) { return hash >> 7; }
+    static u8 h2(u64 hash) { return static_cast<u8>(hash & 0x7F); }
+
+    static constexpr size_t s_NOT_FOUND = static_cast<size_t>(-1);
+
+    /// One control byte per slot, `m_capacity` of them.
+    u8* m_ctrl;
+    /// Slot storage, only slots with a full control byte hold a constructed entry.
+    entry* m_slots;
+    /// Number of slots, zero or a power of two no smaller than GROUP_WIDTH.
+    size_t m_capacity;
+    /// Number of entries.
+    size_t m_size;
+    /// Number of EMPTY slots that can still be filled before the table must grow.
+    size_t m_growth_left;
+};
+
+template<typename K, typename V, typename Hash, typename Eq>
+hash_map<K, V, Hash, Eq>::hash_map()
+  : m_ctrl(nullptr)
+  , m_slots(nullptr)
+  , m_capacity(0)
+  , m_size(0)
+  , m_growth_left(0)
+{
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+hash_map<K, V, Hash, Eq>::hash_map(hash_map&& other) noexcept
+  : m_ctrl(other.m_ctrl)
+  , m_slots(other.m_slots)
+  , m_capacity(other.m_capacity)
+  , m_size(other.m_size)
+  , m_growth_left(other.m_growth_left)
+{
+    other.m_ctrl = nullptr;
+    other.m_slots = nullptr;
+    other.m_capacity = 0;
+    other.m_size = 0;
+    other.m_growth_left = 0;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+hash_map<K, V, Hash, Eq>::~hash_map()
+{
+    release();
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+hash_map<K, V, Hash, Eq>&
+hash_map<K, V, Hash, Eq>::operator=(hash_map&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_ctrl = other.m_ctrl;
+        m_slots = other.m_slots;
+        m_capacity = other.m_capacity;
+        m_size = other.m_size;
+        m_growth_left = other.m_growth_left;
+        other.m_ctrl = nullptr;
+        other.m_slots = nullptr;
+        other.m_capacity = 0;
+        other.m_size = 0;
+        other.m_growth_left = 0;
+    }
+    return *this;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+void
+hash_map<K, V, Hash, Eq>::release()
+{
+    clear();
+    if (m_ctrl != nullptr) {
+        error err = pmm::free(limine::hhdm_virt_to_phys(m_ctrl));
+        assert_err(err);
+    }
+    m_ctrl = nullptr;
+    m_slots = nullptr;
+    m_capacity = 0;
+    m_growth_left = 0;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+void
+hash_map<K, V, Hash, Eq>::clear()
+{
+    for (size_t i = 0; i < m_capacity; i++) {
+        if (static_cast<i8>(m_ctrl[i]) >= 0) {
+            m_slots[i].~entry();
+        }
+    }
+    if (m_ctrl != nullptr) {
+        mem::fill(m_ctrl, hash_map_details::CTRL_EMPTY, m_capacity);
+    }
+    m_size = 0;
+    m_growth_left = max_load(m_capacity);
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+error
+hash_map<K, V, Hash, Eq>::rehash(size_t new_capacity)
+{
+    using namespace hash_map_details;
+
+    size_t table_size = slots_offset(new_capacity) + new_capacity * sizeof(entry);
+    paddr_t pa;
+    error err = pmm::alloc(table_size, &pa);
+    if (err.is_err()) {
+        return err;
+    }
+
+    u8* old_ctrl = m_ctrl;
+    entry* old_slots = m_slots;
+    size_t old_capacity = m_capacity;
+
+    m_ctrl = static_cast<u8*>(limine::hhdm_phys_to_virt(pa));
+    m_slots = reinterpret_cast<entry*>(m_ctrl + slots_offset(new_capacity));
+    m_capacity = new_capacity;
+    m_growth_left = max_load(new_capacity) - m_size;
+    mem::fill(m_ctrl, CTRL_EMPTY, new_capacity);
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (static_cast<i8>(old_ctrl[i]) < 0) {
+            continue;
+        }
+        u64 hash = Hash::get(old_slots[i].key);
+        size_t index = find_free_index(hash);
+        set_ctrl(index, h2(hash));
+        new (&m_slots[index]) entry(std::move(old_slots[i]));
+        old_slots[i].~entry();
+    }
+
+    if (old_ctrl != nullptr) {
+        err = pmm::free(limine::hhdm_virt_to_phys(old_ctrl));
+        assert_err(err);
+    }
+    return ErrorCode::SUCCESS;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+error
+hash_map<K, V, Hash, Eq>::reserve(size_t count)
+{
+    if (count <= m_size + m_growth_left) {
+        return ErrorCode::SUCCESS;
+    }
+
+    size_t new_capacity = hash_map_details::GROUP_WIDTH;
+    while (max_load(new_capacity) < count) {
+        new_capacity *= 2;
+    }
+    return rehash(new_capacity);
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+size_t
+hash_map<K, V, Hash, Eq>::find_index(const K& key, u64 hash) const
+{
+    using namespace hash_map_details;
+
+    if (m_capacity == 0) {
+        return s_NOT_FOUND;
+    }
+
+    // Triangular probing over groups visits every group once when the group count is a power of
+    // two.
+    size_t group_mask = m_capacity / GROUP_WIDTH - 1;
+    size_t group = h1(hash) & group_mask;
+    for (size_t step = 1;; step++) {
+        u64 ctrl = load_group(group);
+        for (u64 matches = match(ctrl, h2(hash)); matches != 0; matches &= matches - 1) {
+            size_t index = group * GROUP_WIDTH + first_byte(matches);
+            if (Eq::equal(m_slots[index].key, key)) [[likely]] {
+                return index;
+            }
+        }
+        if (match_empty(ctrl) != 0) {
+            return s_NOT_FOUND;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+size_t
+hash_map<K, V, Hash, Eq>::find_free_index(u64 hash) const
+{
+    using namespace hash_map_details;
+
+    size_t group_mask = m_capacity / GROUP_WIDTH - 1;
+    size_t group = h1(hash) & group_mask;
+    for (size_t step = 1;; step++) {
+        u64 free = match_empty_or_deleted(load_group(group));
+        if (free != 0) {
+            return group * GROUP_WIDTH + first_byte(free);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+error
+hash_map<K, V, Hash, Eq>::insert(K key, V value)
+{
+    u64 hash = Hash::get(key);
+    size_t index = find_index(key, hash);
+    if (index != s_NOT_FOUND) {
+        m_slots[index].value = std::move(value);
+        return ErrorCode::SUCCESS;
+    }
+
+    if (m_capacity == 0) {
+        error err = reserve(1);
+        if (err.is_err()) {
+            return err;
+        }
+    }
+
+    index = find_free_index(hash);
+    if (m_ctrl[index] == hash_map_details::CTRL_EMPTY && m_growth_left == 0) {
+        // Rehashing also drops the tombstones, so only grow if they aren't the problem.
+        size_t new_capacity = (m_size + 1 > max_load(m_capacity) / 2) ? m_capacity * 2 : m_capacity;
+        error err = rehash(new_capacity);
+        if (err.is_err()) {
+            return err;
+        }
+        index = find_free_index(hash);
+    }
+
+    if (m_ctrl[index] == hash_map_details::CTRL_EMPTY) {
+        m_growth_left--;
+    }
+    set_ctrl(index, h2(hash));
+    new (&m_slots[index]) entry{ std::move(key), std::move(value) };
+    m_size++;
+    return ErrorCode::SUCCESS;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+V*
+hash_map<K, V, Hash, Eq>::find(const K& key)
+{
+    size_t index = find_index(key, Hash::get(key));
+    return (index == s_NOT_FOUND) ? nullptr : &m_slots[index].value;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+const V*
+hash_map<K, V, Hash, Eq>::find(const K& key) const
+{
+    size_t index = find_index(key, Hash::get(key));
+    return (index == s_NOT_FOUND) ? nullptr : &m_slots[index].value;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+bool
+hash_map<K, V, Hash, Eq>::erase(const K& key)
+{
+    using namespace hash_map_details;
+
+    size_t index = find_index(key, Hash::get(key));
+    if (index == s_NOT_FOUND) {
+        return false;
+    }
+
+    m_slots[index].~entry();
+    m_size--;
+    // If the group still has an EMPTY slot, no probe sequence ever continued past it, so the slot
+    // can become EMPTY again instead of leaving a tombstone.
+    if (match_empty(load_group(index / GROUP_WIDTH)) != 0) {
+        set_ctrl(index, CTRL_EMPTY);
+        m_growth_left++;
+    } else {
+        set_ctrl(index, CTRL_DELETED);
+    }
+    return true;
+}
+
+template<typename K, typename V, typename Hash, typename Eq>
+template<typename F>
+void
+hash_map<K, V, Hash, Eq>::for_each(F&& fn)
+{
+    for (size_t i = 0; i < m_capacity; i++) {
+        if (static_cast<i8>(m_ctrl[i]) >= 0) {
+            fn(m_slots[i].key, m_slots[i].value);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/// Intrusive doubly linked list. Objects carry their own `list_node`, so insertion never allocates
+/// and removal of a known object is O(1).
+#pragma once
+
+#include <fmt/assert.h>
+#include <types/container_of.h>
+#include <types/number.h>
+
+/// Link embedded in objects stored in an `intrusive_list`.
+struct list_node
+{
+    list_node* prev = nullptr;
+    list_node* next = nullptr;
+
+    /// Returns true if the node is currently in a list.
+    bool is_linked() const { return next != nullptr; }
+};
+
+template<typename T, list_node T::*Member>
+class intrusive_list
+{
+public:
+    /// Creates an empty list.
+    constexpr intrusive_list()
+      : m_head{ &m_head, &m_head }
+      , m_size(0)
+    {
+    }
+
+    // The sentinel points to itself, so lists can't be copied or moved.
+    intrusive_list(const intrusive_list&) = delete;
+    intrusive_list& operator=(const intrusive_list&) = delete;
+
+    /// Returns the first object, or nullptr if the list is empty.
+    T* front() { return owner(m_head.next); }
+
+    /// Returns the last object, or nullptr if the list is empty.
+    T* back() { return owner(m_head.prev); }
+
+    /// Returns the object after `obj`, or nullptr if `obj` is the last one.
+    T* next(T* obj) { return owner(node(obj)->next); }
+
+    /// Returns the object before `obj`, or nullptr if `obj` is the first one.
+    T* prev(T* obj) { return owner(node(obj)->prev); }
+
+    /// Inserts `obj` at the front of the list.
+    void push_front(T* obj) { link(node(obj), &m_head, m_head.next); }
+
+    /// Inserts `obj` at the back of the list.
+    void push_back(T* obj) { link(node(obj), m_head.prev, &m_head); }
+
+    /// Inserts `obj` right before `pos`. A null `pos` inserts at the back.
+    void insert_before(T* pos, T* obj)
+    {
+        list_node* at = (pos == nullptr) ? &m_head : node(pos);
+        link(node(obj), at->prev, at);
+    }
+
+    /// Inserts `obj` right after `pos`. A null `pos` inserts at the front.
+    void insert_after(T* pos, T* obj)
+    {
+        list_node* at = (pos == nullptr) ? &m_head : node(pos);
+        link(node(obj), at, at->next);
+    }
+
+    /// Unlinks `obj`, which must be in this list.
+    void remove(T* obj)
+    {
+        list_node* n = node(obj);
+        assert(n->is_linked());
+        n->prev->next = n->next;
+        n->next->prev = n->prev;
+        n->prev = nullptr;
+        n->next = nullptr;
+        m_size--;
+    }
+
+    /// Unlinks and returns the first object, or nullptr if the list is empty.
+    T* pop_front()
+    {
+        T* obj = front();
+        if (obj != nullptr) {
+            remove(obj);
+        }
+        return obj;
+    }
+
+    /// Checks whether the container is empty.
+    bool empty() const { return m_size == 0; }
+
+    /// Returns the number of objects in the list.
+    size_t size() const { return m_size; }
+
+    class iterator
+    {
+    public:
+        explicit iterator(list_node* n)
+          : m_node(n)
+        {
+        }
+        T& operator*() const { return *owner_of(m_node); }
+        T* operator->() const { return owner_of(m_node); }
+        iterator& operator++()
+        {
+            m_node = m_node->next;
+            return *this;
+        }
+        bool operator!=(const iterator& other) const { return m_node != other.m_node; }
+
+    private:
+        list_node* m_node;
+    };
+
+    iterator begin() { return iterator(m_head.next); }
+    iterator end() { return iterator(&m_head); }
+
+private:
+    static list_node* node(T* obj) { return &(obj->*Member); }
+
+    static T* owner_of(list_node* n)
+    {
+        return intrusive_details::container_of<T, list_node, Member>(n);
+    }
+
+    /// Like `owner_of`, but maps the sentinel to nullptr.
+    T* owner(list_node* n) { return (n == &m_head) ? nullptr : owner_of(n); }
+
+    void link(list_node* n, list_node* prev, list_node* next)
+    {
+        assert(!n->is_linked());
+        n->prev = prev;
+        n->next = next;
+        prev->next = n;
+        next->prev = n;
+        m_size++;
+    }
+
+    /// Sentinel node, `m_head.next` is the first element and `m_head.prev` the last.
+    list_node m_head;
+    size_t m_size;
+};
@@ -84,49 +84,95 @@ min(T lhs, T rhs)
     return (lhs < rhs) ? lhs : rhs;
 }
 
+/// Maximum function
+template<Unsigned T>
+constexpr T
+max(T lhs, T rhs)
+{
+    return (lhs < rhs) ? rhs : lhs;
+}
+
 inline u16
 flip_endianness(u16 num)
 {
-    return (num >> 8) | (num << 8);
+    return __builtin_bswap16(num);
 }
 
 inline u32
 flip_endianness(u32 num)
 {
-    return ((num >> 24) & 0x000000FF) | ((num >> 8) & 0x0000FF00) | ((num << 8) & 0x00FF0000) |
-           ((num << 24) & 0xFF000000);
+    return __builtin_bswap32(num);
 }
 
+/// Lowers to a single `rev8` on harts with Zbb.
 inline u64
 flip_endianness(u64 num)
 {
-    return ((num >> 56) & 0x00000000000000FFULL) | ((num >> 40) & 0x000000000000FF00ULL) |
-           ((num >> 24) & 0x0000000000FF0000ULL) | ((num >> 8) & 0x00000000FF000000ULL) |
-           ((num << 8) & 0x000000FF00000000ULL) | ((num << 24) & 0x0000FF0000000000ULL) |
-           ((num << 40) & 0x00FF000000000000ULL) | ((num << 56) & 0xFF00000000000000ULL);
+    return __builtin_bswap64(num);
 }
 
 inline u128
 flip_endianness(u128 num)
 {
-    union
-    {
-        u128 val;
-        u8 bytes[16];
-    } src, dst;
+    return (static_cast<u128>(__builtin_bswap64(static_cast<u64>(num))) << 64) |
+           __builtin_bswap64(static_cast<u64>(num >> 64));
+}
 
-    src.val = num;
-    for (int i = 0; i < 16; i++) {
-        dst.bytes[i] = src.bytes[15 - i];
-    }
-    return dst.val;
+/// Returns the number of trailing zero bits in `value`, which must be non-zero. Harts with Zbb use
+/// `ctz`, everything else a de Bruijn multiply, since `__builtin_ctzll` would otherwise become a
+/// libgcc call.
+inline u32
+count_trailing_zeros(u64 value)
+{
+#if defined(__riscv_zbb)
+    return __builtin_ctzll(value);
+#else
+    static constexpr u8 table[64] = { 0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38,
+                                      29, 17, 4,  62, 55, 59, 36, 53, 51, 43, 22, 45, 39,
+                                      33, 30, 24, 18, 12, 5,  63, 47, 56, 27, 60, 41, 37,
+                                      16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15,
+                                      34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6 };
+    return table[((value & -value) * 0x03F79D71B4CB0A89ULL) >> 58];
+#endif
 }
 
-template<Unsigned U>
-U
+/// Reads a little endian (i.e. native) `U` from `ptr`, which only needs to be aligned to `Align`
+/// bytes.
+template<Unsigned U, size_t Align = 1>
+inline U
+read_little_endian(const void* ptr)
+{
+    struct __attribute__((packed, aligned(Align), may_alias)) wrapper
+    {
+        U value;
+    };
+    return static_cast<const wrapper*>(ptr)->value;
+}
+
+/// Reads a big endian `U` from `ptr`, which only needs to be aligned to `Align` bytes. The default
+/// handles completely unaligned input; callers that know better (e.g. device tree cells are always
+/// 4-byte aligned) should say so, which lets the compiler use word loads instead of byte loads.
+template<Unsigned U, size_t Align = 1>
+inline U
 read_big_endian(const void* ptr)
 {
-    return flip_endianness(*(U*)(ptr));
+    struct __attribute__((packed, aligned(Align), may_alias)) wrapper
+    {
+        U value;
+    };
+    return flip_endianness(static_cast<const wrapper*>(ptr)->value);
+}
+
+/// Reads `count` big endian `U`s spaced `stride` bytes apart from `src` into `dst`. The iterations
+/// are independent, so the compiler is free to unroll or vectorize the loop.
+template<Unsigned U, size_t Align = 1>
+inline void
+read_big_endian_array(const void* src, U* dst, size_t count, size_t stride = sizeof(U))
+{
+    const u8* bytes = static_cast<const u8*>(src);
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = read_big_endian<U, Align>(bytes + i * stride);
+    }
 }
 
 } // namespace num
\ No newline at end of file
@@ -0,0 +1,104 @@
+/// Compile-time perfect hashing of a fixed set of strings.
+///
+/// `static_string_map` is built in a consteval context from a list of (key, value) pairs. It
+/// searches for a multiplier under which every key lands in its own slot, so a lookup is one hash
+/// of a few characters and at most one string compare, whatever the number of keys.
+#pragma once
+
+#include <types/number.h>
+#include <types/str_view.h>
+
+namespace perfect_hash_details {
+
+/// Summarizes `key` by its length and its first, middle and last characters. Keys in a map must
+/// differ in at least one of these.
+constexpr u64
+fingerprint(str_view key)
+{
+    size_t len = key.length();
+    if (len == 0) {
+        return 0;
+    }
+    return static_cast<u64>(len) | static_cast<u64>(static_cast<u8>(key[0])) << 16 |
+           static_cast<u64>(static_cast<u8>(key[len / 2])) << 24 |
+           static_cast<u64>(static_cast<u8>(key[len - 1])) << 32;
+}
+
+/// Not constexpr: reaching it while building a map turns into a compile error.
+inline void
+no_perfect_hash_found()
+{
+}
+
+} // namespace perfect_hash_details
+
+template<typename V, size_t N>
+class static_string_map
+{
+public:
+    struct entry
+    {
+        str_view key;
+        V value;
+    };
+
+    /// Builds the map. Fails to compile if two keys share a fingerprint.
+    consteval static_string_map(const entry (&entries)[N], V missing)
+      : m_missing(missing)
+    {
+        for (u64 seed = s_FIRST_SEED;; seed += 2) {
+            if (try_seed(entries, seed)) {
+                m_seed = seed;
+                return;
+            }
+            if (seed > s_FIRST_SEED + 2 * s_MAX_ATTEMPTS) {
+                perfect_hash_details::no_perfect_hash_found();
+            }
+        }
+    }
+
+    /// Returns the value stored for `key`, or the `missing` value given at construction.
+    constexpr V find(str_view key) const
+    {
+        const entry& e = m_slots[slot(perfect_hash_details::fingerprint(key), m_seed)];
+        if (key.length() == 0 || e.key.length() != key.length() ||
+            str_view::compare(e.key, key) != 0) {
+            return m_missing;
+        }
+        return e.value;
+    }
+
+private:
+    static constexpr size_t s_BITS = [] {
+        size_t bits = 1;
+        while ((1ULL << bits) < 4 * N) bits++;
+        return bits;
+    }();
+    static constexpr size_t s_SIZE = 1ULL << s_BITS;
+    static constexpr u64 s_FIRST_SEED = 0x9E3779B97F4A7C15ULL;
+    static constexpr size_t s_MAX_ATTEMPTS = 1 << 16;
+
+    static constexpr size_t slot(u64 fingerprint, u64 seed)
+    {
+        return static_cast<size_t>((fingerprint * seed) >> (64 - s_BITS));
+    }
+
+    consteval bool try_seed(const entry (&entries)[N], u64 seed)
+    {
+        bool used[s_SIZE] = {};
+        size_t slots[N] = {};
+        for (size_t i = 0; i < N; i++) {
+            slots[i] = slot(perfect_hash_details::fingerprint(entries[i].key), seed);
+            if (used[slots[i]]) {
+                return false;
+            }
+            used[slots[i]] = true;
+        }
+        for (size_t i = 0; i < N; i++) m_slots[slots[i]] = entries[i];
+        return true;
+    }
+
+    entry m_slots[s_SIZE] = {};
+    u64 m_seed = 0;
+    V m_missing;
+};
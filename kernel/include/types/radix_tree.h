@@ -0,0 +1,335 @@
+/// Sparse map from 64-bit indices (typically page indices) to pointers, stored as a radix tree with
+/// 64 slots per node. A lookup is one dependent load per level, and a tree only grows as tall as
+/// its largest index needs: indices below 2^18 fit in three levels.
+///
+/// Lookups (`find`, `find_next`, `for_each`) take no locks and may run concurrently with a writer.
+/// Nodes are fully built before a release store publishes them, and readers follow slots with
+/// acquire loads. Writers must be serialized by the caller. `erase` never frees nodes, so a
+/// concurrent reader never follows a dangling pointer. `prune` frees the nodes `erase` left empty
+/// and must only run once no reader can still be inside the tree.
+#pragma once
+
+#include <types/atomic.h>
+#include <types/error.h>
+#include <types/number.h>
+
+namespace radix_details {
+
+constexpr size_t BITS_PER_LEVEL = 6;
+constexpr size_t FANOUT = 1 << BITS_PER_LEVEL;
+constexpr size_t SLOT_MASK = FANOUT - 1;
+
+struct node
+{
+    /// Child nodes, or the stored values if `shift` is zero.
+    atomic<void*> slots[FANOUT];
+    /// Number of index bits below this node's slot index.
+    u8 shift;
+    /// Number of non-null slots.
+    u8 count;
+};
+
+/// Returns the largest index a node with the given `shift` can hold.
+constexpr u64
+max_index(size_t shift)
+{
+    return (shift + BITS_PER_LEVEL >= 64) ? ~0ULL : (1ULL << (shift + BITS_PER_LEVEL)) - 1;
+}
+
+/// Returns the shift of the smallest root node that can hold `index`.
+constexpr u8
+shift_for(u64 index)
+{
+    u8 shift = 0;
+    while (index > max_index(shift)) shift += BITS_PER_LEVEL;
+    return shift;
+}
+
+/// Allocates an empty node from the shared node allocator, or returns nullptr if out of memory.
+node*
+alloc_node(u8 shift);
+
+/// Returns a node to the shared node allocator.
+void
+free_node(node* n);
+
+} // namespace radix_details
+
+template<typename T>
+class radix_tree
+{
+public:
+    /// Creates an empty tree.
+    constexpr radix_tree() = default;
+
+    radix_tree(const radix_tree&) = delete;
+    radix_tree& operator=(const radix_tree&) = delete;
+
+    /// Frees the tree's nodes. The stored values are not touched.
+    ~radix_tree();
+
+    /// Returns the value stored at `index`, or nullptr.
+    T* find(u64 index) const;
+
+    /// Returns the value with the smallest index not below `index` and stores that index in
+    /// `found`, or returns nullptr if there is none.
+    T* find_next(u64 index, u64* found) const;
+
+    /// Calls `fn(index, value)` for each value with an index in [first, last], in index order.
+    /// Stops early if `fn` returns false.
+    template<typename F>
+    void for_each(u64 first, u64 last, F&& fn) const;
+
+    /// Stores `value`, which must not be null, at `index`.
+    error insert(u64 index, T* value);
+
+    /// Removes and returns the value at `index`, or returns nullptr if there is none.
+    T* erase(u64 index);
+
+    /// Frees the nodes left empty by `erase` and shrinks the tree's height where possible.
+    void prune();
+
+    /// Checks whether the container is empty.
+    bool empty() const { return m_size == 0; }
+
+    /// Returns the number of values in the tree.
+    size_t size() const { return m_size; }
+
+private:
+    using node = radix_details::node;
+
+    static T* next_in(const node* n, u64 index, u64* found);
+
+    /// Frees the empty nodes below `n`, and `n` itself if it ends up empty. Returns whether `n` was
+    /// freed.
+    static bool prune_node(node* n);
+
+    /// Frees `n` and every node below it.
+    static void destroy_node(node* n);
+
+    atomic<node*> m_root = nullptr;
+    size_t m_size = 0;
+};
+
+template<typename T>
+radix_tree<T>::~radix_tree()
+{
+    node* root = m_root.load(memory_order::RELAXED);
+    if (root != nullptr) {
+        destroy_node(root);
+    }
+}
+
+template<typename T>
+T*
+radix_tree<T>::find(u64 index) const
+{
+    const node* n = m_root.load(memory_order::ACQUIRE);
+    if (n == nullptr || index > radix_details::max_index(n->shift)) {
+        return nullptr;
+    }
+
+    while (true) {
+        void* entry =
+          n->slots[(index >> n->shift) & radix_details::SLOT_MASK].load(memory_order::ACQUIRE);
+        if (n->shift == 0 || entry == nullptr) {
+            return static_cast<T*>(entry);
+        }
+        n = static_cast<const node*>(entry);
+    }
+}
+
+template<typename T>
+T*
+radix_tree<T>::next_in(const node* n, u64 index, u64* found)
+{
+    // Slots after the first one are searched from the start of their range.
+    u64 base = index & ~radix_details::max_index(n->shift);
+    for (size_t slot = (index >> n->shift) & radix_details::SLOT_MASK;
+         slot < radix_details::FANOUT;
+         slot++) {
+        u64 start = num::max(base | (static_cast<u64>(slot) << n->shift), index);
+        void* entry = n->slots[slot].load(memory_order::ACQUIRE);
+        if (entry == nullptr) {
+            continue;
+        }
+        if (n->shift == 0) {
+            *found = start;
+            return static_cast<T*>(entry);
+        }
+        T* value = next_in(static_cast<const node*>(entry), start, found);
+        if (value != nullptr) {
+            return value;
+        }
+    }
+    return nullptr;
+}
+
+template<typename T>
+T*
+radix_tree<T>::find_next(u64 index, u64* found) const
+{
+    const node* root = m_root.load(memory_order::ACQUIRE);
+    if (root == nullptr || index > radix_details::max_index(root->shift)) {
+        return nullptr;
+    }
+    return next_in(root, index, found);
+}
+
+template<typename T>
+template<typename F>
+void
+radix_tree<T>::for_each(u64 first, u64 last, F&& fn) const
+{
+    u64 index = first;
+    while (index <= last) {
+        u64 found;
+        T* value = find_next(index, &found);
+        if (value == nullptr || found > last || !fn(found, value) || found == ~0ULL) {
+            return;
+        }
+        index = found + 1;
+    }
+}
+
+template<typename T>
+error
+radix_tree<T>::insert(u64 index, T* value)
+{
+    if (value == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+
+    node* root = m_root.load(memory_order::RELAXED);
+    if (root == nullptr) {
+        root = radix_details::alloc_node(radix_details::shift_for(index));
+        if (root == nullptr) {
+            return ErrorCode::RADIX_ALLOC_FAILED;
+        }
+        m_root.store(root, memory_order::RELEASE);
+    }
+
+    // Grow the tree by stacking new roots on top. A reader holding the old root still sees every
+    // index it could see before.
+    while (index > radix_details::max_index(root->shift)) {
+        node* top = radix_details::alloc_node(root->shift + radix_details::BITS_PER_LEVEL);
+        if (top == nullptr) {
+            return ErrorCode::RADIX_ALLOC_FAILED;
+        }
+        top->slots[0].store(root, memory_order::RELAXED);
+        top->count = 1;
+        m_root.store(top, memory_order::RELEASE);
+        root = top;
+    }
+
+    node* n = root;
+    while (n->shift != 0) {
+        atomic<void*>& slot = n->slots[(index >> n->shift) & radix_details::SLOT_MASK];
+        node* child = static_cast<node*>(slot.load(memory_order::RELAXED));
+        if (child == nullptr) {
+            child = radix_details::alloc_node(n->shift - radix_details::BITS_PER_LEVEL);
+            if (child == nullptr) {
+                return ErrorCode::RADIX_ALLOC_FAILED;
+            }
+            slot.store(child, memory_order::RELEASE);
+            n->count++;
+        }
+        n = child;
+    }
+
+    atomic<void*>& slot = n->slots[index & radix_details::SLOT_MASK];
+    if (slot.load(memory_order::RELAXED) != nullptr) {
+        return ErrorCode::RADIX_INDEX_PRESENT;
+    }
+    slot.store(value, memory_order::RELEASE);
+    n->count++;
+    m_size++;
+    return ErrorCode::SUCCESS;
+}
+
+template<typename T>
+T*
+radix_tree<T>::erase(u64 index)
+{
+    node* n = m_root.load(memory_order::RELAXED);
+    if (n == nullptr || index > radix_details::max_index(n->shift)) {
+        return nullptr;
+    }
+
+    while (n->shift != 0) {
+        n = static_cast<node*>(
+          n->slots[(index >> n->shift) & radix_details::SLOT_MASK].load(memory_order::RELAXED));
+        if (n == nullptr) {
+            return nullptr;
+        }
+    }
+
+    atomic<void*>& slot = n->slots[index & radix_details::SLOT_MASK];
+    T* value = static_cast<T*>(slot.load(memory_order::RELAXED));
+    if (value != nullptr) {
+        slot.store(nullptr, memory_order::RELEASE);
+        n->count--;
+        m_size--;
+    }
+    return value;
+}
+
+template<typename T>
+bool
+radix_tree<T>::prune_node(node* n)
+{
+    if (n->shift != 0) {
+        for (size_t slot = 0; slot < radix_details::FANOUT; slot++) {
+            node* child = static_cast<node*>(n->slots[slot].load(memory_order::RELAXED));
+            if (child != nullptr && prune_node(child)) {
+                n->slots[slot].store(nullptr, memory_order::RELAXED);
+                n->count--;
+            }
+        }
+    }
+    if (n->count != 0) {
+        return false;
+    }
+    radix_details::free_node(n);
+    return true;
+}
+
+template<typename T>
+void
+radix_tree<T>::prune()
+{
+    node* root = m_root.load(memory_order::RELAXED);
+    if (root == nullptr) {
+        return;
+    }
+    if (prune_node(root)) {
+        m_root.store(nullptr, memory_order::RELEASE);
+        return;
+    }
+
+    // A root whose only child is in slot 0 adds a level without covering any extra index.
+    while (root->shift != 0 && root->count == 1) {
+        node* child = static_cast<node*>(root->slots[0].load(memory_order::RELAXED));
+        if (child == nullptr) {
+            break;
+        }
+        m_root.store(child, memory_order::RELEASE);
+        radix_details::free_node(root);
+        root = child;
+    }
+}
+
+template<typename T>
+void
+radix_tree<T>::destroy_node(node* n)
+{
+    if (n->shift != 0) {
+        for (size_t slot = 0; slot < radix_details::FANOUT; slot++) {
+            node* child = static_cast<node*>(n->slots[slot].load(memory_order::RELAXED));
+            if (child != nullptr) {
+                destroy_node(child);
+            }
+        }
+    }
+    radix_details::free_node(n);
+}
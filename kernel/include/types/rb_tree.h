@@ -0,0 +1,438 @@
+/// Intrusive red-black tree. Objects carry their own `rb_node`, so insertion never allocates, and
+/// lookups, insertion and removal are O(log n).
+///
+/// The ordering is given by a `Compare` policy with
+///     static bool less(const T& lhs, const T& rhs);
+/// and, for lookups by key,
+///     static int compare(const Key& key, const T& obj);   // <0, 0, >0
+///
+/// An optional `Augment` policy with `static void update(T* obj)` is called whenever the subtree
+/// below `obj` changes, bottom-up, so per-subtree summaries (e.g. the largest free range) can be
+/// maintained. `update` can inspect the children through `rb_tree::left`/`rb_tree::right`.
+#pragma once
+
+#include <types/container_of.h>
+#include <types/number.h>
+
+/// Node embedded in objects stored in an `rb_tree`.
+struct rb_node
+{
+    rb_node* parent = nullptr;
+    rb_node* left = nullptr;
+    rb_node* right = nullptr;
+    bool red = false;
+};
+
+/// Augment policy for trees without per-subtree data.
+struct rb_no_augment
+{
+    template<typename T>
+    static void update(T*)
+    {
+    }
+};
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment = rb_no_augment>
+class rb_tree
+{
+public:
+    /// Creates an empty tree.
+    constexpr rb_tree() = default;
+
+    /// Inserts `obj`. Objects comparing equal are kept, after the existing ones.
+    void insert(T* obj);
+
+    /// Removes `obj`, which must be in this tree.
+    void remove(T* obj);
+
+    /// Returns an object comparing equal to `key`, or nullptr.
+    template<typename Key>
+    T* find(const Key& key) const;
+
+    /// Returns the first object not ordered before `key`, or nullptr.
+    template<typename Key>
+    T* lower_bound(const Key& key) const;
+
+    /// Returns the last object not ordered after `key`, or nullptr.
+    template<typename Key>
+    T* floor(const Key& key) const;
+
+    /// Returns the smallest object, or nullptr if the tree is empty.
+    T* first() const { return owner(minimum(m_root)); }
+
+    /// Returns the largest object, or nullptr if the tree is empty.
+    T* last() const { return owner(maximum(m_root)); }
+
+    /// Returns the in-order successor of `obj`, or nullptr.
+    static T* next(T* obj);
+
+    /// Returns the in-order predecessor of `obj`, or nullptr.
+    static T* prev(T* obj);
+
+    /// Returns the root object, for custom descents over augmented trees.
+    T* root() const { return owner(m_root); }
+
+    /// Returns the left child of `obj`, or nullptr.
+    static T* left(const T* obj) { return owner(node(obj)->left); }
+
+    /// Returns the right child of `obj`, or nullptr.
+    static T* right(const T* obj) { return owner(node(obj)->right); }
+
+    /// Checks whether the container is empty.
+    bool empty() const { return m_root == nullptr; }
+
+    /// Returns the number of objects in the tree.
+    size_t size() const { return m_size; }
+
+private:
+    static rb_node* node(T* obj) { return &(obj->*Member); }
+    static const rb_node* node(const T* obj) { return &(obj->*Member); }
+
+    static T* owner(rb_node* n) { return intrusive_details::container_of<T, rb_node, Member>(n); }
+    static T* owner(const rb_node* n) { return owner(const_cast<rb_node*>(n)); }
+
+    static rb_node* minimum(rb_node* n)
+    {
+        if (n != nullptr) {
+            while (n->left != nullptr) n = n->left;
+        }
+        return n;
+    }
+
+    static rb_node* maximum(rb_node* n)
+    {
+        if (n != nullptr) {
+            while (n->right != nullptr) n = n->right;
+        }
+        return n;
+    }
+
+    static bool is_red(const rb_node* n) { return n != nullptr && n->red; }
+
+    /// Recomputes the augmented data of `n` and all of its ancestors.
+    static void propagate(rb_node* n)
+    {
+        for (; n != nullptr; n = n->parent) Augment::update(owner(n));
+    }
+
+    /// Makes `replacement` take the place of `old` under `old`'s parent.
+    void replace_child(rb_node* old, rb_node* replacement);
+
+    void rotate_left(rb_node* x);
+    void rotate_right(rb_node* x);
+
+    void insert_fixup(rb_node* z);
+    void remove_fixup(rb_node* x, rb_node* parent);
+
+    rb_node* m_root = nullptr;
+    size_t m_size = 0;
+};
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::replace_child(rb_node* old, rb_node* replacement)
+{
+    rb_node* parent = old->parent;
+    if (parent == nullptr) {
+        m_root = replacement;
+    } else if (parent->left == old) {
+        parent->left = replacement;
+    } else {
+        parent->right = replacement;
+    }
+    if (replacement != nullptr) {
+        replacement->parent = parent;
+    }
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::rotate_left(rb_node* x)
+{
+    rb_node* y = x->right;
+    x->right = y->left;
+    if (y->left != nullptr) {
+        y->left->parent = x;
+    }
+    replace_child(x, y);
+    y->left = x;
+    x->parent = y;
+    Augment::update(owner(x));
+    Augment::update(owner(y));
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::rotate_right(rb_node* x)
+{
+    rb_node* y = x->left;
+    x->left = y->right;
+    if (y->right != nullptr) {
+        y->right->parent = x;
+    }
+    replace_child(x, y);
+    y->right = x;
+    x->parent = y;
+    Augment::update(owner(x));
+    Augment::update(owner(y));
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::insert(T* obj)
+{
+    rb_node* z = node(obj);
+    rb_node* parent = nullptr;
+    rb_node** link = &m_root;
+    while (*link != nullptr) {
+        parent = *link;
+        link = Compare::less(*obj, *owner(parent)) ? &parent->left : &parent->right;
+    }
+
+    z->parent = parent;
+    z->left = nullptr;
+    z->right = nullptr;
+    z->red = true;
+    *link = z;
+    m_size++;
+
+    propagate(z);
+    insert_fixup(z);
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::insert_fixup(rb_node* z)
+{
+    while (is_red(z->parent)) {
+        rb_node* p = z->parent;
+        // A red node is never the root, so the grandparent exists.
+        rb_node* g = p->parent;
+        if (p == g->left) {
+            rb_node* uncle = g->right;
+            if (is_red(uncle)) {
+                p->red = false;
+                uncle->red = false;
+                g->red = true;
+                z = g;
+                continue;
+            }
+            if (z == p->right) {
+                rotate_left(p);
+                z = p;
+                p = z->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rotate_right(g);
+        } else {
+            rb_node* uncle = g->left;
+            if (is_red(uncle)) {
+                p->red = false;
+                uncle->red = false;
+                g->red = true;
+                z = g;
+                continue;
+            }
+            if (z == p->left) {
+                rotate_right(p);
+                z = p;
+                p = z->parent;
+            }
+            p->red = false;
+            g->red = true;
+            rotate_left(g);
+        }
+    }
+    m_root->red = false;
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::remove(T* obj)
+{
+    rb_node* z = node(obj);
+    rb_node* x;
+    rb_node* x_parent;
+    bool removed_red = z->red;
+
+    if (z->left == nullptr) {
+        x = z->right;
+        x_parent = z->parent;
+        replace_child(z, z->right);
+    } else if (z->right == nullptr) {
+        x = z->left;
+        x_parent = z->parent;
+        replace_child(z, z->left);
+    } else {
+        // Two children: splice out the successor y and put it in z's place.
+        rb_node* y = minimum(z->right);
+        removed_red = y->red;
+        x = y->right;
+        if (y->parent == z) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            replace_child(y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        replace_child(z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->red = z->red;
+    }
+
+    z->parent = nullptr;
+    z->left = nullptr;
+    z->right = nullptr;
+    m_size--;
+
+    // Everything whose subtree changed lies on the path from x_parent to the root.
+    propagate(x_parent);
+    if (!removed_red) {
+        remove_fixup(x, x_parent);
+    }
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+void
+rb_tree<T, Member, Compare, Augment>::remove_fixup(rb_node* x, rb_node* parent)
+{
+    while (x != m_root && !is_red(x)) {
+        // x carries an extra black, so its sibling w can't be null. x may be null itself, in which
+        // case it is the left child exactly when parent->left is null.
+        if (x == parent->left) {
+            rb_node* w = parent->right;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rotate_left(parent);
+                w = parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!is_red(w->right)) {
+                    w->left->red = false;
+                    w->red = true;
+                    rotate_right(w);
+                    w = parent->right;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->right->red = false;
+                rotate_left(parent);
+                x = m_root;
+                break;
+            }
+        } else {
+            rb_node* w = parent->left;
+            if (w->red) {
+                w->red = false;
+                parent->red = true;
+                rotate_right(parent);
+                w = parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+            } else {
+                if (!is_red(w->left)) {
+                    w->right->red = false;
+                    w->red = true;
+                    rotate_left(w);
+                    w = parent->left;
+                }
+                w->red = parent->red;
+                parent->red = false;
+                w->left->red = false;
+                rotate_right(parent);
+                x = m_root;
+                break;
+            }
+        }
+    }
+    if (x != nullptr) {
+        x->red = false;
+    }
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+template<typename Key>
+T*
+rb_tree<T, Member, Compare, Augment>::find(const Key& key) const
+{
+    rb_node* n = m_root;
+    while (n != nullptr) {
+        int cmp = Compare::compare(key, *owner(n));
+        if (cmp == 0) {
+            return owner(n);
+        }
+        n = (cmp < 0) ? n->left : n->right;
+    }
+    return nullptr;
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+template<typename Key>
+T*
+rb_tree<T, Member, Compare, Augment>::lower_bound(const Key& key) const
+{
+    rb_node* n = m_root;
+    rb_node* best = nullptr;
+    while (n != nullptr) {
+        if (Compare::compare(key, *owner(n)) <= 0) {
+            best = n;
+            n = n->left;
+        } else {
+            n = n->right;
+        }
+    }
+    return owner(best);
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+template<typename Key>
+T*
+rb_tree<T, Member, Compare, Augment>::floor(const Key& key) const
+{
+    rb_node* n = m_root;
+    rb_node* best = nullptr;
+    while (n != nullptr) {
+        if (Compare::compare(key, *owner(n)) >= 0) {
+            best = n;
+            n = n->right;
+        } else {
+            n = n->left;
+        }
+    }
+    return owner(best);
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+T*
+rb_tree<T, Member, Compare, Augment>::next(T* obj)
+{
+    rb_node* n = node(obj);
+    if (n->right != nullptr) {
+        return owner(minimum(n->right));
+    }
+    while (n->parent != nullptr && n == n->parent->right) n = n->parent;
+    return owner(n->parent);
+}
+
+template<typename T, rb_node T::*Member, typename Compare, typename Augment>
+T*
+rb_tree<T, Member, Compare, Augment>::prev(T* obj)
+{
+    rb_node* n = node(obj);
+    if (n->left != nullptr) {
+        return owner(maximum(n->left));
+    }
+    while (n->parent != nullptr && n == n->parent->left) n = n->parent;
+    return owner(n->parent);
+}
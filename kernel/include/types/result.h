@@ -1,73 +1,167 @@
 #pragma once
 
+#include <new>
+#include <type_traits>
 #include <types/error.h>
+#include <utility>
+
+/// Either a value of type `T` (Some) or an `error` (Err).
+///
+/// The value lives inline and is only ever moved, never copied. When `T` is trivially copyable and
+/// destructible so is `result<T>`, which lets small results (e.g. `result<u64>`) be returned in
+/// registers instead of through memory.
 template<typename T>
-struct result
+class [[nodiscard]] result
 {
+public:
+    using value_type = T;
+
     /// Creates a Result<T, E>::Some(value) instance.
-    result make_some(T value);
+    static result make_some(T&& value) { return result(std::in_place, std::move(value)); }
+    static result make_some(const T& value) { return result(std::in_place, value); }
+
+    /// Creates a Result<T, E>::Some(_) instance, constructing the value in place from `args`.
+    template<typename... Args>
+    static result emplace_some(Args&&... args)
+    {
+        return result(std::in_place, std::forward<Args>(args)...);
+    }
 
     /// Creates a Result<T, E>::Err(err) instance.
-    result make_err(error err);
+    static result make_err(error err) { return result(err); }
+
+    /// Implicitly creates a Result<T, E>::Err(err), so functions can `return err.push(...)`.
+    result(error err)
+      : m_err(err)
+      , m_some(false)
+    {
+    }
+
+    result(ErrorCode code)
+      : result(error(code))
+    {
+    }
+
+    result(const result& other)
+        requires std::is_trivially_copy_constructible_v<T>
+    = default;
+    result(const result& other)
+        requires(!std::is_trivially_copy_constructible_v<T>)
+    = delete;
+
+    result(result&& other)
+        requires std::is_trivially_move_constructible_v<T>
+    = default;
+    result(result&& other) noexcept
+        requires(!std::is_trivially_move_constructible_v<T>)
+      : m_some(other.m_some)
+    {
+        if (m_some) {
+            new (&m_value) T(std::move(other.m_value));
+        } else {
+            new (&m_err) error(other.m_err);
+        }
+    }
+
+    result& operator=(const result&) = delete;
+
+    result& operator=(result&& other)
+        requires std::is_trivially_copyable_v<T>
+    = default;
+    result& operator=(result&& other) noexcept
+        requires(!std::is_trivially_copyable_v<T>)
+    {
+        if (this != &other) {
+            this->~result();
+            new (this) result(std::move(other));
+        }
+        return *this;
+    }
+
+    ~result()
+        requires std::is_trivially_destructible_v<T>
+    = default;
+    ~result()
+        requires(!std::is_trivially_destructible_v<T>)
+    {
+        if (m_some) {
+            m_value.~T();
+        }
+    }
 
     /// Returns true if the Result<T, E> is Some(_).
-    bool is_some();
+    bool is_some() const { return m_some; }
 
     /// Returns true if the Result<T, E> is Err(_).
-    bool is_err();
+    bool is_err() const { return !m_some; }
 
     /// Gets the value of a Result::Some(_) if it's Some(_), undefined behaviour if it is Err(_).
-    T& some();
+    T& some() & { return m_value; }
+    const T& some() const& { return m_value; }
+    T&& some() && { return std::move(m_value); }
 
     /// Gets the value of a Result::Err(_) if it's Err(_), undefined behaviour if it is Some(_).
-    error& err();
+    error err() const { return m_err; }
 
-    bool m_some;
-    union
-    {
-        T m_value;
-        error m_err;
-    } m_u;
-};
+    /// Returns the value, or `fallback` if this is Err(_).
+    T value_or(T fallback) && { return m_some ? std::move(m_value) : std::move(fallback); }
 
-template<typename T>
-result<T>
-result<T>::make_some(T value)
-{
-    return { .m_some = true, .m_u = { .m_value = value } };
-}
+    /// Returns Some(f(value)) if this is Some(value), otherwise propagates the error.
+    template<typename F>
+    auto map(F&& f) && -> result<std::invoke_result_t<F, T&&>>
+    {
+        using U = std::invoke_result_t<F, T&&>;
+        if (!m_some) {
+            return result<U>(m_err);
+        }
+        return result<U>::emplace_some(std::forward<F>(f)(std::move(m_value)));
+    }
 
-template<typename T>
-result<T>
-result<T>::make_err(error err)
-{
-    return { .m_some = false, .m_u = { .m_err = err } };
-}
+    /// Returns f(value), which must itself return a result, if this is Some(value), otherwise
+    /// propagates the error.
+    template<typename F>
+    auto and_then(F&& f) && -> std::invoke_result_t<F, T&&>
+    {
+        using R = std::invoke_result_t<F, T&&>;
+        if (!m_some) {
+            return R(m_err);
+        }
+        return std::forward<F>(f)(std::move(m_value));
+    }
 
-template<typename T>
-bool
-result<T>::is_some()
-{
-    return m_some;
-}
+    /// Returns Err(f(error)) if this is Err(error), otherwise passes the value through.
+    template<typename F>
+    result map_err(F&& f) &&
+    {
+        if (m_some) {
+            return std::move(*this);
+        }
+        return result(std::forward<F>(f)(m_err));
+    }
 
-template<typename T>
-bool
-result<T>::is_err()
-{
-    return !m_some;
-}
+private:
+    template<typename... Args>
+    explicit result(std::in_place_t, Args&&... args)
+      : m_value(std::forward<Args>(args)...)
+      , m_some(true)
+    {
+    }
 
-template<typename T>
-T&
-result<T>::some()
-{
-    return m_u.m_value;
-}
+    union
+    {
+        T m_value;
+        error m_err;
+    };
+    bool m_some;
+};
 
-template<typename T>
-error&
-result<T>::err()
-{
-    return m_u.m_err;
-}
\ No newline at end of file
+/// Evaluates `expr`, a `result<T>`, and returns its error from the enclosing function if it is
+/// Err(_). Otherwise the whole expression evaluates to the value, moved out of the result.
+#define TRY(expr)                                                                                  \
+    ({                                                                                             \
+        auto _try_result = (expr);                                                                 \
+        if (_try_result.is_err()) {                                                                \
+            return _try_result.err();                                                              \
+        }                                                                                          \
+        std::move(_try_result).some();                                                             \
+    })
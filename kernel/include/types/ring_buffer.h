@@ -0,0 +1,264 @@
+/// Bounded lock-free ring buffers for handing data between harts or between interrupt and thread
+/// context.
+///
+/// `spsc_ring` supports one producer and one consumer. `mpsc_ring` supports any number of
+/// producers and one consumer. Both have a power-of-two capacity and never block: a full ring
+/// refuses pushes and an empty ring refuses pops. Elements are copied in and out with `mem::copy`,
+/// so they must be trivially copyable.
+#pragma once
+
+#include <memory.h>
+#include <type_traits>
+#include <types/atomic.h>
+#include <types/number.h>
+
+namespace ring_details {
+
+template<typename T, size_t N>
+concept ring_element =
+  std::is_trivially_copyable_v<T> && N >= 2 && (N & (N - 1)) == 0;
+
+} // namespace ring_details
+
+/// Single-producer single-consumer ring buffer.
+///
+/// The producer only writes `m_tail` and the consumer only writes `m_head`, and the two live on
+/// different cache lines. Each side also keeps a private copy of the other side's index and only
+/// re-reads the shared one when the copy says the ring is full (or empty). This way the cache line
+/// only bounces between harts once per batch, not once per element.
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+class spsc_ring
+{
+public:
+    constexpr spsc_ring() = default;
+
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    /// Producer: appends `value`. Returns false if the ring is full.
+    bool try_push(const T& value) { return push_batch(&value, 1) == 1; }
+
+    /// Producer: appends up to `count` elements from `src` and returns how many fit.
+    size_t push_batch(const T* src, size_t count);
+
+    /// Consumer: removes the oldest element into `out`. Returns false if the ring is empty.
+    bool try_pop(T* out) { return pop_batch(out, 1) == 1; }
+
+    /// Consumer: removes up to `max` of the oldest elements into `dst` and returns how many there
+    /// were.
+    size_t pop_batch(T* dst, size_t max);
+
+    /// Returns the number of elements in the ring. Only exact when called by the producer or the
+    /// consumer while the other side is idle.
+    size_t size() const
+    {
+        return m_tail.load(memory_order::ACQUIRE) - m_head.load(memory_order::ACQUIRE);
+    }
+
+    /// Checks whether the ring is empty, subject to the same caveat as `size`.
+    bool empty() const { return size() == 0; }
+
+    /// Returns the number of elements the ring can hold.
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static constexpr size_t s_MASK = N - 1;
+
+    /// Copies `count` elements between `ring` index `index` and `flat`, splitting the copy in two
+    /// where it wraps around the end of the ring.
+    void copy_in(size_t index, const T* flat, size_t count);
+    void copy_out(size_t index, T* flat, size_t count) const;
+
+    // Indices run freely and are only masked when accessing a slot, so `m_tail - m_head` is the
+    // number of elements even after the counters wrap.
+
+    /// Consumer line: next index to pop, and the producer's tail as of the last refresh.
+    alignas(CACHE_LINE_SIZE) atomic<size_t> m_head = 0;
+    size_t m_cached_tail = 0;
+    /// Producer line: next index to push, and the consumer's head as of the last refresh.
+    alignas(CACHE_LINE_SIZE) atomic<size_t> m_tail = 0;
+    size_t m_cached_head = 0;
+
+    alignas(CACHE_LINE_SIZE) T m_slots[N];
+};
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+void
+spsc_ring<T, N>::copy_in(size_t index, const T* flat, size_t count)
+{
+    size_t first = index & s_MASK;
+    size_t until_end = num::min(count, N - first);
+    mem::copy(flat, &m_slots[first], until_end * sizeof(T));
+    mem::copy(flat + until_end, &m_slots[0], (count - until_end) * sizeof(T));
+}
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+void
+spsc_ring<T, N>::copy_out(size_t index, T* flat, size_t count) const
+{
+    size_t first = index & s_MASK;
+    size_t until_end = num::min(count, N - first);
+    mem::copy(&m_slots[first], flat, until_end * sizeof(T));
+    mem::copy(&m_slots[0], flat + until_end, (count - until_end) * sizeof(T));
+}
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+size_t
+spsc_ring<T, N>::push_batch(const T* src, size_t count)
+{
+    size_t tail = m_tail.load(memory_order::RELAXED);
+    size_t space = N - (tail - m_cached_head);
+    if (space < count) {
+        // Acquire pairs with the consumer's release of `m_head`, so its reads of the slots we are
+        // about to reuse have finished.
+        m_cached_head = m_head.load(memory_order::ACQUIRE);
+        space = N - (tail - m_cached_head);
+    }
+
+    count = num::min(count, space);
+    if (count == 0) {
+        return 0;
+    }
+    copy_in(tail, src, count);
+    m_tail.store(tail + count, memory_order::RELEASE);
+    return count;
+}
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+size_t
+spsc_ring<T, N>::pop_batch(T* dst, size_t max)
+{
+    size_t head = m_head.load(memory_order::RELAXED);
+    size_t available = m_cached_tail - head;
+    if (available < max) {
+        // Acquire pairs with the producer's release of `m_tail`, making the new slots visible.
+        m_cached_tail = m_tail.load(memory_order::ACQUIRE);
+        available = m_cached_tail - head;
+    }
+
+    size_t count = num::min(max, available);
+    if (count == 0) {
+        return 0;
+    }
+    copy_out(head, dst, count);
+    m_head.store(head + count, memory_order::RELEASE);
+    return count;
+}
+
+/// Multi-producer single-consumer ring buffer.
+///
+/// Every slot carries a sequence number that says whose turn it is. Slot `i` is free for the
+/// producer that claims ticket `t` (with `t % N == i`) once its sequence equals `t`, and holds data
+/// for the consumer once it equals `t + 1`. The consumer hands the slot to the next round by
+/// setting it to `t + N`. Producers claim tickets with a CAS on `m_tail`, so a producer never
+/// waits on another one, and the consumer only ever touches the slots themselves.
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+class mpsc_ring
+{
+public:
+    mpsc_ring()
+    {
+        for (size_t i = 0; i < N; i++) m_slots[i].sequence.store(i, memory_order::RELAXED);
+    }
+
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+    /// Producer: appends `value`. Returns false if the ring is full.
+    bool try_push(const T& value) { return push_batch(&value, 1); }
+
+    /// Producer: appends all `count` elements from `src` as one contiguous run, or none of them if
+    /// they don't fit. Returns whether they were pushed.
+    bool push_batch(const T* src, size_t count);
+
+    /// Consumer: removes the oldest element into `out`. Returns false if the ring is empty.
+    bool try_pop(T* out) { return pop_batch(out, 1) == 1; }
+
+    /// Consumer: removes up to `max` of the oldest elements into `dst` and returns how many there
+    /// were. Stops early at a slot whose producer has claimed it but not finished writing.
+    size_t pop_batch(T* dst, size_t max);
+
+    /// Returns the number of elements the ring can hold.
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static constexpr size_t s_MASK = N - 1;
+
+    struct slot
+    {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    /// Next ticket for producers, shared by all of them.
+    alignas(CACHE_LINE_SIZE) atomic<size_t> m_tail = 0;
+    /// Next ticket for the consumer, which is the only one to touch it.
+    alignas(CACHE_LINE_SIZE) size_t m_head = 0;
+
+    alignas(CACHE_LINE_SIZE) slot m_slots[N];
+};
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+bool
+mpsc_ring<T, N>::push_batch(const T* src, size_t count)
+{
+    if (count == 0 || count > N) {
+        return count == 0;
+    }
+
+    size_t ticket = m_tail.load(memory_order::RELAXED);
+    while (true) {
+        // The consumer frees slots in order, so if the last slot of the run is free for this round
+        // then so are all the ones before it.
+        size_t last = ticket + count - 1;
+        size_t sequence = m_slots[last & s_MASK].sequence.load(memory_order::ACQUIRE);
+        ssize_t diff = static_cast<ssize_t>(sequence - last);
+        if (diff == 0) {
+            if (m_tail.compare_exchange_weak(
+                  ticket, ticket + count, memory_order::RELAXED, memory_order::RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The slot still holds last round's data: full.
+            return false;
+        } else {
+            // Another producer claimed the run first.
+            ticket = m_tail.load(memory_order::RELAXED);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        slot& s = m_slots[(ticket + i) & s_MASK];
+        mem::copy(&src[i], &s.value, sizeof(T));
+        // Release publishes the value to the consumer's acquire load of the sequence.
+        s.sequence.store(ticket + i + 1, memory_order::RELEASE);
+    }
+    return true;
+}
+
+template<typename T, size_t N>
+    requires ring_details::ring_element<T, N>
+size_t
+mpsc_ring<T, N>::pop_batch(T* dst, size_t max)
+{
+    size_t count = 0;
+    for (; count < max; count++) {
+        size_t ticket = m_head + count;
+        slot& s = m_slots[ticket & s_MASK];
+        if (s.sequence.load(memory_order::ACQUIRE) != ticket + 1) {
+            break;
+        }
+        mem::copy(&s.value, &dst[count], sizeof(T));
+        // Release orders our read of the value before a producer's reuse of the slot.
+        s.sequence.store(ticket + N, memory_order::RELEASE);
+    }
+    m_head += count;
+    return count;
+}
@@ -0,0 +1,299 @@
+/// Vector with inline storage for its first `N` elements. Only once it outgrows them does it fall
+/// back to memory from the pmm, so small collections don't cost a whole page each.
+#pragma once
+
+#include <fmt/assert.h>
+#include <limine/platform_info.h>
+#include <memory.h>
+#include <new>
+#include <pmm.h>
+#include <riscv/paging.h>
+#include <type_traits>
+#include <types/error.h>
+#include <types/number.h>
+#include <utility>
+
+template<typename T, size_t N>
+class small_vector
+{
+public:
+    /// Creates an empty vector using the inline storage.
+    small_vector();
+
+    /// Move constructor. Steals the heap buffer of `other`, or relocates its inline elements.
+    small_vector(small_vector&& other) noexcept;
+
+    small_vector(const small_vector&) = delete;
+
+    /// Destroys the elements and returns any heap buffer to the pmm.
+    ~small_vector();
+
+    /// Move assignment.
+    small_vector& operator=(small_vector&& other) noexcept;
+
+    small_vector& operator=(const small_vector&) = delete;
+
+    /// Grows the vector so that it can hold at least `minimum_capacity` elements.
+    error reserve(size_t minimum_capacity);
+
+    /// Pushes a value onto the vector, returning the address of the pushed-back value.
+    T* push_back(const T& value);
+
+    /// Pushes a value onto the vector, returning the address of the pushed-back value.
+    T* push_back(T&& value);
+
+    /// Constructs a value in place at the end of the vector. Returns the address of the new value.
+    template<typename... Args>
+    T* emplace_back(Args&&... args);
+
+    /// Destroys the last element.
+    void pop_back();
+
+    /// Destroys all elements, keeping the current buffer.
+    void clear();
+
+    /// Accesses specified element.
+    T& operator[](size_t index) { return m_buffer[index]; }
+    const T& operator[](size_t index) const { return m_buffer[index]; }
+
+    T* begin() { return m_buffer; }
+    T* end() { return m_buffer + m_size; }
+    const T* begin() const { return m_buffer; }
+    const T* end() const { return m_buffer + m_size; }
+
+    T* data() { return m_buffer; }
+    const T* data() const { return m_buffer; }
+
+    /// Returns the number of elements.
+    size_t size() const { return m_size; }
+
+    /// Returns the number of elements that fit without growing.
+    size_t capacity() const { return m_capacity; }
+
+    /// Checks whether the container is empty.
+    bool empty() const { return m_size == 0; }
+
+    /// Returns true while the elements still live in the inline storage.
+    bool is_inline() const { return m_buffer == inline_buffer(); }
+
+private:
+    /// Moves `count` elements from `src` into uninitialized memory at `dst`, ending the lifetime of
+    /// the sources. Trivially copyable types are moved with a single bulk copy.
+    static void relocate(T* src, T* dst, size_t count);
+
+    /// Allocates a buffer from the pmm for at least `minimum_capacity` elements.
+    static error allocate(size_t minimum_capacity, T** buffer, size_t* capacity);
+
+    /// Relocates the elements into `buffer`, which holds `capacity` of them, and frees the old
+    /// buffer if it was on the heap.
+    void move_to(T* buffer, size_t capacity);
+
+    /// `emplace_back` on a full vector. The new element is built in the new buffer before the old
+    /// elements leave theirs, so `args` may refer to them.
+    template<typename... Args>
+    T* grow_and_emplace_back(Args&&... args);
+
+    /// Destroys the elements and frees the heap buffer, leaving the vector inline and empty.
+    void release();
+
+    /// Takes over the contents of `other`, which is left inline and empty.
+    void take(small_vector& other);
+
+    T* inline_buffer() { return reinterpret_cast<T*>(m_inline); }
+    const T* inline_buffer() const { return reinterpret_cast<const T*>(m_inline); }
+
+    static_assert(N > 0, "small_vector needs at least one inline element.");
+    static_assert(sizeof(T) <= riscv::paging::PAGE_SIZE);
+
+    T* m_buffer;
+    size_t m_size;
+    size_t m_capacity;
+    alignas(T) u8 m_inline[N * sizeof(T)];
+};
+
+template<typename T, size_t N>
+small_vector<T, N>::small_vector()
+  : m_buffer(inline_buffer())
+  , m_size(0)
+  , m_capacity(N)
+{
+}
+
+template<typename T, size_t N>
+small_vector<T, N>::small_vector(small_vector&& other) noexcept
+  : small_vector()
+{
+    take(other);
+}
+
+template<typename T, size_t N>
+small_vector<T, N>::~small_vector()
+{
+    release();
+}
+
+template<typename T, size_t N>
+small_vector<T, N>&
+small_vector<T, N>::operator=(small_vector&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        take(other);
+    }
+    return *this;
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::relocate(T* src, T* dst, size_t count)
+{
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        mem::copy(src, dst, count * sizeof(T));
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            new (&dst[i]) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::release()
+{
+    clear();
+    if (!is_inline()) {
+        error err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        assert_err(err);
+    }
+    m_buffer = inline_buffer();
+    m_capacity = N;
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::take(small_vector& other)
+{
+    if (other.is_inline()) {
+        relocate(other.m_buffer, m_buffer, other.m_size);
+    } else {
+        m_buffer = other.m_buffer;
+        m_capacity = other.m_capacity;
+    }
+    m_size = other.m_size;
+
+    other.m_buffer = other.inline_buffer();
+    other.m_size = 0;
+    other.m_capacity = N;
+}
+
+template<typename T, size_t N>
+error
+small_vector<T, N>::allocate(size_t minimum_capacity, T** buffer, size_t* capacity)
+{
+    // Once we leave the inline storage we might as well use the whole of each page.
+    size_t size = align_up(minimum_capacity * sizeof(T), riscv::paging::PAGE_SIZE);
+    paddr_t pa;
+    error err = pmm::alloc(size, &pa);
+    if (err.is_err()) {
+        return err;
+    }
+    *buffer = static_cast<T*>(limine::hhdm_phys_to_virt(pa));
+    *capacity = size / sizeof(T);
+    return ErrorCode::SUCCESS;
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::move_to(T* buffer, size_t capacity)
+{
+    relocate(m_buffer, buffer, m_size);
+    if (!is_inline()) {
+        error err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        assert_err(err);
+    }
+    m_buffer = buffer;
+    m_capacity = capacity;
+}
+
+template<typename T, size_t N>
+error
+small_vector<T, N>::reserve(size_t minimum_capacity)
+{
+    if (minimum_capacity <= m_capacity) {
+        return ErrorCode::SUCCESS;
+    }
+
+    T* buffer;
+    size_t capacity;
+    error err = allocate(minimum_capacity, &buffer, &capacity);
+    if (err.is_err()) {
+        return err;
+    }
+    move_to(buffer, capacity);
+    return ErrorCode::SUCCESS;
+}
+
+template<typename T, size_t N>
+template<typename... Args>
+T*
+small_vector<T, N>::grow_and_emplace_back(Args&&... args)
+{
+    T* buffer;
+    size_t capacity;
+    error err = allocate(m_capacity + m_capacity / 2 + 1, &buffer, &capacity);
+    assert(err.is_ok(), err.str());
+
+    T* obj = new (&buffer[m_size]) T{ std::forward<Args>(args)... };
+    move_to(buffer, capacity);
+    m_size++;
+    return obj;
+}
+
+template<typename T, size_t N>
+T*
+small_vector<T, N>::push_back(const T& value)
+{
+    return emplace_back(value);
+}
+
+template<typename T, size_t N>
+T*
+small_vector<T, N>::push_back(T&& value)
+{
+    return emplace_back(std::move(value));
+}
+
+template<typename T, size_t N>
+template<typename... Args>
+T*
+small_vector<T, N>::emplace_back(Args&&... args)
+{
+    if (m_size == m_capacity) [[unlikely]] {
+        return grow_and_emplace_back(std::forward<Args>(args)...);
+    }
+    T* obj = new (&m_buffer[m_size]) T{ std::forward<Args>(args)... };
+    m_size++;
+    return obj;
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::pop_back()
+{
+    assert(m_size > 0);
+    m_size--;
+    m_buffer[m_size].~T();
+}
+
+template<typename T, size_t N>
+void
+small_vector<T, N>::clear()
+{
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (size_t i = 0; i < m_size; i++) {
+            m_buffer[i].~T();
+        }
+    }
+    m_size = 0;
+}
@@ -6,7 +6,7 @@
 #include <memory.h>
 #include <new>
 #include <pmm.h>
-#include <riscv/sv39.h>
+#include <riscv/paging.h>
 #include <types/error.h>
 #include <types/number.h>
 
@@ -70,8 +70,36 @@ stack<T>::stack(stack&& other) noexcept
 template<typename T>
 stack<T>::~stack()
 {
-    error err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
-    assert_err(err);
+    if (m_buffer != nullptr) {
+        error err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        assert_err(err);
+    }
+}
+
+template<typename T>
+error
+stack<T>::grow_to_min_cap(size_t minimum_capacity)
+{
+    if (minimum_capacity <= m_capacity) {
+        return ErrorCode::SUCCESS;
+    }
+
+    size_t new_size = align_up(minimum_capacity * sizeof(T), riscv::paging::PAGE_SIZE);
+    paddr_t new_pa;
+    error err = pmm::alloc(new_size, &new_pa);
+    if (err.is_err()) {
+        return err;
+    }
+    void* new_buffer = limine::hhdm_phys_to_virt(new_pa);
+    if (m_buffer != nullptr) {
+        mem::copy(m_buffer, new_buffer, m_size * sizeof(T));
+        err = pmm::free(limine::hhdm_virt_to_phys(m_buffer));
+        assert_err(err);
+    }
+
+    m_capacity = new_size / sizeof(T);
+    m_buffer = (T*)new_buffer;
+    return ErrorCode::SUCCESS;
 }
 
 template<typename T>
@@ -79,16 +107,18 @@ void
 stack<T>::grow()
 {
     if (m_size == m_capacity) {
-        size_t current_size = align_up(m_capacity * sizeof(T), riscv::sv39::PAGE_SIZE);
-        size_t new_size = align_up(1 + (current_size * 3) / 2, riscv::sv39::PAGE_SIZE);
+        size_t current_size = align_up(m_capacity * sizeof(T), riscv::paging::PAGE_SIZE);
+        size_t new_size = align_up(1 + (current_size * 3) / 2, riscv::paging::PAGE_SIZE);
         size_t new_capacity = new_size / sizeof(T);
         void* old_buffer = m_buffer;
         paddr_t new_pa = pmm::alloc_noerr(new_size);
         assert(new_pa != 0);
         void* new_buffer = limine::hhdm_phys_to_virt(new_pa);
-        mem::copy(old_buffer, new_buffer, m_capacity * sizeof(T));
-        error err = pmm::free(limine::hhdm_virt_to_phys(old_buffer));
-        assert_err(err);
+        if (old_buffer != nullptr) {
+            mem::copy(old_buffer, new_buffer, m_capacity * sizeof(T));
+            error err = pmm::free(limine::hhdm_virt_to_phys(old_buffer));
+            assert_err(err);
+        }
 
         m_capacity = new_capacity;
         m_buffer = (T*)new_buffer;
@@ -34,13 +34,17 @@ public:
     /// Constructs a str_view from a null-terminated string.
     static constexpr str_view from_null_term(const char* str)
     {
-        //        size_t len = 0;
-        //        for (const char* curr = str; *curr != '\0'; curr++, len++);
-        return { str, mem::strlen(str) };
+        if consteval {
+            size_t len = 0;
+            for (const char* curr = str; *curr != '\0'; curr++, len++);
+            return { str, len };
+        } else {
+            return { str, mem::strlen(str) };
+        }
     }
 
     /// Constructs a str_view from a byte_view.
-    static constexpr str_view from_byte_view(byte_view bv)
+    static str_view from_byte_view(byte_view bv)
     {
         return { (const char*)bv.data(), bv.length() };
     }
@@ -104,12 +108,19 @@ str_view::substr(size_t start, size_t len) const
 constexpr size_t
 str_view::find(char c, size_t start) const
 {
-    for (size_t i = start; i < m_size; i++) {
-        if (m_data[i] == c) {
-            return i;
+    if consteval {
+        for (size_t i = start; i < m_size; i++) {
+            if (m_data[i] == c) {
+                return i;
+            }
         }
+        return s_sentinel;
+    } else {
+        if (start >= m_size)
+            return s_sentinel;
+        size_t i = mem::find_byte(m_data + start, static_cast<u8>(c), m_size - start);
+        return (i == m_size - start) ? s_sentinel : start + i;
     }
-    return s_sentinel;
 }
 
 constexpr ssize_t
@@ -2,15 +2,24 @@
 #include <fmt/assert.h>
 #include <limine/platform_info.h>
 #include <pmm.h>
-#include <riscv/sv39.h>
+#include <riscv/paging.h>
 #include <types/number.h>
 
 bump_alloc::~bump_alloc()
 {
-    for (struct region* curr = m_region_list; curr != nullptr; curr = curr->next) {
+    release();
+}
+
+void
+bump_alloc::release()
+{
+    for (struct region* curr = m_region_list; curr != nullptr;) {
+        // The header lives in the region itself, read it before the region goes back to the pmm.
+        struct region* next = curr->next;
         paddr_t pa = limine::hhdm_virt_to_phys(curr);
         error err = pmm::free(pa);
         assert_err(err);
+        curr = next;
     }
     m_region_list = nullptr;
     m_current_region = nullptr;
@@ -21,46 +30,41 @@ bump_alloc::grow()
 {
     error err = error();
     paddr_t pa;
-    if ((err = pmm::alloc(riscv::sv39::PAGE_SIZE, &pa)).is_err()) {
+    if ((err = pmm::alloc(riscv::paging::PAGE_SIZE, &pa)).is_err()) {
         return err;
     }
     m_region_list = (struct region*)limine::hhdm_phys_to_virt(pa);
-    m_region_list->end = (u8*)m_region_list + riscv::sv39::PAGE_SIZE;
+    m_region_list->end = (u8*)m_region_list + riscv::paging::PAGE_SIZE;
     m_region_list->curr = (u8*)m_region_list + sizeof(struct region);
     m_region_list->next = nullptr;
     m_current_region = m_region_list;
     return err;
 }
 
-void*
-bump_alloc::alloc(size_t size)
+error
+bump_alloc::add_region(size_t size, size_t alignment)
 {
-    if (m_current_region == nullptr || size == 0) {
-        return nullptr;
-    }
-
-    if (m_current_region == nullptr || m_region_list == nullptr) {
-        error err = grow();
-        assert_err(err);
-    }
-
-    if (m_current_region->end < m_current_region->curr + size) {
-        size_t difference = m_current_region->curr + size - m_current_region->end;
-        size_t region_size = align_up(difference, riscv::sv39::PAGE_SIZE) + riscv::sv39::PAGE_SIZE;
-        paddr_t pa;
-        error err = pmm::alloc(region_size, &pa);
-        assert_err(err);
-        struct region* new_region = (struct region*)limine::hhdm_phys_to_virt(pa);
-        m_current_region->next = new_region;
-        new_region->end = (u8*)new_region + region_size;
-        new_region->curr = (u8*)new_region + sizeof(struct region);
-        new_region->next = nullptr;
-        m_current_region = new_region;
+    // Sized for the request alone, the space left in the current region doesn't count.
+    size_t region_size =
+      align_up(sizeof(struct region) + alignment - 1 + size, riscv::paging::PAGE_SIZE);
+    paddr_t pa;
+    error err = pmm::alloc(region_size, &pa);
+    if (err.is_err()) {
+        return err;
     }
+    struct region* new_region = (struct region*)limine::hhdm_phys_to_virt(pa);
+    new_region->end = (u8*)new_region + region_size;
+    new_region->curr = (u8*)new_region + sizeof(struct region);
+    new_region->next = nullptr;
+    m_current_region->next = new_region;
+    m_current_region = new_region;
+    return err;
+}
 
-    void* allocation = (void*)m_current_region->curr;
-    m_current_region->curr += size;
-    return allocation;
+void*
+bump_alloc::alloc(size_t size)
+{
+    return alloc_aligned(size, 1);
 }
 
 void*
@@ -71,23 +75,15 @@ bump_alloc::alloc_aligned(size_t size, size_t alignment)
     }
 
     if (m_current_region == nullptr || m_region_list == nullptr) {
-        error err = grow();
-        assert_err(err);
+        if (grow().is_err()) {
+            return nullptr;
+        }
     }
 
-    u8* aligned_curr = align_up(m_current_region->curr, alignment);
-    if (m_current_region->end < aligned_curr + size) {
-        size_t difference = aligned_curr + size - m_current_region->end;
-        size_t region_size = align_up(difference, riscv::sv39::PAGE_SIZE) + riscv::sv39::PAGE_SIZE;
-        paddr_t pa;
-        error err = pmm::alloc(region_size, &pa);
-        assert_err(err);
-        struct region* new_region = (struct region*)limine::hhdm_phys_to_virt(pa);
-        m_current_region->next = new_region;
-        new_region->end = (u8*)new_region + region_size;
-        new_region->curr = (u8*)new_region + sizeof(struct region);
-        new_region->next = nullptr;
-        m_current_region = new_region;
+    if (m_current_region->end < align_up(m_current_region->curr, alignment) + size) {
+        if (add_region(size, alignment).is_err()) {
+            return nullptr;
+        }
     }
     m_current_region->curr = align_up(m_current_region->curr, alignment);
     void* allocation = (void*)m_current_region->curr;
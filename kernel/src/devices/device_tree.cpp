@@ -2,34 +2,51 @@
 #include <cinttypes>
 #include <cstring>
 #include <devices/device_tree.h>
+#include <devices/fdt.h>
 #include <fmt/assert.h>
+#include <memory.h>
 #include <panic.h>
 #include <types/byte_view.h>
 #include <types/error.h>
+#include <types/hash.h>
+#include <types/hash_map.h>
 #include <types/number.h>
+#include <types/perfect_hash.h>
+#include <types/small_vector.h>
 #include <types/stack.h>
 #include <types/str_view.h>
 
 namespace dt {
 
-struct header
+/// Index used for a missing node.
+static constexpr u32 NO_NODE = static_cast<u32>(-1);
+
+/// Deepest node nesting the parser accepts, `fdt::validate_structures` enforces it.
+static constexpr size_t MAX_DEPTH = fdt::MAX_DEPTH;
+
+/// Upper bound of #interrupt-cells the parser supports.
+static constexpr u32 MAX_INTERRUPT_CELLS = 4;
+
+/// Where a device interrupt ends up once the interrupt tree is followed to its controller.
+struct resolved_interrupt
 {
-    /// The magic number for this forrmat, must contain the value 0xD00DFEED (big-endian).
-    u32 magic;
-    /// The total size in bytes of the device tree structure.
-    u32 total_size;
-    /// Offset in bytes to the structure block.
-    u32 offset_structs;
-    /// Offset in bytes to the strings block.
-    u32 offset_strings;
-    /// Offset in bytes to the memory reservation block.
-    u32 offset_rsvmap;
-    /// The version of the devicetree data structure.
-    u32 version;
-    u32 compatible_version;
-    u32 boot_cpuid;
-    u32 size_strings;
-    u32 size_structs;
+    /// Index of the controller node, NO_NODE if the specifier couldn't be resolved.
+    u32 controller;
+    u32 hwirq;
+    u32 flags;
+};
+
+/// One row of an `interrupt-map`.
+struct interrupt_map_entry
+{
+    u128 child_address;
+    u128 parent_address;
+    u32 child_specifier[MAX_INTERRUPT_CELLS];
+    u32 parent_specifier[MAX_INTERRUPT_CELLS];
+    /// Index of the interrupt parent node.
+    u32 parent;
+    /// The parent's #interrupt-cells, the number of used cells in `parent_specifier`.
+    u32 parent_interrupt_cells;
 };
 
 struct property
@@ -63,8 +80,13 @@ struct property
         /// The #interrupt-cells property defines the number of cells required to encode an
         /// interrupt specifier for an interrupt domain.
         INTERRUPT_CELLS,
-        ///
+        /// `interrupts` or `interrupts-extended`: the interrupt specifiers of a device, and the
+        /// controller each one is finally delivered to.
+        INTERRUPTS,
+        /// Maps the interrupts of a nexus node's children to its interrupt parents.
         INTERRUPT_MAP,
+        /// The bits of the unit address and interrupt specifier an interrupt-map lookup matches.
+        INTERRUPT_MAP_MASK,
     };
 
     enum class device_status
@@ -76,10 +98,8 @@ struct property
         FAIL_WITH_REASON,
     };
 
-    /// Name of the property.
-    str_view name;
-    /// The next property in the list.
-    struct property* next_property;
+    /// Offset of the name in the string table.
+    u32 name;
     /// The type of this property.
     enum type type;
     /// The property specific type specific data
@@ -117,33 +137,48 @@ struct property
         u32 interrupt_parent;
         u32 interrupt_cells;
         struct
+        {
+            /// True for `interrupts-extended`, whose cells start each specifier with the phandle of
+            /// its interrupt parent.
+            bool extended;
+            size_t n_cells;
+            u32* cells;
+            size_t n_routes;
+            struct resolved_interrupt* routes;
+        } interrupts;
+        struct
         {
             size_t n_entries;
-            void* child_unit_addresses;
-            void* child_interrupt_specifiers;
-            void* interrupt_parents;
-            void* parent_unit_addresses;
-            void* parent_interrupt_specifiers;
-        };
+            struct interrupt_map_entry* entries;
+        } interrupt_map;
+        struct
+        {
+            size_t n_cells;
+            u32* cells;
+        } interrupt_map_mask;
     } data;
 };
 
+/// A node of the flattened tree. Nodes are stored in DFS order, so a node's subtree directly
+/// follows it, and its properties are one contiguous run of `properties`.
 struct node
 {
-    /// Name of the node.
-    str_view name;
+    /// Offset of the name in the string table.
+    u32 name;
     /// The number of the <u32> cells used to encode the address field in this node's reg property.
     u32 address_cells;
     /// The number of the <u32> cells used to encode the size field in this node's reg property.
     u32 size_cells;
-    /// Linked list of properties of the node
-    struct property* properties;
-    /// Parent node
-    struct node* parent;
-    /// Linked list of child nodes
-    struct node* children;
-    /// Next sibling node
-    struct node* next_sibling;
+    /// Index of the parent node, NO_NODE for the root.
+    u32 parent;
+    /// Index of the first child, NO_NODE if there is none.
+    u32 first_child;
+    /// Index of the next sibling, NO_NODE if there is none.
+    u32 next_sibling;
+    /// Index of the first property in `properties`.
+    u32 first_property;
+    /// Number of properties.
+    u32 property_count;
 };
 
 struct reserved_region
@@ -154,52 +189,212 @@ struct reserved_region
     size_t size;
 };
 
-/// List of reserved memory regions.
-stack<reserved_region> reserved_regions = {};
-/// List of device tree nodes. nodes[0] is the root node.
+/// List of reserved memory regions, usually only a handful.
+small_vector<reserved_region, 8> reserved_regions = {};
+/// List of device tree nodes in DFS order. nodes[0] is the root node.
 stack<struct node> nodes = {};
-/// List of device tree properties.
+/// List of device tree properties, grouped by node.
 stack<struct property> properties = {};
+/// Absolute path of each node, parallel to `nodes`. Only the indexes and `node_path` need these,
+/// so they are kept out of the way of traversals.
+stack<str_view> node_paths = {};
 /// Bump allocator for
 bump_alloc bump = {};
-struct node* root = nullptr;
 bool initialized = false;
+/// The blob the tree was parsed from. Raw and string property values point into it.
+const u8* blob = nullptr;
 
-size_t
-parse_node(struct node** current, const u8* structures, size_t offset)
+/// Null terminated node and property names, each stored once.
+char* string_table = nullptr;
+size_t string_table_size = 0;
+size_t string_table_capacity = 0;
+/// Names to their offset in `string_table`.
+hash_map<str_view, u32> interned = {};
+
+/// Nodes by phandle.
+hash_map<u32, u32> phandles = {};
+/// Nodes by absolute path.
+hash_map<str_view, u32> paths = {};
+/// Nodes by alias, resolved from the properties of `/aliases`.
+hash_map<str_view, u32> aliases = {};
+
+/// The slice of `compatible_nodes` holding the nodes of one compatible string.
+struct compatible_range
 {
-    str_view name = str_view::from_null_term((const char*)structures + offset);
-    struct node* new_node = nodes.emplace_back(name, 0u, 0u, nullptr, *current, nullptr, nullptr);
-    if (*current == nullptr) [[unlikely]] {
-        *current = new_node;
-        return offset + align_up(name.length() + 1, sizeof(u32));
+    u32 first;
+    u32 count;
+};
+
+/// Compatible strings to the nodes listing them.
+hash_map<str_view, compatible_range> compatibles = {};
+/// Nodes grouped by compatible string, each group in DFS order.
+u32* compatible_nodes = nullptr;
+
+/// Returns the name stored at `offset` in the string table.
+str_view
+name_of(u32 offset)
+{
+    return str_view::from_null_term(string_table + offset);
+}
+
+/// Stores the offset of `name` in the string table in `*offset`, adding the name if it isn't there
+/// yet.
+error
+intern(str_view name, u32* offset)
+{
+    u32* existing = interned.find(name);
+    if (existing != nullptr) {
+        *offset = *existing;
+        return ErrorCode::SUCCESS;
     }
 
-    new_node->next_sibling = (*current)->children;
-    (*current)->children = new_node;
-    *current = new_node;
-    return offset + align_up(name.length() + 1, sizeof(u32));
+    // Property names may overlap in the strings block, so a malformed blob can ask for more than
+    // the capacity computed from the block sizes.
+    if (string_table_size + name.length() + 1 > string_table_capacity) {
+        return ErrorCode::DT_MALFORMED;
+    }
+    u32 new_offset = static_cast<u32>(string_table_size);
+    char* dst = string_table + new_offset;
+    mem::copy(name.data(), dst, name.length());
+    dst[name.length()] = '\0';
+    string_table_size += name.length() + 1;
+    *offset = new_offset;
+    return interned.insert(str_view(dst, name.length()), new_offset);
 }
 
-size_t
-pre_parse_property(struct node* current, const u8* structures, const u8* strings, size_t offset)
+struct property*
+properties_begin(const struct node* node)
+{
+    return &properties[node->first_property];
+}
+
+struct property*
+properties_end(const struct node* node)
+{
+    return &properties[node->first_property] + node->property_count;
+}
+
+/// Structure block tokens and property cells are always 4-byte aligned within the blob.
+static constexpr size_t CELL_ALIGN = sizeof(u32);
+
+/// Returns the path of the child called `name` of the node at `parent_path`.
+str_view
+child_path(str_view parent_path, str_view name)
+{
+    // The root's children would otherwise get a double slash.
+    size_t prefix = (parent_path.length() == 1) ? 0 : parent_path.length();
+    size_t length = prefix + 1 + name.length();
+    char* path = (char*)bump.alloc(length);
+    assert(path != nullptr);
+    mem::copy(parent_path.data(), path, prefix);
+    path[prefix] = '/';
+    mem::copy(name.data(), path + prefix + 1, name.length());
+    return str_view(path, length);
+}
+
+/// Starts a new node as the last child of `*current`, and makes it the current node. `previous`
+/// is the node that was closed last, the new node's previous sibling if they share a parent.
+error
+parse_node(u32* current, u32 previous, const u8* structures, size_t* offset)
+{
+    str_view name = str_view::from_null_term((const char*)structures + *offset);
+    *offset += align_up(name.length() + 1, sizeof(u32));
+    u32 index = static_cast<u32>(nodes.m_size);
+    u32 parent = *current;
+    if (parent == NO_NODE) [[unlikely]] {
+        // The root node's name is empty in the blob.
+        name = str_view("/");
+    }
+
+    u32 name_offset = 0;
+    error err = intern(name, &name_offset);
+    if (err.is_err()) {
+        return err;
+    }
+    nodes.emplace_back(name_offset,
+                       0u,
+                       0u,
+                       parent,
+                       NO_NODE,
+                       NO_NODE,
+                       static_cast<u32>(properties.m_size),
+                       0u);
+    *current = index;
+    if (parent == NO_NODE) [[unlikely]] {
+        node_paths.push_back(name);
+        return err;
+    }
+
+    node_paths.push_back(child_path(node_paths[parent], name));
+    if (previous != NO_NODE && nodes[previous].parent == parent) {
+        nodes[previous].next_sibling = index;
+    } else {
+        nodes[parent].first_child = index;
+    }
+    return err;
+}
+
+error
+pre_parse_property(u32 current, const u8* structures, const u8* strings, size_t* offset)
 {
-    u32 property_length = num::read_big_endian<u32>(structures + offset);
-    offset += sizeof(u32);
-    u32 name_offset = num::read_big_endian<u32>(structures + offset);
-    offset += sizeof(u32);
+    u32 property_length = num::read_big_endian<u32, CELL_ALIGN>(structures + *offset);
+    *offset += sizeof(u32);
+    u32 name_offset = num::read_big_endian<u32, CELL_ALIGN>(structures + *offset);
+    *offset += sizeof(u32);
 
     str_view property_name = str_view::from_null_term((const char*)strings + name_offset);
-    byte_view property_value = byte_view(structures + offset, property_length);
-    offset += align_up(property_length, sizeof(u32));
+    byte_view property_value = byte_view(structures + *offset, property_length);
+    *offset += align_up(property_length, sizeof(u32));
+
+    u32 interned_name = 0;
+    error err = intern(property_name, &interned_name);
+    if (err.is_err()) {
+        return err;
+    }
 
-    struct property* new_property = properties.emplace_back(
-      property_name, current->properties, property::type::RAW, property_value);
-    current->properties = new_property;
-    return offset;
+    // Properties come before child nodes in the blob, so each node's run stays contiguous.
+    struct node* node = &nodes[current];
+    assert(node->first_property + node->property_count == properties.m_size);
+    properties.emplace_back(interned_name, property::type::RAW, property_value);
+    node->property_count++;
+    return err;
+}
+
+/// Returns the number of bytes used to store a decoded value made up of `cells` cells.
+constexpr size_t
+cell_storage_size(u32 cells)
+{
+    return (cells == 3) ? sizeof(u128) : cells * sizeof(u32);
 }
 
+/// Decodes `n` big endian values of `cells` cells each, spaced `stride` bytes apart, into `dst`.
 void
+decode_cell_column(const u8* src, void* dst, u32 cells, size_t n, size_t stride)
+{
+    switch (cells) {
+        case 0:
+            break;
+        case 1:
+            num::read_big_endian_array<u32, CELL_ALIGN>(src, (u32*)dst, n, stride);
+            break;
+        case 2:
+            num::read_big_endian_array<u64, CELL_ALIGN>(src, (u64*)dst, n, stride);
+            break;
+        case 3:
+            // Three cells are only 12 bytes wide, so they can't be read as a single u128.
+            for (size_t i = 0; i < n; i++) {
+                const u8* value = src + i * stride;
+                u128 high = num::read_big_endian<u32, CELL_ALIGN>(value);
+                u64 low = num::read_big_endian<u64, CELL_ALIGN>(value + sizeof(u32));
+                ((u128*)dst)[i] = (high << 64) | low;
+            }
+            break;
+        default:
+            __builtin_unreachable();
+    }
+}
+
+error
 property_rewrite_ranges(struct node* node, struct property* prop)
 {
     const u8* value_buffer = prop->data.raw.data();
@@ -212,369 +407,1695 @@ property_rewrite_ranges(struct node* node, struct property* prop)
             .pbus_address_array = nullptr,
             .size_array = nullptr,
         };
-        return;
+        return ErrorCode::SUCCESS;
     }
 
-    u32 child_address_size = sizeof(u32) * node->address_cells;
-    u32 parent_address_size = sizeof(u32) * node->parent->address_cells;
-    u32 size_size = sizeof(u32) * node->size_cells;
-    size_t n_trips = value_len / (child_address_size + parent_address_size + size_size);
-
-    assert(n_trips > 0);
-    assert(value_len % (child_address_size + parent_address_size + size_size) == 0);
-    assert(node->address_cells <= 3);
-    assert(node->size_cells <= 2);
-
-    void* cbus_address_array = bump.alloc_aligned(child_address_size * n_trips, child_address_size);
-    void* pbus_address_array = bump.alloc_aligned(child_address_size * n_trips, child_address_size);
-    void* size_array = bump.alloc_aligned(size_size * n_trips, size_size);
+    u32 child_address_cells = node->address_cells;
+    u32 parent_address_cells = nodes[node->parent].address_cells;
+    u32 size_cells = node->size_cells;
+    u32 child_address_size = sizeof(u32) * child_address_cells;
+    u32 parent_address_size = sizeof(u32) * parent_address_cells;
+    u32 size_size = sizeof(u32) * size_cells;
+    size_t stride = child_address_size + parent_address_size + size_size;
+    if (stride == 0 || value_len % stride != 0) {
+        return ErrorCode::DT_BAD_PROPERTY;
+    }
+    size_t n_trips = value_len / stride;
 
-    for (size_t i = 0, j = 0; i < n_trips; i++) {
-        switch (node->address_cells) {
-            case 1:
-                ((u32*)cbus_address_array)[i] = num::read_big_endian<u32>(value_buffer + j);
-                break;
-            case 2:
-                ((u64*)cbus_address_array)[i] = num::read_big_endian<u64>(value_buffer + j);
-                break;
-            case 3:
-                ((u64*)cbus_address_array)[i] = num::read_big_endian<u128>(value_buffer + j);
-                break;
-            default:
-                __builtin_unreachable();
-        }
-        j += child_address_size;
+    assert(child_address_cells <= 3);
+    assert(parent_address_cells <= 3);
+    assert(size_cells <= 2);
 
-        switch (node->parent->address_cells) {
-            case 1:
-                ((u32*)pbus_address_array)[i] = num::read_big_endian<u32>(value_buffer + j);
-                break;
-            case 2:
-                ((u64*)pbus_address_array)[i] = num::read_big_endian<u64>(value_buffer + j);
-                break;
-            case 3:
-                ((u64*)pbus_address_array)[i] = num::read_big_endian<u128>(value_buffer + j);
-                break;
-            default:
-                __builtin_unreachable();
-        }
-        j += parent_address_size;
+    size_t cbus_storage = cell_storage_size(child_address_cells);
+    size_t pbus_storage = cell_storage_size(parent_address_cells);
+    size_t size_storage = cell_storage_size(size_cells);
+    void* cbus_address_array = bump.alloc_aligned(cbus_storage * n_trips, cbus_storage);
+    void* pbus_address_array = bump.alloc_aligned(pbus_storage * n_trips, pbus_storage);
+    void* size_array = bump.alloc_aligned(size_storage * n_trips, size_storage);
 
-        switch (node->size_cells) {
-            case 0:
-                break;
-            case 1:
-                ((u32*)size_array)[i] = num::read_big_endian<u32>(value_buffer + j);
-                break;
-            case 2:
-                ((u64*)size_array)[i] = num::read_big_endian<u64>(value_buffer + j);
-                break;
-            default:
-                __builtin_unreachable();
-        }
-        j += size_size;
-    }
+    decode_cell_column(value_buffer, cbus_address_array, child_address_cells, n_trips, stride);
+    decode_cell_column(value_buffer + child_address_size,
+                       pbus_address_array,
+                       parent_address_cells,
+                       n_trips,
+                       stride);
+    decode_cell_column(value_buffer + child_address_size + parent_address_size,
+                       size_array,
+                       size_cells,
+                       n_trips,
+                       stride);
 
     prop->type = property::type::RANGES;
     prop->data.range.n_trips = n_trips;
     prop->data.range.cbus_address_array = cbus_address_array;
     prop->data.range.pbus_address_array = pbus_address_array;
     prop->data.range.size_array = size_array;
+    return ErrorCode::SUCCESS;
 }
 
-void
+error
 property_rewrite_reg(struct node* node, struct property* prop)
 {
     byte_view bv = prop->data.raw;
-    u32 address_size = sizeof(u32) * node->parent->address_cells;
-    u32 size_size = sizeof(u32) * node->parent->size_cells;
-    size_t n_pairs = bv.length() / (address_size + size_size);
-
-    assert(n_pairs > 0);
-    assert(bv.length() % (address_size + size_size) == 0,
-           bv.length(),
-           " ",
-           address_size,
-           " ",
-           size_size);
-    assert(node->parent->address_cells <= 3);
-    assert(node->parent->size_cells <= 2);
-
-    void* address_array = bump.alloc_aligned(address_size * n_pairs, address_size);
-    void* size_array = bump.alloc_aligned(size_size * n_pairs, size_size);
+    u32 address_cells = nodes[node->parent].address_cells;
+    u32 size_cells = nodes[node->parent].size_cells;
+    u32 address_size = sizeof(u32) * address_cells;
+    u32 size_size = sizeof(u32) * size_cells;
+    size_t stride = address_size + size_size;
+    if (stride == 0 || bv.length() == 0 || bv.length() % stride != 0) {
+        return ErrorCode::DT_BAD_PROPERTY;
+    }
+    size_t n_pairs = bv.length() / stride;
+
+    assert(address_cells <= 3);
+    assert(size_cells <= 2);
+
+    size_t address_storage = cell_storage_size(address_cells);
+    size_t size_storage = cell_storage_size(size_cells);
+    void* address_array = bump.alloc_aligned(address_storage * n_pairs, address_storage);
+    void* size_array = bump.alloc_aligned(size_storage * n_pairs, size_storage);
     assert((address_size == 0) ? address_array == NULL : address_array != NULL);
     assert((size_size == 0) ? size_array == NULL : size_array != NULL);
 
-    for (size_t i = 0, j = 0; i < n_pairs; i++) {
-        switch (node->parent->address_cells) {
-            case 0:
-                break;
-            case 1:
-                ((u32*)address_array)[i] = num::read_big_endian<u32>(bv.data() + j);
-                break;
-            case 2:
-                ((u64*)address_array)[i] = num::read_big_endian<u64>(bv.data() + j);
-                break;
-            case 3:
-                ((u128*)address_array)[i] = num::read_big_endian<u128>(bv.data() + j);
-                break;
-            default:
-                __builtin_unreachable();
-        }
-        j += address_size;
-
-        switch (node->parent->size_cells) {
-            case 0:
-                break;
-            case 1:
-                ((u32*)size_array)[i] = num::read_big_endian<u32>(bv.data() + j);
-                break;
-            case 2:
-                ((u64*)size_array)[i] = num::read_big_endian<u64>(bv.data() + j);
-                break;
-            default:
-                __builtin_unreachable();
-        }
-        j += size_size;
-    }
+    decode_cell_column(bv.data(), address_array, address_cells, n_pairs, stride);
+    decode_cell_column(bv.data() + address_size, size_array, size_cells, n_pairs, stride);
 
     prop->type = property::type::REG;
     prop->data.reg.n_pairs = n_pairs;
     prop->data.reg.address_array = address_array;
     prop->data.reg.size_array = size_array;
+    return ErrorCode::SUCCESS;
+}
+
+/// Decodes a property value made of big endian cells.
+void
+decode_u32_cells(byte_view raw, size_t* n_cells, u32** cells)
+{
+    *n_cells = raw.length() / sizeof(u32);
+    *cells = (u32*)bump.alloc_aligned(sizeof(u32) * *n_cells, alignof(u32));
+    assert(*n_cells == 0 || *cells != nullptr);
+    num::read_big_endian_array<u32, CELL_ALIGN>(raw.data(), *cells, *n_cells);
+}
+
+/// Property names the parser knows about.
+enum class property_name : u8
+{
+    UNKNOWN,
+    COMPATIBLE,
+    MODEL,
+    PHANDLE,
+    STATUS,
+    ADDRESS_CELLS,
+    SIZE_CELLS,
+    DMA_COHERENT,
+    DMA_NONCOHERENT,
+    DEVICE_TYPE,
+    VIRTUAL_REG,
+    INTERRUPT_PARENT,
+    INTERRUPT_CELLS,
+    INTERRUPTS,
+    INTERRUPTS_EXTENDED,
+    INTERRUPT_MAP,
+    INTERRUPT_MAP_MASK,
+    INTERRUPT_CONTROLLER,
+    REGMAP,
+    VALUE,
+    REG,
+    RANGES,
+    BUS_RANGES,
+};
+
+/// Classifies a property name with one hash and one string compare.
+static constexpr static_string_map<property_name, 22> property_names(
+  {
+    { "compatible", property_name::COMPATIBLE },
+    { "model", property_name::MODEL },
+    { "phandle", property_name::PHANDLE },
+    { "status", property_name::STATUS },
+    { "#address-cells", property_name::ADDRESS_CELLS },
+    { "#size-cells", property_name::SIZE_CELLS },
+    { "dma-coherent", property_name::DMA_COHERENT },
+    { "dma-noncoherent", property_name::DMA_NONCOHERENT },
+    { "device_type", property_name::DEVICE_TYPE },
+    { "virtual-reg", property_name::VIRTUAL_REG },
+    { "interrupt-parent", property_name::INTERRUPT_PARENT },
+    { "#interrupt-cells", property_name::INTERRUPT_CELLS },
+    { "interrupts", property_name::INTERRUPTS },
+    { "interrupts-extended", property_name::INTERRUPTS_EXTENDED },
+    { "interrupt-map", property_name::INTERRUPT_MAP },
+    { "interrupt-map-mask", property_name::INTERRUPT_MAP_MASK },
+    { "interrupt-controller", property_name::INTERRUPT_CONTROLLER },
+    { "regmap", property_name::REGMAP },
+    { "value", property_name::VALUE },
+    { "reg", property_name::REG },
+    { "ranges", property_name::RANGES },
+    { "bus-ranges", property_name::BUS_RANGES },
+  },
+  property_name::UNKNOWN);
+
+/// Returns the string stored in a property value, without its null terminator.
+str_view
+string_property(byte_view raw)
+{
+    str_view value = str_view::from_byte_view(raw);
+    if (value.length() != 0 && value[value.length() - 1] == '\0') {
+        value = value.substr(0, value.length() - 1);
+    }
+    return value;
+}
+
+/// Returns the string of the string list `list` starting at `*offset`, and moves `*offset` past
+/// its terminator. The last string may be unterminated in a malformed blob.
+str_view
+next_string(str_view list, size_t* offset)
+{
+    size_t end = list.find('\0', *offset);
+    if (end == str_view::s_sentinel) {
+        end = list.length();
+    }
+    str_view str = list.substr(*offset, end - *offset);
+    *offset = end + 1;
+    return str;
+}
+
+void
+property_rewrite_compatible(struct property* prop)
+{
+    // Empty strings are dropped, an empty string terminates the array.
+    str_view list = str_view::from_byte_view(prop->data.raw);
+    size_t num_strings = 0;
+    for (size_t i = 0; i < list.length();) {
+        if (next_string(list, &i).length() != 0) {
+            num_strings++;
+        }
+    }
+
+    prop->data.compatible_array =
+      (str_view*)bump.alloc_aligned(sizeof(str_view) * (num_strings + 1), alignof(str_view));
+    assert(prop->data.compatible_array != nullptr);
+    for (size_t i = 0, j = 0; i < list.length();) {
+        str_view compatible = next_string(list, &i);
+        if (compatible.length() != 0) {
+            prop->data.compatible_array[j++] = compatible;
+        }
+    }
+    prop->data.compatible_array[num_strings] = str_view();
+    prop->type = property::type::COMPATIBLE;
+}
+
+void
+property_rewrite_status(struct property* prop)
+{
+    str_view status_string = string_property(prop->data.raw);
+    prop->type = property::type::STATUS;
+    prop->data.status.reason = str_view();
+    if (str_view::compare("okay", status_string) == 0 ||
+        str_view::compare("ok", status_string) == 0) {
+        prop->data.status.value = property::device_status::OKAY;
+    } else if (str_view::compare("disabled", status_string) == 0) {
+        prop->data.status.value = property::device_status::DISABLED;
+    } else if (str_view::compare("reserved", status_string) == 0) {
+        prop->data.status.value = property::device_status::RESERVED;
+    } else if (str_view::compare("fail-", status_string.substr(0, 5)) == 0) {
+        prop->data.status.value = property::device_status::FAIL_WITH_REASON;
+        prop->data.status.reason = status_string.substr(5);
+    } else {
+        prop->data.status.value = property::device_status::FAIL;
+    }
+}
+
+/// Reads the value of a single cell property. Fails if the value is too short to hold one.
+error
+read_cell(byte_view raw, u32* value)
+{
+    if (raw.length() < sizeof(u32)) {
+        return ErrorCode::DT_BAD_PROPERTY;
+    }
+    *value = num::read_big_endian<u32, CELL_ALIGN>(raw.data());
+    return ErrorCode::SUCCESS;
 }
 
+/// Decodes the properties of `node`. Its parent must have been rewritten already.
 error
-recursive_property_rewrite(struct node* node)
+property_rewrite_node(struct node* node)
 {
     error err = error();
 
-    for (struct property* prop = node->properties; prop != nullptr; prop = prop->next_property) {
-        if (str_view::compare("compatible", prop->name) == 0) {
-            byte_view raw_view = prop->data.raw;
-            size_t num_strings = 0;
-            for (size_t i = 0; i < raw_view.length(); i++) {
-                if (raw_view[i] == '\0') {
-                    num_strings++;
+    for (struct property* prop = properties_begin(node); prop != properties_end(node); prop++) {
+        switch (property_names.find(name_of(prop->name))) {
+            case property_name::COMPATIBLE:
+                property_rewrite_compatible(prop);
+                break;
+            case property_name::MODEL:
+                prop->type = property::type::MODEL;
+                prop->data.model = string_property(prop->data.raw);
+                break;
+            case property_name::PHANDLE:
+                prop->type = property::type::PHANDLE;
+                if ((err = read_cell(prop->data.raw, &prop->data.phandle)).is_err()) {
+                    return err;
                 }
+                break;
+            case property_name::STATUS:
+                property_rewrite_status(prop);
+                break;
+            case property_name::ADDRESS_CELLS:
+                prop->type = property::type::ADDRESS_CELLS;
+                if ((err = read_cell(prop->data.raw, &prop->data.address_cells)).is_err()) {
+                    return err;
+                }
+                if (prop->data.address_cells > 3) {
+                    return ErrorCode::DT_ADDRESS_CELLS_TOO_LARGE;
+                }
+                node->address_cells = prop->data.address_cells;
+                break;
+            case property_name::SIZE_CELLS:
+                prop->type = property::type::SIZE_CELLS;
+                if ((err = read_cell(prop->data.raw, &prop->data.size_cells)).is_err()) {
+                    return err;
+                }
+                if (prop->data.size_cells > 2) {
+                    return ErrorCode::DT_SIZE_CELLS_TOO_LARGE;
+                }
+                node->size_cells = prop->data.size_cells;
+                break;
+            case property_name::DMA_COHERENT:
+                prop->type = property::type::DMA_COHERENCE;
+                prop->data.dma_coherence = true;
+                break;
+            case property_name::DMA_NONCOHERENT:
+                prop->type = property::type::DMA_COHERENCE;
+                prop->data.dma_coherence = false;
+                break;
+            case property_name::DEVICE_TYPE:
+                prop->type = property::type::DEVICE_TYPE;
+                prop->data.device_type = string_property(prop->data.raw);
+                break;
+            case property_name::VIRTUAL_REG:
+                prop->type = property::type::VIRTUAL_REG;
+                if ((err = read_cell(prop->data.raw, &prop->data.virtual_reg)).is_err()) {
+                    return err;
+                }
+                break;
+            case property_name::INTERRUPT_PARENT:
+                prop->type = property::type::INTERRUPT_PARENT;
+                if ((err = read_cell(prop->data.raw, &prop->data.interrupt_parent)).is_err()) {
+                    return err;
+                }
+                break;
+            case property_name::INTERRUPT_CELLS:
+                prop->type = property::type::INTERRUPT_CELLS;
+                if ((err = read_cell(prop->data.raw, &prop->data.interrupt_cells)).is_err()) {
+                    return err;
+                }
+                break;
+            case property_name::INTERRUPT_CONTROLLER:
+                prop->type = property::type::INTERRUPT_CONTROLLER;
+                break;
+            case property_name::INTERRUPTS:
+            case property_name::INTERRUPTS_EXTENDED:
+            {
+                // `raw` shares storage with the decoded fields, read it before they are written.
+                byte_view raw = prop->data.raw;
+                prop->type = property::type::INTERRUPTS;
+                prop->data.interrupts.extended =
+                  property_names.find(name_of(prop->name)) == property_name::INTERRUPTS_EXTENDED;
+                decode_u32_cells(raw, &prop->data.interrupts.n_cells, &prop->data.interrupts.cells);
+                prop->data.interrupts.n_routes = 0;
+                prop->data.interrupts.routes = nullptr;
+                break;
             }
-
-            prop->data.compatible_array = (str_view*)bump.alloc_aligned(
-              sizeof(str_view*) * (num_strings + 1), sizeof(str_view*));
-            assert(prop->data.compatible_array != nullptr);
-            for (size_t i = 0, j = 0; i < raw_view.length(); j++) {
-                prop->data.compatible_array[j] =
-                  str_view::from_null_term((const char*)&raw_view[i]);
-                i += prop->data.compatible_array[j].length() + 1;
-            }
-            prop->data.compatible_array[num_strings] = str_view();
-            prop->type = property::type::COMPATIBLE;
-        } else if (str_view::compare("model", prop->name) == 0) {
-            str_view model_string = str_view::from_byte_view(prop->data.raw);
-            prop->type = property::type::MODEL;
-            prop->data.model = model_string;
-        } else if (str_view::compare("phandle", prop->name) == 0) {
-            prop->type = property::type::PHANDLE;
-            u32 phandle = num::read_big_endian<u32>(prop->data.raw.data());
-            prop->data.phandle = phandle;
-        } else if (str_view::compare("status", prop->name) == 0) {
-            prop->type = property::type::STATUS;
-            str_view status_string = str_view::from_byte_view(prop->data.raw);
-            if (str_view::compare("okay", status_string) == 0) {
-                prop->data.status.value = property::device_status::OKAY;
-                prop->data.status.reason = str_view();
-            } else if (str_view::compare("disabled", status_string) == 0) {
-                prop->data.status.value = property::device_status::DISABLED;
-                prop->data.status.reason = str_view();
-            } else if (str_view::compare("reserved", status_string) == 0) {
-                prop->data.status.value = property::device_status::RESERVED;
-                prop->data.status.reason = str_view();
-            } else if (str_view::compare("fail", status_string) == 0) {
-                prop->data.status.value = property::device_status::FAIL;
-                prop->data.status.reason = str_view();
-            } else if (str_view::compare("fail-", status_string.advance(5)) == 0) {
-                prop->data.status.value = property::device_status::FAIL_WITH_REASON;
-                prop->data.status.reason = status_string.advance(5);
-            }
-        } else if (str_view::compare("#address-cells", prop->name) == 0) {
-            prop->type = property::type::ADDRESS_CELLS;
-            prop->data.address_cells = num::read_big_endian<u32>(prop->data.raw.data());
-            if (prop->data.address_cells > 3) {
-                return ErrorCode::DT_ADDRESS_CELLS_TOO_LARGE;
-            }
-            node->address_cells = prop->data.address_cells;
-        } else if (str_view::compare("#size-cells", prop->name) == 0) {
-            prop->type = property::type::SIZE_CELLS;
-            prop->data.size_cells = num::read_big_endian<u32>(prop->data.raw.data());
-            if (prop->data.size_cells > 2) {
-                return ErrorCode::DT_SIZE_CELLS_TOO_LARGE;
+            case property_name::INTERRUPT_MAP_MASK:
+            {
+                byte_view raw = prop->data.raw;
+                prop->type = property::type::INTERRUPT_MAP_MASK;
+                decode_u32_cells(raw,
+                                 &prop->data.interrupt_map_mask.n_cells,
+                                 &prop->data.interrupt_map_mask.cells);
+                break;
             }
-            node->size_cells = prop->data.size_cells;
-        } else if (str_view::compare("dma-coherent", prop->name) == 0) {
-            prop->type = property::type::DMA_COHERENCE;
-            prop->data.dma_coherence = true;
-        } else if (str_view::compare("dma-noncoherent", prop->name) == 0) {
-            prop->type = property::type::DMA_COHERENCE;
-            prop->data.dma_coherence = false;
-        } else if (str_view::compare("device_type", prop->name) == 0) {
-            prop->type = property::type::DEVICE_TYPE;
-            prop->data.device_type = str_view::from_byte_view(prop->data.raw);
-        } else if (str_view::compare("virtual-reg", prop->name) == 0) {
-            prop->type = property::type::VIRTUAL_REG;
-            prop->data.virtual_reg = num::read_big_endian<u32>(prop->data.raw.data());
-        } else if (str_view::compare("interrupt-parent", prop->name) == 0) {
-            prop->type = property::type::INTERRUPT_PARENT;
-            prop->data.interrupt_parent = num::read_big_endian<u32>(prop->data.raw.data());
-        } else if (str_view::compare("#interrupt-cells", prop->name) == 0) {
-            prop->type = property::type::INTERRUPT_CELLS;
-            prop->data.interrupt_cells = num::read_big_endian<u32>(prop->data.raw.data());
-        } else if (str_view::compare("interrupts", prop->name) == 0) {
-            //            todo("Implement parsing of 'interrupts' property");
-        } else if (str_view::compare("interrupt-map", prop->name) == 0) {
-            //            todo("Implement parsing of 'interrupt-map' property");
-        } else if (str_view::compare("interrupt-map-mask", prop->name) == 0) {
-            //            todo("Implement parsing of 'interrupt-map-mask' property");
-        } else if (str_view::compare("interrupt-controller", prop->name) == 0) {
-            prop->type = property::type::INTERRUPT_CONTROLLER;
-        } else if (str_view::compare("regmap", prop->name) == 0) {
-            //            todo("Implement parsing of 'regmap' property");
-        } else if (str_view::compare("value", prop->name) == 0) {
-            //            todo("Implement parsing of 'value' property");
-        }
-
-        else if (str_view::compare("reg", prop->name) == 0 ||
-                 str_view::compare("ranges", prop->name) == 0 ||
-                 str_view::compare("bus-ranges", prop->name) == 0) {
-            // property_rewrite_ranges(node, prop);
-        } else {
-            fmt::println("Unhandled device tree property: ", prop->name);
-        }
-    }
-
-    // Second lap through the properties to work on `reg`, `ranges`, and `bus-ranges`
-    for (struct property* prop = node->properties; prop != nullptr; prop = prop->next_property) {
-        if (str_view::compare("reg", prop->name) == 0) {
-            property_rewrite_reg(node, prop);
-        } else if (str_view::compare("ranges", prop->name) == 0 ||
-                   str_view::compare("bus-ranges", prop->name) == 0) {
-            property_rewrite_ranges(node, prop);
-        }
-    }
-
-    for (struct node* child = node->children; child != nullptr; child = child->next_sibling) {
-        if ((err = recursive_property_rewrite(child)).is_err()) {
+            case property_name::INTERRUPT_MAP:
+                // Decoded by `resolve_interrupts`, its rows refer to other nodes by phandle.
+                break;
+            case property_name::REGMAP:
+            case property_name::VALUE:
+                // Not decoded yet, left RAW.
+                break;
+            case property_name::REG:
+            case property_name::RANGES:
+            case property_name::BUS_RANGES:
+                // Decoded in the second pass, once #address-cells and #size-cells are known.
+                break;
+            case property_name::UNKNOWN:
+                fmt::println("Unhandled device tree property: ", name_of(prop->name));
+                break;
+        }
+    }
+
+    // Second lap through the properties to work on `reg`, `ranges`, and `bus-ranges`, which are
+    // relative to the parent's address space. The root has none.
+    if (node->parent == NO_NODE) {
+        return err;
+    }
+    for (struct property* prop = properties_begin(node); prop != properties_end(node); prop++) {
+        switch (property_names.find(name_of(prop->name))) {
+            case property_name::REG:
+                err = property_rewrite_reg(node, prop);
+                break;
+            case property_name::RANGES:
+            case property_name::BUS_RANGES:
+                err = property_rewrite_ranges(node, prop);
+                break;
+            default:
+                break;
+        }
+        if (err.is_err()) {
             return err;
         }
     }
     return err;
 }
 
-static const u32 STRUCTURE_BEGIN_NODE = 0x01;
-static const u32 STRUCTURE_END_NODE = 0x02;
-static const u32 STRUCTURE_PROP = 0x03;
-static const u32 STRUCTURE_NOP = 0x04;
-static const u32 STRUCTURE_END = 0x09;
-
-error
-parse_from_blob(const u8* dtb)
+/// Returns the child of `node` called `name`, or NO_NODE. A `name` without a unit address also
+/// matches a child that has one.
+u32
+find_child(u32 node, str_view name)
 {
-
-    const struct header* hdr = (const struct header*)dtb;
-    if (0xD00DFEED != num::flip_endianness(hdr->magic)) {
-        return ErrorCode::DT_MAGIC_NUMBER;
+    if (name.find('@') != str_view::s_sentinel) {
+        // Full names are interned, so a match is a compare of string table offsets.
+        u32* id = interned.find(name);
+        if (id == nullptr) {
+            return NO_NODE;
+        }
+        for (u32 child = nodes[node].first_child; child != NO_NODE;
+             child = nodes[child].next_sibling) {
+            if (nodes[child].name == *id) {
+                return child;
+            }
+        }
+        return NO_NODE;
     }
 
-    // size_t size = num::flip_endianness(hdr->total_size);
-
-    u64* rsvmap = (u64*)(dtb + num::flip_endianness(hdr->offset_rsvmap));
-    while (rsvmap[0] != 0 && rsvmap[1] != 0) {
-        reserved_regions.emplace_back(num::flip_endianness(rsvmap[0]),
-                                      num::flip_endianness(rsvmap[1]));
+    for (u32 child = nodes[node].first_child; child != NO_NODE; child = nodes[child].next_sibling) {
+        str_view child_name = name_of(nodes[child].name);
+        if (str_view::compare(child_name.substr(0, child_name.find('@')), name) == 0) {
+            return child;
+        }
     }
+    return NO_NODE;
+}
 
-    const u8* structures = dtb + num::flip_endianness(hdr->offset_structs);
-    const u8* strings = dtb + num::flip_endianness(hdr->offset_strings);
-    // byte_view structures = byte_view(dtb + num::flip_endianness(hdr->offset_structs),
-    //                                  num::flip_endianness(hdr->size_structs));
-    // byte_view
-
-    struct node* pseudo_root_node = nullptr;
-    size_t offset = 0;
-    size_t depth = 0;
+/// Follows the `/` separated components of `path` down from `node`.
+u32
+walk_path(u32 node, str_view path)
+{
+    size_t start = 0;
+    while (node != NO_NODE && start < path.length()) {
+        size_t end = path.find('/', start);
+        if (end == str_view::s_sentinel) {
+            end = path.length();
+        }
+        if (end != start) {
+            node = find_child(node, path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return node;
+}
 
-    struct node* current = pseudo_root_node;
-    for (;;) {
-        assert(offset % 4 == 0, "Accesses muust be 4 bytes aligned.");
-        u32 token = num::read_big_endian<u32>(structures + offset);
-        offset += sizeof(u32);
+u32
+lookup_path(str_view path)
+{
+    if (path.length() == 0 || nodes.m_size == 0) {
+        return NO_NODE;
+    }
 
-        switch (token) {
-            case STRUCTURE_BEGIN_NODE:
-                offset = parse_node(&current, structures, offset);
-                depth++;
-                break;
+    if (path[0] == '/') {
+        u32* node = paths.find(path);
+        return (node != nullptr) ? *node : walk_path(0, path);
+    }
 
-            case STRUCTURE_END_NODE:
-                current = current->parent;
-                depth--;
-                break;
+    size_t end = path.find('/');
+    u32* alias = aliases.find(path.substr(0, end));
+    if (alias == nullptr) {
+        return NO_NODE;
+    }
+    return (end == str_view::s_sentinel) ? *alias : walk_path(*alias, path.substr(end + 1));
+}
 
-            case STRUCTURE_PROP:
-                offset = pre_parse_property(current, structures, strings, offset);
-                break;
+/// Fills the phandle, path, alias and compatible indexes from the decoded tree.
+error
+build_indexes()
+{
+    error err = error();
+    if ((err = paths.reserve(nodes.m_size)).is_err()) {
+        return err;
+    }
 
-            case STRUCTURE_NOP:
-                break;
+    // First pass: everything but the compatible groups, which only get counted.
+    size_t n_compatible = 0;
+    for (u32 i = 0; i < nodes.m_size; i++) {
+        if ((err = paths.insert(node_paths[i], i)).is_err()) {
+            return err;
+        }
 
-            case STRUCTURE_END:
-                if (current != nullptr) {
-                    panic("While parsing the device tree, found a STRUCTURES_END token while the "
-                          "current node is not the root node. Depth: ",
-                          depth);
+        for (struct property* prop = properties_begin(&nodes[i]); prop != properties_end(&nodes[i]);
+             prop++) {
+            if (prop->type == property::type::PHANDLE) {
+                if ((err = phandles.insert(prop->data.phandle, i)).is_err()) {
+                    return err;
                 }
-                goto dtb_property_rewrite_pass;
+            } else if (prop->type == property::type::COMPATIBLE) {
+                for (str_view* c = prop->data.compatible_array; c->length() != 0; c++) {
+                    compatible_range* range = compatibles.find(*c);
+                    if (range != nullptr) {
+                        range->count++;
+                    } else if ((err = compatibles.insert(*c, { 0, 1 })).is_err()) {
+                        return err;
+                    }
+                    n_compatible++;
+                }
+            }
+        }
+    }
 
-            default:
-                panic("While parsing the device tree, found an unknown structure token type: ",
-                      fmt::hex(token));
+    // Lay the groups out back to back, then fill them in DFS order.
+    u32 first = 0;
+    compatibles.for_each([&](str_view, compatible_range& range) {
+        range.first = first;
+        first += range.count;
+        range.count = 0;
+    });
+    if (n_compatible != 0) {
+        compatible_nodes = (u32*)bump.alloc_aligned(sizeof(u32) * n_compatible, alignof(u32));
+        assert(compatible_nodes != nullptr);
+    }
+    for (u32 i = 0; i < nodes.m_size; i++) {
+        for (struct property* prop = properties_begin(&nodes[i]); prop != properties_end(&nodes[i]);
+             prop++) {
+            if (prop->type != property::type::COMPATIBLE) {
+                continue;
+            }
+            for (str_view* c = prop->data.compatible_array; c->length() != 0; c++) {
+                compatible_range* range = compatibles.find(*c);
+                compatible_nodes[range->first + range->count++] = i;
+            }
         }
     }
 
-dtb_property_rewrite_pass:
-    if (nodes.m_size == 0) {
-        return error(ErrorCode::DT_NO_NODES);
+    // Alias values are paths, resolve them once here.
+    u32* alias_node = paths.find(str_view("/aliases"));
+    if (alias_node == nullptr) {
+        return err;
+    }
+    struct node* node = &nodes[*alias_node];
+    for (struct property* prop = properties_begin(node); prop != properties_end(node); prop++) {
+        if (prop->type != property::type::RAW) {
+            continue;
+        }
+        u32 target = lookup_path(string_property(prop->data.raw));
+        if (target == NO_NODE) {
+            fmt::println("Device tree alias ", name_of(prop->name), " points to a missing node.");
+            continue;
+        }
+        if ((err = aliases.insert(name_of(prop->name), target)).is_err()) {
+            return err;
+        }
     }
-    root = &nodes[0];
+    return err;
+}
 
-    /// We're now ready to properly rewrite the device tree properties.
-    root->address_cells = 2;
-    root->size_cells = 1;
-    error err = recursive_property_rewrite(root);
-    if (err.is_err()) {
-        return err.push(ErrorCode::DT_REWRITE_FAILED);
+/// Returns the first property of `node` of the given type, or nullptr.
+struct property*
+find_property(const struct node* node, enum property::type type)
+{
+    for (struct property* prop = properties_begin(node); prop != properties_end(node); prop++) {
+        if (prop->type == type) {
+            return prop;
+        }
     }
+    return nullptr;
+}
 
-    initialized = true;
-    root->name = str_view("/");
-    return error(ErrorCode::SUCCESS);
+/// Returns the #interrupt-cells of `node`, 0 if it doesn't specify it.
+u32
+interrupt_cells_of(u32 node)
+{
+    struct property* prop = find_property(&nodes[node], property::type::INTERRUPT_CELLS);
+    return (prop != nullptr) ? prop->data.interrupt_cells : 0;
 }
 
-void
-print_node_recursive(struct node* node, int depth)
+/// Returns the node at `phandle`, or NO_NODE.
+u32
+node_at_phandle(u32 phandle)
 {
-    if (node == nullptr) {
-        return;
+    u32* node = phandles.find(phandle);
+    return (node != nullptr) ? *node : NO_NODE;
+}
+
+/// Returns the interrupt domain `node` belongs to: the first node with an #interrupt-cells found
+/// by following interrupt-parent, or the tree parent where there is none. NO_NODE if there is no
+/// such node.
+u32
+find_interrupt_parent(u32 node)
+{
+    // Bounded, as broken interrupt-parent phandles could form a cycle. No sane interrupt tree
+    // comes close to MAX_DEPTH levels.
+    for (size_t hops = 0; node != NO_NODE && hops < MAX_DEPTH; hops++) {
+        struct property* prop = find_property(&nodes[node], property::type::INTERRUPT_PARENT);
+        node =
+          (prop != nullptr) ? node_at_phandle(prop->data.interrupt_parent) : nodes[node].parent;
+        if (node != NO_NODE && interrupt_cells_of(node) != 0) {
+            return node;
+        }
     }
+    return NO_NODE;
+}
 
-    for (int i = 0; i < depth; i++) {
-        fmt::print("  ");
+/// Returns the value of the first `n` cells of `cells`.
+u128
+join_cells(const u32* cells, u32 n)
+{
+    u128 value = 0;
+    for (u32 i = 0; i < n; i++) {
+        value = (value << 32) | cells[i];
     }
-    fmt::println("Node: ", node->name, " {");
-    for (struct property* prop = node->properties; prop != nullptr; prop = prop->next_property) {
-        for (int i = 0; i < depth + 1; i++) {
-            fmt::print("  ");
-        }
-        fmt::print("Property: ", prop->name, " = ");
+    return value;
+}
+
+/// Returns a mask covering an address of `cells` cells. Built a cell at a time, as variable u128
+/// shifts would call into libgcc.
+u128
+address_mask(u32 cells)
+{
+    u128 mask = 0;
+    for (u32 i = 0; i < cells; i++) {
+        mask = (mask << 32) | 0xFFFFFFFF;
+    }
+    return mask;
+}
+
+/// Returns the unit address of `node`, the first address of its reg, or 0 if it has none.
+u128
+unit_address(u32 node)
+{
+    struct property* prop = find_property(&nodes[node], property::type::REG);
+    if (prop == nullptr || prop->data.reg.n_pairs == 0 || nodes[node].parent == NO_NODE) {
+        return 0;
+    }
+    switch (nodes[nodes[node].parent].address_cells) {
+        case 1:
+            return *(u32*)prop->data.reg.address_array;
+        case 2:
+            return *(u64*)prop->data.reg.address_array;
+        case 3:
+            return *(u128*)prop->data.reg.address_array;
+        default:
+            return 0;
+    }
+}
+
+/// Decodes the `interrupt-map` of `nexus` into `entries`, or only counts its rows if `entries` is
+/// null. Rows don't have a fixed width, it depends on the interrupt parent each of them names.
+error
+walk_interrupt_map(u32 nexus, byte_view raw, struct interrupt_map_entry* entries, size_t* n)
+{
+    u32 child_address_cells = nodes[nexus].address_cells;
+    u32 child_interrupt_cells = interrupt_cells_of(nexus);
+    if (child_interrupt_cells > MAX_INTERRUPT_CELLS) {
+        return ErrorCode::DT_INTERRUPT_CELLS_TOO_LARGE;
+    }
+
+    const u8* data = raw.data();
+    size_t remaining = raw.length() / sizeof(u32);
+    *n = 0;
+    while (remaining != 0) {
+        // child unit address, child specifier, parent phandle, parent unit address, parent
+        // specifier.
+        size_t head = child_address_cells + child_interrupt_cells + 1;
+        if (remaining < head) {
+            return ErrorCode::DT_BAD_INTERRUPTS;
+        }
+        u32 phandle = num::read_big_endian<u32, CELL_ALIGN>(data + (head - 1) * sizeof(u32));
+        u32 parent = node_at_phandle(phandle);
+        if (parent == NO_NODE) {
+            return ErrorCode::DT_BAD_INTERRUPTS;
+        }
+        u32 parent_address_cells = nodes[parent].address_cells;
+        u32 parent_interrupt_cells = interrupt_cells_of(parent);
+        if (parent_interrupt_cells > MAX_INTERRUPT_CELLS) {
+            return ErrorCode::DT_INTERRUPT_CELLS_TOO_LARGE;
+        }
+        size_t row = head + parent_address_cells + parent_interrupt_cells;
+        if (remaining < row) {
+            return ErrorCode::DT_BAD_INTERRUPTS;
+        }
+
+        if (entries != nullptr) {
+            struct interrupt_map_entry* entry = &entries[*n];
+            *entry = {};
+            const u8* cell = data;
+            entry->child_address = fdt::read_cells(cell, child_address_cells);
+            cell += child_address_cells * sizeof(u32);
+            num::read_big_endian_array<u32, CELL_ALIGN>(
+              cell, entry->child_specifier, child_interrupt_cells);
+            cell += (child_interrupt_cells + 1) * sizeof(u32);
+            entry->parent_address = fdt::read_cells(cell, parent_address_cells);
+            cell += parent_address_cells * sizeof(u32);
+            num::read_big_endian_array<u32, CELL_ALIGN>(
+              cell, entry->parent_specifier, parent_interrupt_cells);
+            entry->parent = parent;
+            entry->parent_interrupt_cells = parent_interrupt_cells;
+        }
+        (*n)++;
+        data += row * sizeof(u32);
+        remaining -= row;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Returns the `interrupt-map` row of `nexus` matching the unit address and specifier, or
+/// nullptr.
+const struct interrupt_map_entry*
+match_interrupt_map(u32 nexus,
+                    const struct property* map,
+                    u128 address,
+                    const u32* specifier,
+                    u32 n_cells)
+{
+    // Without an interrupt-map-mask every bit takes part in the match.
+    u32 address_cells = nodes[nexus].address_cells;
+    u128 address_bits = address_mask(address_cells);
+    u32 specifier_mask[MAX_INTERRUPT_CELLS] = { ~0u, ~0u, ~0u, ~0u };
+    struct property* mask = find_property(&nodes[nexus], property::type::INTERRUPT_MAP_MASK);
+    if (mask != nullptr && mask->data.interrupt_map_mask.n_cells >= address_cells + n_cells) {
+        const u32* cells = mask->data.interrupt_map_mask.cells;
+        address_bits = join_cells(cells, address_cells);
+        for (u32 i = 0; i < n_cells; i++) specifier_mask[i] = cells[address_cells + i];
+    }
+
+    for (size_t i = 0; i < map->data.interrupt_map.n_entries; i++) {
+        const struct interrupt_map_entry* entry = &map->data.interrupt_map.entries[i];
+        bool match = ((entry->child_address ^ address) & address_bits) == 0;
+        for (u32 j = 0; match && j < n_cells; j++) {
+            match = ((entry->child_specifier[j] ^ specifier[j]) & specifier_mask[j]) == 0;
+        }
+        if (match) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+/// Follows the interrupt tree from `domain`, the interrupt parent of a device with the given unit
+/// address and interrupt specifier, to the controller that finally receives the interrupt.
+struct resolved_interrupt
+route_interrupt(u32 domain, u128 address, const u32* specifier, u32 n_cells)
+{
+    u32 cells[MAX_INTERRUPT_CELLS] = {};
+    n_cells = (n_cells < MAX_INTERRUPT_CELLS) ? n_cells : MAX_INTERRUPT_CELLS;
+    mem::copy(specifier, cells, n_cells * sizeof(u32));
+
+    for (size_t hops = 0; domain != NO_NODE && hops < MAX_DEPTH; hops++) {
+        const struct node* node = &nodes[domain];
+        if (find_property(node, property::type::INTERRUPT_CONTROLLER) != nullptr) {
+            return { domain, (n_cells > 0) ? cells[0] : 0, (n_cells > 1) ? cells[1] : 0 };
+        }
+
+        struct property* map = find_property(node, property::type::INTERRUPT_MAP);
+        if (map == nullptr) {
+            domain = find_interrupt_parent(domain);
+            continue;
+        }
+        const struct interrupt_map_entry* entry =
+          match_interrupt_map(domain, map, address, cells, n_cells);
+        if (entry == nullptr) {
+            break;
+        }
+        domain = entry->parent;
+        address = entry->parent_address;
+        n_cells = entry->parent_interrupt_cells;
+        mem::copy(entry->parent_specifier, cells, sizeof(cells));
+    }
+    return { NO_NODE, 0, 0 };
+}
+
+/// Calls `fn(u32 domain, const u32* specifier, u32 n_cells)` for each interrupt specifier of
+/// `prop`, an interrupts or interrupts-extended property of `node`.
+template<typename F>
+error
+for_each_interrupt_specifier(u32 node, const struct property* prop, F&& fn)
+{
+    const u32* cells = prop->data.interrupts.cells;
+    size_t n_cells = prop->data.interrupts.n_cells;
+    if (!prop->data.interrupts.extended) {
+        u32 domain = find_interrupt_parent(node);
+        u32 width = (domain != NO_NODE) ? interrupt_cells_of(domain) : 0;
+        // A trailing partial specifier means the blob disagrees with the parent's #interrupt-cells.
+        if (width == 0 || n_cells % width != 0) {
+            return ErrorCode::DT_BAD_INTERRUPTS;
+        }
+        if (width > MAX_INTERRUPT_CELLS) {
+            return ErrorCode::DT_INTERRUPT_CELLS_TOO_LARGE;
+        }
+        for (size_t i = 0; i < n_cells; i += width) {
+            fn(domain, cells + i, width);
+        }
+        return ErrorCode::SUCCESS;
+    }
+
+    // Each specifier is preceded by the phandle of its own interrupt parent.
+    for (size_t i = 0; i < n_cells;) {
+        u32 domain = node_at_phandle(cells[i]);
+        u32 width = (domain != NO_NODE) ? interrupt_cells_of(domain) : 0;
+        if (width == 0 || i + 1 + width > n_cells) {
+            return ErrorCode::DT_BAD_INTERRUPTS;
+        }
+        if (width > MAX_INTERRUPT_CELLS) {
+            return ErrorCode::DT_INTERRUPT_CELLS_TOO_LARGE;
+        }
+        fn(domain, cells + i + 1, width);
+        i += 1 + width;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Decodes the interrupt maps, which needs the phandle index, then resolves every interrupt of
+/// every device to its controller and hwirq once, so drivers never walk the interrupt tree.
+error
+resolve_interrupts()
+{
+    error err = error();
+    for (u32 i = 0; i < nodes.m_size; i++) {
+        for (struct property* map = properties_begin(&nodes[i]); map != properties_end(&nodes[i]);
+             map++) {
+            if (map->type != property::type::RAW ||
+                property_names.find(name_of(map->name)) != property_name::INTERRUPT_MAP) {
+                continue;
+            }
+            size_t n_entries = 0;
+            if ((err = walk_interrupt_map(i, map->data.raw, nullptr, &n_entries)).is_err()) {
+                return err;
+            }
+            struct interrupt_map_entry* entries = (struct interrupt_map_entry*)bump.alloc_aligned(
+              sizeof(struct interrupt_map_entry) * n_entries, alignof(struct interrupt_map_entry));
+            assert(n_entries == 0 || entries != nullptr);
+            if ((err = walk_interrupt_map(i, map->data.raw, entries, &n_entries)).is_err()) {
+                return err;
+            }
+            map->type = property::type::INTERRUPT_MAP;
+            map->data.interrupt_map.n_entries = n_entries;
+            map->data.interrupt_map.entries = entries;
+        }
+    }
+
+    // Maps can chain into each other, so routes are only computed once all of them are decoded.
+    for (u32 i = 0; i < nodes.m_size; i++) {
+        struct property* prop = find_property(&nodes[i], property::type::INTERRUPTS);
+        if (prop == nullptr) {
+            continue;
+        }
+        size_t n_routes = 0;
+        err = for_each_interrupt_specifier(i, prop, [&](u32, const u32*, u32) { n_routes++; });
+        if (err.is_err()) {
+            return err;
+        }
+        struct resolved_interrupt* routes = (struct resolved_interrupt*)bump.alloc_aligned(
+          sizeof(struct resolved_interrupt) * n_routes, alignof(struct resolved_interrupt));
+        assert(n_routes == 0 || routes != nullptr);
+
+        u128 address = unit_address(i);
+        size_t n = 0;
+        err = for_each_interrupt_specifier(i, prop, [&](u32 domain, const u32* spec, u32 cells) {
+            routes[n++] = route_interrupt(domain, address, spec, cells);
+        });
+        if (err.is_err()) {
+            return err;
+        }
+        prop->data.interrupts.n_routes = n_routes;
+        prop->data.interrupts.routes = routes;
+    }
+    return err;
+}
+
+void
+parse_reserved_regions(const u8* dtb)
+{
+    const fdt::header* hdr = (const fdt::header*)dtb;
+    // The reservation block is a list of (address, size) pairs terminated by an all-zero entry.
+    const u8* rsvmap = dtb + num::flip_endianness(hdr->offset_rsvmap);
+    const u8* end = dtb + num::flip_endianness(hdr->total_size);
+    for (; rsvmap + 2 * sizeof(u64) <= end; rsvmap += 2 * sizeof(u64)) {
+        u64 address = num::read_big_endian<u64, sizeof(u64)>(rsvmap);
+        u64 size = num::read_big_endian<u64, sizeof(u64)>(rsvmap + sizeof(u64));
+        if (address == 0 && size == 0) {
+            break;
+        }
+        reserved_regions.emplace_back(address, size);
+    }
+}
+
+/// Parses the blob into the module state, which is left half built on failure.
+error
+parse(const u8* dtb)
+{
+    error err = fdt::validate_header(dtb);
+    if (err.is_err()) {
+        return err;
+    }
+
+    const fdt::header* hdr = (const fdt::header*)dtb;
+    const u8* structures = dtb + num::flip_endianness(hdr->offset_structs);
+    const u8* strings = dtb + num::flip_endianness(hdr->offset_strings);
+    size_t n_nodes = 0;
+    size_t n_properties = 0;
+    err = fdt::validate_structures(byte_view(structures, num::flip_endianness(hdr->size_structs)),
+                                   byte_view(strings, num::flip_endianness(hdr->size_strings)),
+                                   &n_nodes,
+                                   &n_properties);
+    if (err.is_err()) {
+        return err;
+    }
+
+    blob = dtb;
+    parse_reserved_regions(dtb);
+
+    err = nodes.grow_to_min_cap(n_nodes);
+    if (err.is_ok()) {
+        err = properties.grow_to_min_cap(n_properties);
+    }
+    if (err.is_ok()) {
+        err = node_paths.grow_to_min_cap(n_nodes);
+    }
+    if (err.is_ok()) {
+        // Every node and property contributes at most one name.
+        err = interned.reserve(n_nodes + n_properties);
+    }
+    if (err.is_err()) {
+        return err;
+    }
+
+    // Every name comes from either the strings block or a node name in the structure block, which
+    // bounds the size of the string table of a well formed blob. The extra bytes are for the
+    // root's "/".
+    string_table_capacity =
+      num::flip_endianness(hdr->size_strings) + num::flip_endianness(hdr->size_structs) + 2;
+    string_table = (char*)bump.alloc(string_table_capacity);
+    assert(string_table != nullptr);
+
+    // `fdt::validate_structures` vouched for the block, so this pass doesn't check bounds again.
+    size_t offset = 0;
+    u32 current = NO_NODE;
+    u32 previous = NO_NODE;
+    for (;;) {
+        assert(offset % 4 == 0, "Accesses muust be 4 bytes aligned.");
+        u32 token = num::read_big_endian<u32, CELL_ALIGN>(structures + offset);
+        offset += sizeof(u32);
+
+        switch (token) {
+            case fdt::TOKEN_BEGIN_NODE:
+                err = parse_node(&current, previous, structures, &offset);
+                break;
+
+            case fdt::TOKEN_END_NODE:
+                previous = current;
+                current = nodes[current].parent;
+                break;
+
+            case fdt::TOKEN_PROP:
+                err = pre_parse_property(current, structures, strings, &offset);
+                break;
+
+            case fdt::TOKEN_NOP:
+                break;
+
+            case fdt::TOKEN_END:
+                goto dtb_property_rewrite_pass;
+
+            default:
+                __builtin_unreachable();
+        }
+        if (err.is_err()) {
+            return err;
+        }
+    }
+
+dtb_property_rewrite_pass:
+
+    /// We're now ready to properly rewrite the device tree properties. Parents come before their
+    /// children in DFS order, so a linear pass always sees a node's cell counts before its reg.
+    nodes[0].address_cells = 2;
+    nodes[0].size_cells = 1;
+    for (size_t i = 0; i < nodes.m_size; i++) {
+        err = property_rewrite_node(&nodes[i]);
+        if (err.is_err()) {
+            return err.push(ErrorCode::DT_REWRITE_FAILED);
+        }
+    }
+    err = build_indexes();
+    if (err.is_err()) {
+        return err.push(ErrorCode::DT_INDEX_FAILED);
+    }
+    err = resolve_interrupts();
+    if (err.is_err()) {
+        return err.push(ErrorCode::DT_REWRITE_FAILED);
+    }
+
+    initialized = true;
+    return error(ErrorCode::SUCCESS);
+}
+
+void
+release()
+{
+    reserved_regions.clear();
+    // The arrays keep their buffers, a later parse of a similar blob reuses them.
+    nodes.m_size = 0;
+    properties.m_size = 0;
+    node_paths.m_size = 0;
+    interned.clear();
+    phandles.clear();
+    paths.clear();
+    aliases.clear();
+    compatibles.clear();
+    bump.release();
+    string_table = nullptr;
+    string_table_size = 0;
+    string_table_capacity = 0;
+    compatible_nodes = nullptr;
+    blob = nullptr;
+    initialized = false;
+}
+
+error
+parse_from_blob(const u8* dtb)
+{
+    release();
+    error err = parse(dtb);
+    if (err.is_err()) {
+        release();
+    }
+    return err;
+}
+
+/// Header of a cache image written by `save_cache`. All offsets are relative to the start of the
+/// image, which makes the image position independent.
+///
+/// Inside the image, pointers are stored as offsets too. Pointers into the blob (raw values and
+/// strings) are offsets from the start of the blob, everything the rewrite pass allocated is an
+/// offset into the data section. A zero offset is a null pointer; neither the blob header nor the
+/// data section's first byte is ever pointed at.
+struct cache_header
+{
+    u32 magic;
+    u32 version;
+    /// Hash of the image past this field, up to `image_size`.
+    u64 image_checksum;
+    /// Hash of the whole blob the tree was parsed from.
+    u64 blob_checksum;
+    u32 blob_size;
+    u32 image_size;
+    u32 node_count;
+    u32 property_count;
+    u32 nodes_offset;
+    u32 properties_offset;
+    u32 paths_offset;
+    u32 strings_offset;
+    u32 strings_size;
+    /// Number of names in the string table.
+    u32 string_count;
+    u32 data_offset;
+    u32 data_size;
+};
+
+static constexpr u32 CACHE_MAGIC = 0x44544331; // "DTC1"
+static constexpr u32 CACHE_VERSION = 3;
+/// Alignment of every section, enough for the u128 arrays of 3-cell values.
+static constexpr size_t CACHE_ALIGN = alignof(u128);
+
+u64
+blob_checksum(const u8* dtb)
+{
+    const fdt::header* hdr = (const fdt::header*)dtb;
+    return hash_details::hash_bytes(dtb, num::flip_endianness(hdr->total_size));
+}
+
+/// Returns the checksum of the `image_size` bytes long image at `image`.
+u64
+image_checksum(const u8* image, size_t image_size)
+{
+    constexpr size_t CHECKED_FROM = offsetof(cache_header, image_checksum) + sizeof(u64);
+    return hash_details::hash_bytes(image + CHECKED_FROM, image_size - CHECKED_FROM);
+}
+
+/// Appends sections to a cache image. With a null `out` it only measures the image.
+struct cache_writer
+{
+    u8* out;
+    size_t size;
+
+    /// Reserves `length` bytes at the next `alignment` boundary and returns their offset.
+    size_t reserve(size_t length, size_t alignment)
+    {
+        size = align_up(size, alignment);
+        size_t offset = size;
+        size += length;
+        return offset;
+    }
+
+    /// Appends `length` bytes from `src` at the next `alignment` boundary and returns their offset.
+    size_t append(const void* src, size_t length, size_t alignment)
+    {
+        size_t offset = reserve(length, alignment);
+        if (out != nullptr) {
+            mem::copy(src, out + offset, length);
+        }
+        return offset;
+    }
+
+    /// Appends an allocation of the rewrite pass to the data section and returns the encoded
+    /// pointer.
+    template<typename T>
+    T* append_data(const T* ptr, size_t length, size_t alignment, size_t data_offset)
+    {
+        if (ptr == nullptr || length == 0) {
+            return nullptr;
+        }
+        return (T*)(append(ptr, length, alignment) - data_offset);
+    }
+};
+
+template<typename T>
+T*
+encode_blob_pointer(T* ptr)
+{
+    return (ptr == nullptr) ? nullptr : (T*)((const u8*)ptr - blob);
+}
+
+str_view
+encode_blob_string(str_view str)
+{
+    return str_view(encode_blob_pointer(str.data()), str.length());
+}
+
+/// Returns a copy of `prop`, a property of `node`, with its pointers encoded for the image. The
+/// arrays it owns are appended to the data section on the way.
+struct property
+encode_property(struct cache_writer* writer,
+                const struct node* node,
+                struct property prop,
+                size_t data_offset)
+{
+    switch (prop.type) {
+        case property::type::RAW:
+            prop.data.raw =
+              byte_view(encode_blob_pointer(prop.data.raw.data()), prop.data.raw.length());
+            break;
+        case property::type::COMPATIBLE:
+        {
+            // The strings point into the blob, so they are encoded one by one.
+            size_t n = 0;
+            while (prop.data.compatible_array[n].length() != 0) n++;
+            size_t offset = writer->reserve(sizeof(str_view) * (n + 1), alignof(str_view));
+            if (writer->out != nullptr) {
+                str_view* encoded = (str_view*)(writer->out + offset);
+                for (size_t i = 0; i <= n; i++) {
+                    encoded[i] = encode_blob_string(prop.data.compatible_array[i]);
+                }
+            }
+            prop.data.compatible_array = (str_view*)(offset - data_offset);
+            break;
+        }
+        case property::type::MODEL:
+            prop.data.model = encode_blob_string(prop.data.model);
+            break;
+        case property::type::STATUS:
+            prop.data.status.reason = encode_blob_string(prop.data.status.reason);
+            break;
+        case property::type::DEVICE_TYPE:
+            prop.data.device_type = encode_blob_string(prop.data.device_type);
+            break;
+        case property::type::REG:
+        {
+            const struct node* parent = &nodes[node->parent];
+            size_t n = prop.data.reg.n_pairs;
+            size_t address_storage = cell_storage_size(parent->address_cells);
+            size_t size_storage = cell_storage_size(parent->size_cells);
+            prop.data.reg.address_array = writer->append_data(
+              prop.data.reg.address_array, n * address_storage, address_storage, data_offset);
+            prop.data.reg.size_array = writer->append_data(
+              prop.data.reg.size_array, n * size_storage, size_storage, data_offset);
+            break;
+        }
+        case property::type::RANGES:
+        {
+            const struct node* parent = &nodes[node->parent];
+            size_t n = prop.data.range.n_trips;
+            size_t cbus_storage = cell_storage_size(node->address_cells);
+            size_t pbus_storage = cell_storage_size(parent->address_cells);
+            size_t size_storage = cell_storage_size(node->size_cells);
+            prop.data.range.cbus_address_array = writer->append_data(
+              prop.data.range.cbus_address_array, n * cbus_storage, cbus_storage, data_offset);
+            prop.data.range.pbus_address_array = writer->append_data(
+              prop.data.range.pbus_address_array, n * pbus_storage, pbus_storage, data_offset);
+            prop.data.range.size_array = writer->append_data(
+              prop.data.range.size_array, n * size_storage, size_storage, data_offset);
+            break;
+        }
+        case property::type::INTERRUPTS:
+            prop.data.interrupts.cells =
+              writer->append_data(prop.data.interrupts.cells,
+                                  sizeof(u32) * prop.data.interrupts.n_cells,
+                                  alignof(u32),
+                                  data_offset);
+            prop.data.interrupts.routes =
+              writer->append_data(prop.data.interrupts.routes,
+                                  sizeof(struct resolved_interrupt) * prop.data.interrupts.n_routes,
+                                  alignof(struct resolved_interrupt),
+                                  data_offset);
+            break;
+        case property::type::INTERRUPT_MAP:
+            prop.data.interrupt_map.entries = writer->append_data(
+              prop.data.interrupt_map.entries,
+              sizeof(struct interrupt_map_entry) * prop.data.interrupt_map.n_entries,
+              alignof(struct interrupt_map_entry),
+              data_offset);
+            break;
+        case property::type::INTERRUPT_MAP_MASK:
+            prop.data.interrupt_map_mask.cells =
+              writer->append_data(prop.data.interrupt_map_mask.cells,
+                                  sizeof(u32) * prop.data.interrupt_map_mask.n_cells,
+                                  alignof(u32),
+                                  data_offset);
+            break;
+        default:
+            // Everything else is plain values.
+            break;
+    }
+    return prop;
+}
+
+/// Turns the encoded pointer `*ptr` to `count` elements of `size` bytes back into a real pointer
+/// into the `base_size` bytes at `base`. Fails unless they all lie within it, aligned to
+/// `alignment`. Only an array of zero bytes (e.g. the sizes of a `reg` with #size-cells 0) may be
+/// null.
+template<typename T>
+bool
+decode_array(T** ptr, size_t count, size_t size, size_t alignment, u8* base, size_t base_size)
+{
+    uintptr_t offset = (uintptr_t)*ptr;
+    if (offset == 0 || size == 0) {
+        // Arrays of zero bytes are always saved as null.
+        return offset == 0 && (count == 0 || size == 0);
+    }
+    if (count > base_size / size || offset > base_size - count * size ||
+        !is_aligned(offset, alignment)) {
+        return false;
+    }
+    *ptr = (T*)(base + offset);
+    return true;
+}
+
+/// Turns an encoded string back into a real one, checking that it lies within `base`.
+bool
+decode_string(str_view* str, const u8* base, size_t base_size)
+{
+    const char* chars = str->data();
+    if (!decode_array(&chars, str->length(), 1, 1, (u8*)base, base_size)) {
+        return false;
+    }
+    *str = str_view(chars, str->length());
+    return true;
+}
+
+/// Checks that the byte at `value` holds a valid bool, which an image from storage may not.
+bool
+is_bool(const bool* value)
+{
+    u8 byte;
+    mem::copy(value, &byte, sizeof(byte));
+    return byte <= 1;
+}
+
+/// Turns the encoded pointers of a property of `node` loaded from an image back into real ones.
+/// Every pointer must lie within the blob or the data section, every node index within `nodes`.
+error
+decode_property(struct property* prop,
+                const struct node* node,
+                const u8* dtb,
+                size_t dtb_size,
+                u8* data,
+                size_t data_size)
+{
+    auto in_data = [&](auto** ptr, size_t count, size_t size, size_t alignment) {
+        return decode_array(ptr, count, size, alignment, data, data_size);
+    };
+    bool valid = true;
+    switch (prop->type) {
+        case property::type::RAW:
+        {
+            const u8* raw = prop->data.raw.data();
+            valid = decode_array(&raw, prop->data.raw.length(), 1, 1, (u8*)dtb, dtb_size);
+            prop->data.raw = byte_view(raw, prop->data.raw.length());
+            break;
+        }
+        case property::type::COMPATIBLE:
+        {
+            // The array has no length, it ends at the first empty string within the data section.
+            uintptr_t offset = (uintptr_t)prop->data.compatible_array;
+            if (offset == 0 || offset >= data_size || !is_aligned(offset, alignof(str_view))) {
+                return ErrorCode::DT_CACHE_INVALID;
+            }
+            size_t max_entries = (data_size - offset) / sizeof(str_view);
+            prop->data.compatible_array = (str_view*)(data + offset);
+            for (size_t i = 0;; i++) {
+                if (i == max_entries) {
+                    return ErrorCode::DT_CACHE_INVALID;
+                }
+                str_view* c = &prop->data.compatible_array[i];
+                if (c->length() == 0) {
+                    break;
+                }
+                if (!decode_string(c, dtb, dtb_size)) {
+                    return ErrorCode::DT_CACHE_INVALID;
+                }
+            }
+            break;
+        }
+        case property::type::MODEL:
+            valid = decode_string(&prop->data.model, dtb, dtb_size);
+            break;
+        case property::type::STATUS:
+            valid = prop->data.status.value <= property::device_status::FAIL_WITH_REASON &&
+                    decode_string(&prop->data.status.reason, dtb, dtb_size);
+            break;
+        case property::type::DEVICE_TYPE:
+            valid = decode_string(&prop->data.device_type, dtb, dtb_size);
+            break;
+        case property::type::DMA_COHERENCE:
+            valid = is_bool(&prop->data.dma_coherence);
+            break;
+        case property::type::REG:
+        {
+            if (node->parent == NO_NODE) {
+                return ErrorCode::DT_CACHE_INVALID;
+            }
+            const struct node* parent = &nodes[node->parent];
+            size_t n = prop->data.reg.n_pairs;
+            size_t address_storage = cell_storage_size(parent->address_cells);
+            size_t size_storage = cell_storage_size(parent->size_cells);
+            valid =
+              in_data(&prop->data.reg.address_array, n, address_storage, address_storage) &&
+              in_data(&prop->data.reg.size_array, n, size_storage, size_storage);
+            break;
+        }
+        case property::type::RANGES:
+        {
+            if (node->parent == NO_NODE) {
+                return ErrorCode::DT_CACHE_INVALID;
+            }
+            const struct node* parent = &nodes[node->parent];
+            size_t n = prop->data.range.n_trips;
+            size_t cbus_storage = cell_storage_size(node->address_cells);
+            size_t pbus_storage = cell_storage_size(parent->address_cells);
+            size_t size_storage = cell_storage_size(node->size_cells);
+            valid =
+              in_data(&prop->data.range.cbus_address_array, n, cbus_storage, cbus_storage) &&
+              in_data(&prop->data.range.pbus_address_array, n, pbus_storage, pbus_storage) &&
+              in_data(&prop->data.range.size_array, n, size_storage, size_storage);
+            break;
+        }
+        case property::type::INTERRUPTS:
+        {
+            auto* interrupts = &prop->data.interrupts;
+            valid = is_bool(&interrupts->extended) &&
+                    in_data(&interrupts->cells, interrupts->n_cells, sizeof(u32), alignof(u32)) &&
+                    in_data(&interrupts->routes,
+                            interrupts->n_routes,
+                            sizeof(struct resolved_interrupt),
+                            alignof(struct resolved_interrupt));
+            for (size_t i = 0; valid && i < interrupts->n_routes; i++) {
+                u32 controller = interrupts->routes[i].controller;
+                valid = controller == NO_NODE || controller < nodes.m_size;
+            }
+            break;
+        }
+        case property::type::INTERRUPT_MAP:
+        {
+            auto* map = &prop->data.interrupt_map;
+            valid = in_data(&map->entries,
+                            map->n_entries,
+                            sizeof(struct interrupt_map_entry),
+                            alignof(struct interrupt_map_entry));
+            for (size_t i = 0; valid && i < map->n_entries; i++) {
+                valid = map->entries[i].parent < nodes.m_size &&
+                        map->entries[i].parent_interrupt_cells <= MAX_INTERRUPT_CELLS;
+            }
+            break;
+        }
+        case property::type::INTERRUPT_MAP_MASK:
+            valid = in_data(&prop->data.interrupt_map_mask.cells,
+                            prop->data.interrupt_map_mask.n_cells,
+                            sizeof(u32),
+                            alignof(u32));
+            break;
+        default:
+            // Everything else is plain values.
+            valid = prop->type <= property::type::INTERRUPT_MAP_MASK;
+            break;
+    }
+    return valid ? ErrorCode::SUCCESS : ErrorCode::DT_CACHE_INVALID;
+}
+
+/// Checks the links of node `i` loaded from an image, which traversals follow without further
+/// checks: the parent comes before the node and the first child and next sibling after it, so no
+/// walk can loop, and the properties follow on from those of the previous node.
+bool
+check_cached_node(u32 i, u32 first_property)
+{
+    const struct node* node = &nodes[i];
+    u32 n_nodes = static_cast<u32>(nodes.m_size);
+    bool parent_valid = (i == 0) ? node->parent == NO_NODE : node->parent < i;
+    bool first_child_valid =
+      node->first_child == NO_NODE || (node->first_child > i && node->first_child < n_nodes);
+    bool next_sibling_valid =
+      node->next_sibling == NO_NODE || (node->next_sibling > i && node->next_sibling < n_nodes);
+    return parent_valid && first_child_valid && next_sibling_valid &&
+           node->name < string_table_size && node->address_cells <= 3 && node->size_cells <= 2 &&
+           node->first_property == first_property &&
+           node->property_count <= properties.m_size - first_property;
+}
+
+/// Writes the cache image into `writer`.
+void
+write_cache(struct cache_writer* writer)
+{
+    struct cache_header hdr = {};
+    writer->append(&hdr, sizeof(hdr), CACHE_ALIGN);
+
+    hdr.magic = CACHE_MAGIC;
+    hdr.version = CACHE_VERSION;
+    hdr.blob_checksum = blob_checksum(blob);
+    hdr.blob_size = num::flip_endianness(((const fdt::header*)blob)->total_size);
+    hdr.node_count = static_cast<u32>(nodes.m_size);
+    hdr.property_count = static_cast<u32>(properties.m_size);
+
+    // Nodes only hold indices and string table offsets, they go in as they are.
+    hdr.nodes_offset =
+      writer->append(nodes.m_buffer, sizeof(struct node) * nodes.m_size, CACHE_ALIGN);
+    hdr.strings_offset = writer->append(string_table, string_table_size, CACHE_ALIGN);
+    hdr.strings_size = static_cast<u32>(string_table_size);
+    hdr.string_count = static_cast<u32>(interned.size());
+
+    // Reserve the property and path arrays, then fill them in once the data section they point
+    // into is laid out behind them.
+    hdr.properties_offset =
+      writer->reserve(sizeof(struct property) * properties.m_size, CACHE_ALIGN);
+    hdr.paths_offset = writer->reserve(sizeof(str_view) * nodes.m_size, CACHE_ALIGN);
+    // Keep offset zero of the data section free, it encodes a null pointer.
+    hdr.data_offset = writer->reserve(CACHE_ALIGN, CACHE_ALIGN);
+
+    for (size_t i = 0; i < nodes.m_size; i++) {
+        const struct node* node = &nodes[i];
+        for (u32 j = node->first_property; j < node->first_property + node->property_count; j++) {
+            struct property prop = encode_property(writer, node, properties[j], hdr.data_offset);
+            if (writer->out != nullptr) {
+                ((struct property*)(writer->out + hdr.properties_offset))[j] = prop;
+            }
+        }
+
+        str_view path = node_paths[i];
+        char* encoded = writer->append_data(path.data(), path.length(), 1, hdr.data_offset);
+        if (writer->out != nullptr) {
+            ((str_view*)(writer->out + hdr.paths_offset))[i] = str_view(encoded, path.length());
+        }
+    }
+
+    hdr.data_size = writer->size - hdr.data_offset;
+    hdr.image_size = writer->size;
+    if (writer->out != nullptr) {
+        mem::copy(&hdr, writer->out, sizeof(hdr));
+        hdr.image_checksum = image_checksum(writer->out, hdr.image_size);
+        mem::copy(&hdr, writer->out, sizeof(hdr));
+    }
+}
+
+size_t
+cache_size()
+{
+    struct cache_writer writer = { nullptr, 0 };
+    write_cache(&writer);
+    return writer.size;
+}
+
+error
+save_cache(u8* buffer, size_t capacity)
+{
+    if (!initialized) {
+        return ErrorCode::DT_CACHE_INVALID;
+    }
+    if (capacity < cache_size()) {
+        return ErrorCode::DT_CACHE_BUFFER_TOO_SMALL;
+    }
+
+    struct cache_writer writer = { buffer, 0 };
+    write_cache(&writer);
+    return ErrorCode::SUCCESS;
+}
+
+/// Checks that a section of `length` bytes at `offset` lies within an image of `image_size` bytes.
+bool
+section_fits(u64 offset, u64 length, u32 image_size)
+{
+    return is_aligned(offset, CACHE_ALIGN) && offset + length <= image_size;
+}
+
+/// Loads the image into the module state, which is left half built on failure.
+error
+load(const u8* image, size_t size, const u8* dtb)
+{
+    const struct cache_header* hdr = (const struct cache_header*)image;
+    if (size < sizeof(*hdr) || hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+        hdr->image_size < sizeof(*hdr) || hdr->image_size > size ||
+        image_checksum(image, hdr->image_size) != hdr->image_checksum) {
+        return ErrorCode::DT_CACHE_INVALID;
+    }
+    error err = fdt::validate_header(dtb);
+    if (err.is_err()) {
+        return err;
+    }
+    size_t dtb_size = num::flip_endianness(((const fdt::header*)dtb)->total_size);
+    if (dtb_size != hdr->blob_size || blob_checksum(dtb) != hdr->blob_checksum) {
+        return ErrorCode::DT_CACHE_STALE;
+    }
+
+    // The checksum only catches corruption, the image is still checked as if it were hostile: in
+    // 64 bits, so that no offset + length can wrap.
+    if (hdr->node_count == 0 || hdr->string_count > hdr->strings_size ||
+        !section_fits(hdr->nodes_offset, u64(sizeof(struct node)) * hdr->node_count,
+                      hdr->image_size) ||
+        !section_fits(hdr->properties_offset,
+                      u64(sizeof(struct property)) * hdr->property_count,
+                      hdr->image_size) ||
+        !section_fits(hdr->paths_offset, u64(sizeof(str_view)) * hdr->node_count,
+                      hdr->image_size) ||
+        !section_fits(hdr->strings_offset, hdr->strings_size, hdr->image_size) ||
+        !section_fits(hdr->data_offset, hdr->data_size, hdr->image_size) ||
+        (hdr->strings_size != 0 && image[hdr->strings_offset + hdr->strings_size - 1] != '\0')) {
+        return ErrorCode::DT_CACHE_INVALID;
+    }
+
+    err = nodes.grow_to_min_cap(hdr->node_count);
+    if (err.is_ok()) {
+        err = properties.grow_to_min_cap(hdr->property_count);
+    }
+    if (err.is_ok()) {
+        err = node_paths.grow_to_min_cap(hdr->node_count);
+    }
+    if (err.is_ok()) {
+        err = interned.reserve(hdr->string_count);
+    }
+    if (err.is_err()) {
+        return err;
+    }
+
+    blob = dtb;
+    parse_reserved_regions(dtb);
+
+    // Copy the dense arrays and the data section into memory of our own, then check and patch the
+    // pointers in one pass. There is no parsing and no decoding of property values left to do.
+    mem::copy(image + hdr->nodes_offset, nodes.m_buffer, sizeof(struct node) * hdr->node_count);
+    nodes.m_size = hdr->node_count;
+    mem::copy(image + hdr->properties_offset,
+              properties.m_buffer,
+              sizeof(struct property) * hdr->property_count);
+    properties.m_size = hdr->property_count;
+    mem::copy(image + hdr->paths_offset, node_paths.m_buffer, sizeof(str_view) * hdr->node_count);
+    node_paths.m_size = hdr->node_count;
+
+    string_table_capacity = hdr->strings_size;
+    string_table_size = hdr->strings_size;
+    string_table = (char*)bump.alloc(string_table_capacity);
+    u8* data = (u8*)bump.alloc_aligned(hdr->data_size, CACHE_ALIGN);
+    if ((string_table_size != 0 && string_table == nullptr) ||
+        (hdr->data_size != 0 && data == nullptr)) {
+        return ErrorCode::PMM_OUT_OF_MEM;
+    }
+    mem::copy(image + hdr->strings_offset, string_table, string_table_size);
+    mem::copy(image + hdr->data_offset, data, hdr->data_size);
+
+    for (size_t offset = 0; offset < string_table_size;) {
+        str_view name = name_of(static_cast<u32>(offset));
+        if ((err = interned.insert(name, static_cast<u32>(offset))).is_err()) {
+            return err;
+        }
+        offset += name.length() + 1;
+    }
+    u32 first_property = 0;
+    for (u32 i = 0; i < nodes.m_size; i++) {
+        const struct node* node = &nodes[i];
+        if (!check_cached_node(i, first_property)) {
+            return ErrorCode::DT_CACHE_INVALID;
+        }
+        first_property += node->property_count;
+        for (struct property* prop = properties_begin(node); prop != properties_end(node);
+             prop++) {
+            if (prop->name >= string_table_size) {
+                return ErrorCode::DT_CACHE_INVALID;
+            }
+            err = decode_property(prop, node, dtb, dtb_size, data, hdr->data_size);
+            if (err.is_err()) {
+                return err;
+            }
+        }
+        if (!decode_string(&node_paths[i], data, hdr->data_size)) {
+            return ErrorCode::DT_CACHE_INVALID;
+        }
+    }
+    if (first_property != properties.m_size) {
+        return ErrorCode::DT_CACHE_INVALID;
+    }
+
+    err = build_indexes();
+    if (err.is_err()) {
+        return err.push(ErrorCode::DT_INDEX_FAILED);
+    }
+    initialized = true;
+    return ErrorCode::SUCCESS;
+}
+
+error
+load_from_cache(const u8* image, size_t size, const u8* dtb)
+{
+    release();
+    error err = load(image, size, dtb);
+    if (err.is_err()) {
+        release();
+    }
+    return err;
+}
+
+const struct node*
+node_list::operator[](size_t i) const
+{
+    return &nodes[indices[i]];
+}
+
+const struct node*
+find_by_phandle(u32 phandle)
+{
+    u32* node = phandles.find(phandle);
+    return (node != nullptr) ? &nodes[*node] : nullptr;
+}
+
+const struct node*
+find_by_path(str_view path)
+{
+    u32 node = lookup_path(path);
+    return (node != NO_NODE) ? &nodes[node] : nullptr;
+}
+
+node_list
+find_compatible(str_view compatible)
+{
+    const compatible_range* range = compatibles.find(compatible);
+    if (range == nullptr) {
+        return { nullptr, 0 };
+    }
+    return { compatible_nodes + range->first, range->count };
+}
+
+str_view
+node_name(const struct node* node)
+{
+    return name_of(node->name);
+}
+
+str_view
+node_path(const struct node* node)
+{
+    return node_paths[node - &nodes[0]];
+}
+
+size_t
+interrupt_count(const struct node* node)
+{
+    struct property* prop = find_property(node, property::type::INTERRUPTS);
+    return (prop != nullptr) ? prop->data.interrupts.n_routes : 0;
+}
+
+bool
+interrupt(const struct node* node, size_t index, interrupt_route* route)
+{
+    struct property* prop = find_property(node, property::type::INTERRUPTS);
+    if (prop == nullptr || index >= prop->data.interrupts.n_routes) {
+        return false;
+    }
+    const struct resolved_interrupt* resolved = &prop->data.interrupts.routes[index];
+    if (resolved->controller == NO_NODE) {
+        return false;
+    }
+    *route = { &nodes[resolved->controller], resolved->hwirq, resolved->flags };
+    return true;
+}
+
+bool
+map_interrupt(const struct node* parent,
+              u128 address,
+              const u32* specifier,
+              size_t n_cells,
+              interrupt_route* route)
+{
+    u32 domain = static_cast<u32>(parent - &nodes[0]);
+    if (n_cells > MAX_INTERRUPT_CELLS) {
+        return false;
+    }
+    struct resolved_interrupt resolved =
+      route_interrupt(domain, address, specifier, static_cast<u32>(n_cells));
+    if (resolved.controller == NO_NODE) {
+        return false;
+    }
+    *route = { &nodes[resolved.controller], resolved.hwirq, resolved.flags };
+    return true;
+}
+
+void
+print_node_recursive(u32 index, int depth)
+{
+    if (index == NO_NODE) {
+        return;
+    }
+
+    struct node* node = &nodes[index];
+    for (int i = 0; i < depth; i++) {
+        fmt::print("  ");
+    }
+    fmt::println("Node: ", name_of(node->name), " {");
+    for (struct property* prop = properties_begin(node); prop != properties_end(node); prop++) {
+        for (int i = 0; i < depth + 1; i++) {
+            fmt::print("  ");
+        }
+        fmt::print("Property: ", name_of(prop->name), " = ");
         switch (prop->type) {
             case property::type::RAW:
                 fmt::println("RAW (length: ", prop->data.raw.length(), ")");
@@ -644,13 +2165,32 @@ print_node_recursive(struct node* node, int depth)
             case property::type::INTERRUPT_CELLS:
                 fmt::println(prop->data.interrupt_cells);
                 break;
+            case property::type::INTERRUPTS:
+                fmt::print("[");
+                for (size_t i = 0; i < prop->data.interrupts.n_routes; i++) {
+                    const struct resolved_interrupt* route = &prop->data.interrupts.routes[i];
+                    if (i != 0) {
+                        fmt::print(", ");
+                    }
+                    if (route->controller == NO_NODE) {
+                        fmt::print("unresolved");
+                    } else {
+                        fmt::print(name_of(nodes[route->controller].name), ":", route->hwirq);
+                    }
+                }
+                fmt::println("]");
+                break;
             case property::type::INTERRUPT_MAP:
-                fmt::println("INTERRUPT_MAP (", prop->data.n_entries, " entries)");
+                fmt::println("INTERRUPT_MAP (", prop->data.interrupt_map.n_entries, " entries)");
+                break;
+            case property::type::INTERRUPT_MAP_MASK:
+                fmt::println(
+                  "INTERRUPT_MAP_MASK (", prop->data.interrupt_map_mask.n_cells, " cells)");
                 break;
         }
     }
 
-    for (struct node* child = node->children; child != nullptr; child = child->next_sibling) {
+    for (u32 child = node->first_child; child != NO_NODE; child = nodes[child].next_sibling) {
         print_node_recursive(child, depth + 1);
     }
 }
@@ -665,6 +2205,6 @@ print_device_tree()
     }
 
     fmt::println("Printing the device tree:");
-    print_node_recursive(root, 0);
+    print_node_recursive(0, 0);
 }
 }
\ No newline at end of file
@@ -0,0 +1,516 @@
+#include <devices/fdt.h>
+#include <fmt/assert.h>
+#include <memory.h>
+#include <types/byte_view.h>
+#include <types/error.h>
+#include <types/number.h>
+#include <types/str_view.h>
+
+namespace fdt {
+
+str_view
+property::as_string() const
+{
+    str_view value = str_view::from_byte_view(m_value);
+    if (value.length() != 0 && value[value.length() - 1] == '\0') {
+        value = value.substr(0, value.length() - 1);
+    }
+    return value;
+}
+
+bool
+property::contains_string(str_view str) const
+{
+    bool found = false;
+    for_each_string([&](str_view candidate) {
+        found = found || str_view::compare(candidate, str) == 0;
+    });
+    return found;
+}
+
+str_view
+node::name() const
+{
+    return str_view::from_null_term(
+      reinterpret_cast<const char*>(m_blob->m_structs + m_offset + sizeof(u32)));
+}
+
+u32
+node::properties_begin() const
+{
+    return m_blob->skip_nops(m_blob->skip_name(m_offset + sizeof(u32)));
+}
+
+property
+node::property_at(u32* offset) const
+{
+    // PROP token, value length, name offset, then the value itself.
+    const u8* prop = m_blob->m_structs + *offset;
+    u32 length = num::read_big_endian<u32, CELL_ALIGN>(prop + sizeof(u32));
+    u32 name_offset = num::read_big_endian<u32, CELL_ALIGN>(prop + 2 * sizeof(u32));
+    const u8* value = prop + 3 * sizeof(u32);
+    *offset += 3 * sizeof(u32) + align_up(length, CELL_ALIGN);
+
+    str_view name =
+      str_view::from_null_term(reinterpret_cast<const char*>(m_blob->m_strings + name_offset));
+    return property(name, byte_view(value, length));
+}
+
+property
+node::find_property(str_view name) const
+{
+    u32 offset = properties_begin();
+    while (m_blob->token(offset) == TOKEN_PROP) {
+        property prop = property_at(&offset);
+        if (str_view::compare(prop.name(), name) == 0) {
+            return prop;
+        }
+        offset = m_blob->skip_nops(offset);
+    }
+    return property();
+}
+
+node
+node::first_child() const
+{
+    u32 offset = m_blob->skip_properties(properties_begin());
+    if (m_blob->token(offset) != TOKEN_BEGIN_NODE) {
+        return node();
+    }
+    return node(m_blob, offset, address_cells(), size_cells());
+}
+
+node
+node::next_sibling() const
+{
+    u32 offset = m_blob->skip_nops(m_blob->skip_node(m_offset));
+    if (m_blob->token(offset) != TOKEN_BEGIN_NODE) {
+        return node();
+    }
+    return node(m_blob, offset, m_parent_address_cells, m_parent_size_cells);
+}
+
+node
+node::find_child(str_view name) const
+{
+    bool match_unit_address = name.find('@') != str_view::s_sentinel;
+    node found;
+    for_each_child([&](node child) {
+        if (found) {
+            return;
+        }
+        str_view child_name = child.name();
+        if (!match_unit_address) {
+            child_name = child_name.substr(0, child_name.find('@'));
+        }
+        if (str_view::compare(child_name, name) == 0) {
+            found = child;
+        }
+    });
+    return found;
+}
+
+u32
+node::address_cells() const
+{
+    property prop = find_property("#address-cells");
+    return (prop.value().length() >= sizeof(u32)) ? prop.as_u32() : DEFAULT_ADDRESS_CELLS;
+}
+
+u32
+node::size_cells() const
+{
+    property prop = find_property("#size-cells");
+    return (prop.value().length() >= sizeof(u32)) ? prop.as_u32() : DEFAULT_SIZE_CELLS;
+}
+
+bool
+node::is_compatible(str_view compatible) const
+{
+    property prop = find_property("compatible");
+    return prop && prop.contains_string(compatible);
+}
+
+bool
+node::is_enabled() const
+{
+    property prop = find_property("status");
+    if (!prop) {
+        return true;
+    }
+    str_view status = prop.as_string();
+    return str_view::compare(status, "okay") == 0 || str_view::compare(status, "ok") == 0;
+}
+
+namespace {
+/// Returns the size in bytes of a `reg` or `ranges` entry made of fields of `a`, `b` and `c` cells,
+/// or 0 if a field is wider than `read_cells` decodes, which only a malformed blob has.
+size_t
+entry_stride(u32 a, u32 b, u32 c = 0)
+{
+    constexpr u32 MAX_CELLS = 4;
+    if (a > MAX_CELLS || b > MAX_CELLS || c > MAX_CELLS) {
+        return 0;
+    }
+    return (a + b + c) * sizeof(u32);
+}
+} // namespace
+
+size_t
+node::reg_count() const
+{
+    property prop = find_property("reg");
+    size_t stride = entry_stride(m_parent_address_cells, m_parent_size_cells);
+    return (prop && stride != 0) ? prop.value().length() / stride : 0;
+}
+
+bool
+node::reg(size_t index, reg_entry* entry) const
+{
+    property prop = find_property("reg");
+    size_t stride = entry_stride(m_parent_address_cells, m_parent_size_cells);
+    if (!prop || stride == 0 || (index + 1) * stride > prop.value().length()) {
+        return false;
+    }
+
+    const u8* data = prop.value().data() + index * stride;
+    entry->address = read_cells(data, m_parent_address_cells);
+    data += m_parent_address_cells * sizeof(u32);
+    entry->size = static_cast<u64>(read_cells(data, m_parent_size_cells));
+    return true;
+}
+
+size_t
+node::range_count() const
+{
+    property prop = find_property("ranges");
+    size_t stride = entry_stride(address_cells(), m_parent_address_cells, size_cells());
+    return (prop && stride != 0) ? prop.value().length() / stride : 0;
+}
+
+bool
+node::range(size_t index, range_entry* entry) const
+{
+    property prop = find_property("ranges");
+    u32 child_address_cells = address_cells();
+    u32 size_cells = this->size_cells();
+    size_t stride = entry_stride(child_address_cells, m_parent_address_cells, size_cells);
+    if (!prop || stride == 0 || (index + 1) * stride > prop.value().length()) {
+        return false;
+    }
+
+    const u8* data = prop.value().data() + index * stride;
+    entry->child_address = read_cells(data, child_address_cells);
+    data += child_address_cells * sizeof(u32);
+    entry->parent_address = read_cells(data, m_parent_address_cells);
+    data += m_parent_address_cells * sizeof(u32);
+    entry->size = static_cast<u64>(read_cells(data, size_cells));
+    return true;
+}
+
+error
+validate_header(const u8* dtb)
+{
+    if (dtb == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+
+    const header* hdr = reinterpret_cast<const header*>(dtb);
+    if (MAGIC != num::flip_endianness(hdr->magic)) {
+        return ErrorCode::DT_MAGIC_NUMBER;
+    }
+    if (num::flip_endianness(hdr->version) < MIN_VERSION) {
+        return ErrorCode::DT_UNSUPPORTED_VERSION;
+    }
+
+    // In 64 bits, so that offset + size can't wrap.
+    u64 total_size = num::flip_endianness(hdr->total_size);
+    u64 structs_end =
+      u64(num::flip_endianness(hdr->offset_structs)) + num::flip_endianness(hdr->size_structs);
+    u64 strings_end =
+      u64(num::flip_endianness(hdr->offset_strings)) + num::flip_endianness(hdr->size_strings);
+    if (structs_end > total_size || strings_end > total_size ||
+        num::flip_endianness(hdr->offset_rsvmap) > total_size) {
+        return ErrorCode::DT_MALFORMED;
+    }
+    // Tokens and cells are read as aligned words, and the reservation entries as aligned u64s.
+    if (!is_aligned(num::flip_endianness(hdr->offset_structs), CELL_ALIGN) ||
+        !is_aligned(num::flip_endianness(hdr->size_structs), CELL_ALIGN) ||
+        !is_aligned(num::flip_endianness(hdr->offset_rsvmap), sizeof(u64))) {
+        return ErrorCode::DT_MALFORMED;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+namespace {
+/// Returns the length of the null terminated string at `offset` in `block`, or s_sentinel if it
+/// runs past the end of the block.
+size_t
+bounded_strlen(byte_view block, size_t offset)
+{
+    size_t end = block.find(0, offset);
+    return (end == byte_view::s_sentinel) ? end : end - offset;
+}
+} // namespace
+
+error
+validate_structures(byte_view structures, byte_view strings, size_t* n_nodes, size_t* n_properties)
+{
+    size_t nodes = 0;
+    size_t properties = 0;
+    size_t depth = 0;
+    // Set when a child node ends, the current node can't have properties after its children.
+    bool properties_done = false;
+    for (size_t offset = 0;;) {
+        if (offset + sizeof(u32) > structures.length()) {
+            return ErrorCode::DT_MALFORMED;
+        }
+        u32 token = num::read_big_endian<u32, CELL_ALIGN>(structures.data() + offset);
+        offset += sizeof(u32);
+        switch (token) {
+            case TOKEN_BEGIN_NODE:
+            {
+                size_t name_length = bounded_strlen(structures, offset);
+                if ((depth == 0 && nodes != 0) || depth == MAX_DEPTH ||
+                    name_length == byte_view::s_sentinel) {
+                    return ErrorCode::DT_MALFORMED;
+                }
+                offset += align_up(name_length + 1, CELL_ALIGN);
+                depth++;
+                properties_done = false;
+                nodes++;
+                break;
+            }
+            case TOKEN_PROP:
+            {
+                if (depth == 0 || properties_done ||
+                    offset + 2 * sizeof(u32) > structures.length()) {
+                    return ErrorCode::DT_MALFORMED;
+                }
+                u32 length = num::read_big_endian<u32, CELL_ALIGN>(structures.data() + offset);
+                u32 name_offset =
+                  num::read_big_endian<u32, CELL_ALIGN>(structures.data() + offset + sizeof(u32));
+                offset += 2 * sizeof(u32);
+                if (length > structures.length() - offset ||
+                    bounded_strlen(strings, name_offset) == byte_view::s_sentinel) {
+                    return ErrorCode::DT_MALFORMED;
+                }
+                offset += align_up(length, CELL_ALIGN);
+                properties++;
+                break;
+            }
+            case TOKEN_END_NODE:
+                if (depth == 0) {
+                    return ErrorCode::DT_MALFORMED;
+                }
+                depth--;
+                properties_done = true;
+                break;
+            case TOKEN_NOP:
+                break;
+            case TOKEN_END:
+                if (depth != 0) {
+                    return ErrorCode::DT_MALFORMED;
+                }
+                if (nodes == 0) {
+                    return ErrorCode::DT_NO_NODES;
+                }
+                if (n_nodes != nullptr) {
+                    *n_nodes = nodes;
+                }
+                if (n_properties != nullptr) {
+                    *n_properties = properties;
+                }
+                return ErrorCode::SUCCESS;
+            default:
+                return ErrorCode::DT_MALFORMED;
+        }
+    }
+}
+
+error
+blob::open(const u8* dtb, blob* out)
+{
+    if (out == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    error err = validate_header(dtb);
+    if (err.is_err()) {
+        return err;
+    }
+
+    const header* hdr = reinterpret_cast<const header*>(dtb);
+    const u8* structs = dtb + num::flip_endianness(hdr->offset_structs);
+    const u8* strings = dtb + num::flip_endianness(hdr->offset_strings);
+    err = validate_structures(byte_view(structs, num::flip_endianness(hdr->size_structs)),
+                              byte_view(strings, num::flip_endianness(hdr->size_strings)));
+    if (err.is_err()) {
+        return err;
+    }
+
+    out->m_structs = structs;
+    out->m_strings = strings;
+    out->m_rsvmap = dtb + num::flip_endianness(hdr->offset_rsvmap);
+    out->m_end = dtb + num::flip_endianness(hdr->total_size);
+    return ErrorCode::SUCCESS;
+}
+
+u32
+blob::skip_name(u32 offset) const
+{
+    size_t length = mem::strlen(reinterpret_cast<const char*>(m_structs + offset));
+    return offset + align_up(length + 1, CELL_ALIGN);
+}
+
+u32
+blob::skip_nops(u32 offset) const
+{
+    while (token(offset) == TOKEN_NOP) offset += sizeof(u32);
+    return offset;
+}
+
+u32
+blob::skip_properties(u32 offset) const
+{
+    while (true) {
+        u32 tok = token(offset);
+        if (tok == TOKEN_NOP) {
+            offset += sizeof(u32);
+        } else if (tok == TOKEN_PROP) {
+            u32 length = num::read_big_endian<u32, CELL_ALIGN>(m_structs + offset + sizeof(u32));
+            offset += 3 * sizeof(u32) + align_up(length, CELL_ALIGN);
+        } else {
+            return offset;
+        }
+    }
+}
+
+u32
+blob::skip_node(u32 offset) const
+{
+    assert(token(offset) == TOKEN_BEGIN_NODE);
+    size_t depth = 0;
+    while (true) {
+        offset = skip_properties(offset);
+        switch (token(offset)) {
+            case TOKEN_BEGIN_NODE:
+                depth++;
+                offset = skip_name(offset + sizeof(u32));
+                break;
+            case TOKEN_END_NODE:
+                offset += sizeof(u32);
+                if (--depth == 0) {
+                    return offset;
+                }
+                break;
+            default:
+                // TOKEN_END or garbage: the blob is truncated.
+                assert(false, "fdt: unterminated node at offset ", offset);
+                return offset;
+        }
+    }
+}
+
+node
+blob::root() const
+{
+    u32 offset = skip_nops(0);
+    if (token(offset) != TOKEN_BEGIN_NODE) {
+        return node();
+    }
+    return node(this, offset, DEFAULT_ADDRESS_CELLS, DEFAULT_SIZE_CELLS);
+}
+
+node
+blob::find_path(str_view path) const
+{
+    if (path.length() == 0 || path[0] != '/') {
+        return node();
+    }
+
+    node current = root();
+    size_t start = 1;
+    while (current && start < path.length()) {
+        size_t end = path.find('/', start);
+        if (end == str_view::s_sentinel) {
+            end = path.length();
+        }
+        if (end != start) {
+            current = current.find_child(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return current;
+}
+
+node
+blob::node_at(u32 offset) const
+{
+    node current = root();
+    while (current && current.offset() != offset) {
+        // Descend into the last child starting at or before `offset`, which contains it.
+        node next;
+        for (node child = current.first_child(); child && child.offset() <= offset;
+             child = child.next_sibling()) {
+            next = child;
+        }
+        current = next;
+    }
+    return current;
+}
+
+node
+blob::find_compatible(str_view compatible, node after) const
+{
+    if (!after) {
+        after = root();
+        if (!after || after.is_compatible(compatible)) {
+            return after;
+        }
+    }
+
+    // A forward scan from `after`. The cell counts of each node entered on the way are stacked, as
+    // its children's `reg` needs them. Once the scan climbs above the parent of `after` the counts
+    // of the level it's in are unknown, the first node there is looked up from the root to learn
+    // them. That's at most one lookup per ancestor of `after`.
+    struct cells
+    {
+        u32 address;
+        u32 size;
+    };
+    cells stack[MAX_DEPTH + 1];
+    size_t depth = 0;
+    stack[depth++] = { after.m_parent_address_cells, after.m_parent_size_cells };
+    stack[depth++] = { after.address_cells(), after.size_cells() };
+
+    u32 offset = skip_properties(after.properties_begin());
+    while (true) {
+        switch (token(offset)) {
+            case TOKEN_BEGIN_NODE:
+            {
+                if (depth == 0) {
+                    node found = node_at(offset);
+                    stack[depth++] = { found.m_parent_address_cells, found.m_parent_size_cells };
+                }
+                node current(this, offset, stack[depth - 1].address, stack[depth - 1].size);
+                if (current.is_compatible(compatible)) {
+                    return current;
+                }
+                // A validated blob nests at most MAX_DEPTH deep, so the stack can't overflow.
+                stack[depth++] = { current.address_cells(), current.size_cells() };
+                offset = skip_properties(current.properties_begin());
+                break;
+            }
+            case TOKEN_END_NODE:
+                if (depth != 0) {
+                    depth--;
+                }
+                offset = skip_nops(offset + sizeof(u32));
+                break;
+            default:
+                return node();
+        }
+    }
+}
+
+}
@@ -1,8 +1,13 @@
 #include <devices/device_tree.h>
+#include <devices/fdt.h>
 #include <fmt/print.h>
+#include <kvspace.h>
 #include <limine/platform_info.h>
+#include <memory.h>
 #include <panic.h>
 #include <pmm.h>
+#include <riscv/asid.h>
+#include <riscv/isa.h>
 #include <types/number.h>
 #include <uart.h>
 
@@ -12,14 +17,35 @@ uart_putchar(char c)
     uart(limine::hhdm_phys_to_virt(0x10000000)).send(c);
 }
 
+/// Switches `strlen` and `find_byte` to the fastest implementation every hart supports. Runs
+/// before the device tree is parsed, so that the parser already benefits. There is a single hart
+/// for now, the others would have to enable their vector unit as well.
+void
+select_string_routines(const u8* dtb)
+{
+    fdt::blob blob;
+    if (fdt::blob::open(dtb, &blob).is_err()) {
+        // Parsing the device tree will report it, the portable routines work everywhere.
+        return;
+    }
+    u32 extensions = riscv::common_isa_extensions(blob);
+    if (extensions & riscv::ISA_V) {
+        riscv::enable_vector_unit();
+        mem::select_string_impl(mem::string_impl::RVV);
+    } else if (extensions & riscv::ISA_ZBB) {
+        mem::select_string_impl(mem::string_impl::ZBB);
+    }
+}
+
 extern "C" void
 kernel_cxx_entry()
 {
     fmt::initialize(&uart_putchar);
 
     const struct limine::platform_info* pinfo = limine::parse_platform_info();
-    assert(LIMINE_PAGING_MODE_RISCV_SV39 == pinfo->mode,
-           "For now we only support SV39 style paging.");
+    assert(limine::KERNEL_PAGING_MODE == pinfo->mode,
+           "The bootloader didn't set up the paging mode the kernel is built for.");
+    select_string_routines((const u8*)pinfo->device_tree_blob);
 
     pmm::initialize(pmm::Policy::FIRST_FIT);
     for (size_t i = 0; i < pinfo->memmap_count; i++) {
@@ -32,7 +58,29 @@ kernel_cxx_entry()
     }
     fmt::println("PMM free bytes: ", fmt::hex(pmm::free_memory()));
 
-    error err = dt::parse_from_blob((const u8*)pinfo->device_tree_blob);
+    error err = kvspace::initialize(pinfo);
+    assert(err.is_ok(), err.str());
+    riscv::initialize_asids();
+    fmt::println("ASID bits: ", riscv::asid_bits());
+
+    // Boot goes on in an address space of its own, with the kernel's half shared and its own ASID.
+    riscv::address_space boot_space;
+    err = kvspace::create_address_space(&boot_space);
+    assert(err.is_ok(), err.str());
+    riscv::switch_address_space(&boot_space);
+
+    err = error(ErrorCode::DT_CACHE_INVALID);
+    if (pinfo->device_tree_cache != nullptr) {
+        err = dt::load_from_cache((const u8*)pinfo->device_tree_cache,
+                                  pinfo->device_tree_cache_size,
+                                  (const u8*)pinfo->device_tree_blob);
+        if (err.is_err()) {
+            fmt::println("Ignoring the device tree cache: ", err.str());
+        }
+    }
+    if (err.is_err()) {
+        err = dt::parse_from_blob((const u8*)pinfo->device_tree_blob);
+    }
     assert(err.is_ok(), err.str());
 
     limine_framebuffer* framebuffer = pinfo->framebuffers[0];
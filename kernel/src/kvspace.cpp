@@ -0,0 +1,604 @@
+#include <allocators/slab.h>
+#include <fmt/assert.h>
+#include <kvspace.h>
+#include <limine/platform_info.h>
+#include <pmm.h>
+#include <riscv/asid.h>
+#include <riscv/paging.h>
+#include <types/error.h>
+#include <types/number.h>
+#include <types/rb_tree.h>
+
+/// Boundaries of the kernel image sections, from kernel_limine.ld.
+extern "C" char __kernel_start[], __text_start[], __rodata_start[], __data_start[], __kernel_end[];
+
+namespace kvspace {
+
+namespace {
+
+/// A range of the window, either free or reserved.
+struct va_range
+{
+    vaddr_t base;
+    size_t length;
+    /// Largest alignment order (trailing zeros of the base) in this node's subtree of the size
+    /// tree. Only meaningful while the range is free.
+    u32 max_align_order;
+    /// Node in the free tree by address while free, or in the reservation tree while reserved.
+    rb_node by_base;
+    /// Node in the free tree by size, only while free.
+    rb_node by_size;
+};
+
+/// Orders ranges by base address.
+struct base_order
+{
+    static bool less(const va_range& lhs, const va_range& rhs) { return lhs.base < rhs.base; }
+    static int compare(vaddr_t key, const va_range& range)
+    {
+        return (key < range.base) ? -1 : (key > range.base);
+    }
+};
+
+/// Key of the size tree: the length first, the base breaks ties so equal sizes go low first.
+struct size_key
+{
+    size_t length;
+    vaddr_t base;
+};
+
+/// Orders ranges by length, then base address.
+struct size_order
+{
+    static bool less(const va_range& lhs, const va_range& rhs)
+    {
+        return lhs.length < rhs.length || (lhs.length == rhs.length && lhs.base < rhs.base);
+    }
+    static int compare(const size_key& key, const va_range& range)
+    {
+        if (key.length != range.length) {
+            return (key.length < range.length) ? -1 : 1;
+        }
+        return (key.base < range.base) ? -1 : (key.base > range.base);
+    }
+};
+
+/// Keeps `max_align_order` up to date, so the best fit search can skip subtrees without a base
+/// aligned enough.
+struct align_augment
+{
+    static void update(va_range* range);
+};
+
+using base_tree = rb_tree<va_range, &va_range::by_base, base_order>;
+using size_tree = rb_tree<va_range, &va_range::by_size, size_order, align_augment>;
+
+void
+align_augment::update(va_range* range)
+{
+    u32 order = num::count_trailing_zeros(range->base);
+    if (va_range* left = size_tree::left(range)) {
+        order = num::max(order, left->max_align_order);
+    }
+    if (va_range* right = size_tree::right(range)) {
+        order = num::max(order, right->max_align_order);
+    }
+    range->max_align_order = order;
+}
+
+/// Every reservation is followed by an unmapped page, so running off the end of a region faults
+/// instead of scribbling over its neighbour.
+constexpr size_t GUARD_SIZE = riscv::paging::PAGE_SIZE;
+
+// Buffer used to initialize the range allocator.
+constexpr size_t INITIAL_RANGE_COUNT = 64;
+constexpr size_t RANGE_BUF_ALIGN = slab_alloc<va_range>::region_align();
+constexpr size_t RANGE_BUF_SIZE = slab_alloc<va_range>::region_size(INITIAL_RANGE_COUNT);
+alignas(RANGE_BUF_ALIGN) constinit u8 RANGE_BUF[RANGE_BUF_SIZE] = { 0 };
+/// The range allocator is refilled with a fresh page once it drops below this many free ranges.
+/// A reservation takes at most two.
+constexpr size_t RANGE_REFILL_THRESHOLD = 8;
+
+slab_alloc<va_range> range_allocator = {};
+/// Free ranges of the window by address, to find the neighbours a released region merges with.
+base_tree free_by_base = {};
+/// Free ranges of the window by size, to find the best fit.
+size_tree free_by_size = {};
+/// Reserved regions by base address, guard page included.
+base_tree reserved = {};
+
+/// The kernel's root page table. Every address space shares its upper half, and the window is
+/// mapped through it whichever one is in `satp`.
+riscv::paging::page_table* kernel_root = nullptr;
+
+/// Flags shared by every kernel mapping. Setting A and D up front saves the faults (or hardware
+/// updates) on first access, and global keeps the entries in the TLB across address spaces.
+constexpr u64 KERNEL_FLAGS =
+  riscv::paging::TEF_GLOBAL | riscv::paging::TEF_ACCESSED | riscv::paging::TEF_DIRTY;
+
+/// `page_source` backing a region with fresh zeroed pages from the pmm.
+error
+alloc_page(size_t, paddr_t* pa, void*)
+{
+    return pmm::alloc(riscv::paging::PAGE_SIZE, pa);
+}
+
+/// `unmap_callback` giving a region's pages back to the pmm.
+void
+free_page(paddr_t pa, size_t, void*)
+{
+    error err = pmm::free(pa);
+    assert_err(err);
+}
+
+/// `page_source` handing out the pages mapped at the old location of a region being moved, whose
+/// base is the context.
+error
+moved_page(size_t offset, paddr_t* pa, void* context)
+{
+    vaddr_t old_base = *static_cast<vaddr_t*>(context);
+    *pa = riscv::paging::virt_to_phys(kernel_root, old_base + offset);
+    if (*pa == static_cast<paddr_t>(-1)) {
+        return ErrorCode::PAGING_NOT_MAPPED;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Start of the upper half of the address space, where everything the kernel maps lives.
+constexpr vaddr_t UPPER_HALF_BASE = riscv::paging::upper_half_base(riscv::paging::LEVELS);
+
+/// Returns the end of the physical range the direct map covers: every memory map entry, the
+/// framebuffers, and at least the first 4 GiB, which Limine maps too and where the MMIO of the
+/// usual platforms lives. Rounded up to a gigapage.
+paddr_t
+direct_map_end(const limine::platform_info* pinfo)
+{
+    paddr_t end = 4 * riscv::paging::GIGAPAGE_SIZE;
+    for (size_t i = 0; i < pinfo->memmap_count; i++) {
+        end = num::max(end, pinfo->memmap[i].base + pinfo->memmap[i].length);
+    }
+    for (size_t i = 0; i < pinfo->framebuffer_count; i++) {
+        limine_framebuffer* framebuffer = pinfo->framebuffers[i];
+        paddr_t base = limine::hhdm_virt_to_phys(framebuffer->address);
+        end = num::max(end, base + framebuffer->pitch * framebuffer->height);
+    }
+    return align_up(end, riscv::paging::GIGAPAGE_SIZE);
+}
+
+/// Maps the kernel image section [start, end) at its link address with `flags`.
+error
+map_kernel_section(riscv::paging::page_table* root,
+                   const limine::platform_info* pinfo,
+                   const char* start,
+                   const char* end,
+                   u64 flags)
+{
+    vaddr_t va = reinterpret_cast<vaddr_t>(start);
+    size_t size = align_up(reinterpret_cast<vaddr_t>(end), riscv::paging::PAGE_SIZE) - va;
+    paddr_t pa = pinfo->kernel_physical_base + (va - pinfo->kernel_virtual_base);
+    return riscv::paging::map_range(root, va, pa, size, flags | KERNEL_FLAGS);
+}
+
+/// Fills the kernel's root page table: the direct map at the hhdm base, then the kernel image.
+error
+map_kernel(riscv::paging::page_table* root, const limine::platform_info* pinfo)
+{
+    using namespace riscv::paging;
+
+    // Sv39 leaves the upper half 256 GiB, of which the direct map gets the part below the window.
+    // Machines with more memory need a kernel built with a deeper KERNEL_PAGING_MODE.
+    paddr_t end = direct_map_end(pinfo);
+    if (pinfo->hhdm_base < UPPER_HALF_BASE || end > WINDOW_BASE - pinfo->hhdm_base) {
+        return ErrorCode::KVSPACE_OUT_OF_SPACE;
+    }
+    error err = map_range(root, pinfo->hhdm_base, 0, end, TEF_READ | TEF_WRITE | KERNEL_FLAGS);
+    if (err.is_err())
+        return err;
+
+    // The request section is only read after boot, so it shares the rodata permissions.
+    err = map_kernel_section(root, pinfo, __kernel_start, __text_start, TEF_READ);
+    if (err.is_err())
+        return err;
+    err = map_kernel_section(root, pinfo, __text_start, __rodata_start, TEF_READ | TEF_EXECUTE);
+    if (err.is_err())
+        return err;
+    err = map_kernel_section(root, pinfo, __rodata_start, __data_start, TEF_READ);
+    if (err.is_err())
+        return err;
+    return map_kernel_section(root, pinfo, __data_start, __kernel_end, TEF_READ | TEF_WRITE);
+}
+
+/// Keeps the va_range slab allocator stocked, so a reservation never runs out of nodes halfway.
+/// These pages are never returned.
+error
+refill_range_allocator()
+{
+    if (range_allocator.free_count() >= RANGE_REFILL_THRESHOLD) [[likely]] {
+        return ErrorCode::SUCCESS;
+    }
+    paddr_t page;
+    error err = pmm::alloc(riscv::paging::PAGE_SIZE, &page);
+    if (err.is_err()) {
+        return err;
+    }
+    range_allocator.grow(limine::hhdm_phys_to_virt(page), riscv::paging::PAGE_SIZE);
+    return ErrorCode::SUCCESS;
+}
+
+/// Hands the whole window to the free trees.
+void
+initialize_window()
+{
+    range_allocator.grow(reinterpret_cast<void*>(RANGE_BUF), RANGE_BUF_SIZE);
+    va_range* window = range_allocator.alloc();
+    assert(window != nullptr);
+    window->base = WINDOW_BASE;
+    window->length = WINDOW_END - WINDOW_BASE;
+    free_by_base.insert(window);
+    free_by_size.insert(window);
+}
+
+/// Checks whether `size` bytes at a base aligned to `alignment` fit in the free `range`.
+bool
+fits(const va_range* range, size_t size, size_t alignment)
+{
+    size_t padding = align_up(range->base, alignment) - range->base;
+    return padding <= range->length && range->length - padding >= size;
+}
+
+/// Returns the first range of the subtree in size order that is at least `size` bytes long and
+/// whose base is aligned to 2^`order`, or nullptr.
+va_range*
+first_aligned(va_range* range, size_t size, u32 order)
+{
+    if (range == nullptr || range->max_align_order < order) {
+        return nullptr;
+    }
+    if (range->length < size) {
+        return first_aligned(size_tree::right(range), size, order);
+    }
+    if (va_range* found = first_aligned(size_tree::left(range), size, order)) {
+        return found;
+    }
+    if (num::count_trailing_zeros(range->base) >= order) {
+        return range;
+    }
+    return first_aligned(size_tree::right(range), size, order);
+}
+
+/// Returns the smallest free range that fits `size` bytes aligned to `alignment`, or nullptr.
+va_range*
+best_fit(size_t size, size_t alignment)
+{
+    // The shortest range long enough is the best fit whenever its base allows the alignment,
+    // which is always the case for page alignment.
+    va_range* shortest = free_by_size.lower_bound(size_key{ size, 0 });
+    if (shortest == nullptr || fits(shortest, size, alignment)) {
+        return shortest;
+    }
+
+    // Otherwise pick the shorter of the first range with an aligned base and the first range long
+    // enough to fit whatever its base. Ranges between the two that only need part of the padding
+    // are passed over, which keeps the search O(log n).
+    va_range* aligned =
+      first_aligned(free_by_size.root(), size, num::count_trailing_zeros(alignment));
+    va_range* padded = free_by_size.lower_bound(
+      size_key{ size + alignment - riscv::paging::PAGE_SIZE, 0 });
+    if (aligned == nullptr || padded == nullptr) {
+        return (aligned != nullptr) ? aligned : padded;
+    }
+    return size_order::less(*aligned, *padded) ? aligned : padded;
+}
+
+/// Takes `size` bytes aligned to `alignment` out of the free `range`, which must fit them, and
+/// returns the range describing them. Needs up to two nodes from the range allocator.
+va_range*
+carve(va_range* range, size_t size, size_t alignment)
+{
+    vaddr_t base = align_up(range->base, alignment);
+    vaddr_t end = base + size;
+    vaddr_t range_end = range->base + range->length;
+    free_by_size.remove(range);
+
+    if (base == range->base && end == range_end) {
+        free_by_base.remove(range);
+        return range;
+    }
+    if (base == range->base) {
+        // The tail keeps the range's place in the address order, so that tree needs no update.
+        range->base = end;
+        range->length = range_end - end;
+        free_by_size.insert(range);
+    } else {
+        range->length = base - range->base;
+        free_by_size.insert(range);
+        if (end != range_end) {
+            va_range* tail = range_allocator.alloc();
+            assert(tail != nullptr);
+            tail->base = end;
+            tail->length = range_end - end;
+            free_by_base.insert(tail);
+            free_by_size.insert(tail);
+        }
+    }
+
+    va_range* region = range_allocator.alloc();
+    assert(region != nullptr);
+    region->base = base;
+    region->length = size;
+    return region;
+}
+
+/// Returns `region` to the free trees, merging it with the free ranges on either side.
+void
+give_back(va_range* region)
+{
+    va_range* prev = free_by_base.floor(region->base);
+    va_range* next = free_by_base.lower_bound(region->base);
+    bool merge_prev = prev != nullptr && prev->base + prev->length == region->base;
+    bool merge_next = next != nullptr && next->base == region->base + region->length;
+
+    if (!merge_prev && !merge_next) {
+        free_by_base.insert(region);
+        free_by_size.insert(region);
+        return;
+    }
+
+    if (merge_prev && merge_next) {
+        free_by_size.remove(prev);
+        free_by_size.remove(next);
+        free_by_base.remove(next);
+        prev->length += region->length + next->length;
+        free_by_size.insert(prev);
+        error err = range_allocator.free(next);
+        assert_err(err);
+    } else if (merge_prev) {
+        free_by_size.remove(prev);
+        prev->length += region->length;
+        free_by_size.insert(prev);
+    } else {
+        // Growing `next` downwards keeps its place in the address order.
+        free_by_size.remove(next);
+        next->base = region->base;
+        next->length += region->length;
+        free_by_size.insert(next);
+    }
+    error err = range_allocator.free(region);
+    assert_err(err);
+}
+
+} // namespace
+
+error
+initialize(const limine::platform_info* pinfo)
+{
+    initialize_window();
+
+    riscv::paging::page_table* root;
+    error err = riscv::paging::create_root(&root);
+    if (err.is_err()) {
+        return err;
+    }
+
+    err = map_kernel(root, pinfo);
+    if (err.is_ok()) {
+        // Address spaces copy the kernel's top-level entries, so the tables below the window must
+        // exist before the first one is created and must stay.
+        err = riscv::paging::pin_tables(root, WINDOW_BASE, WINDOW_END - WINDOW_BASE);
+    }
+    if (err.is_err()) {
+        // A failed pin_tables leaves no pins, so unmapping the upper half frees every table below
+        // it. destroy_root leaves that half alone, and frees the root.
+        error undo = riscv::paging::unmap_range(root, UPPER_HALF_BASE, 0 - UPPER_HALF_BASE);
+        assert_err(undo);
+        riscv::paging::destroy_root(root);
+        return err;
+    }
+
+    kernel_root = root;
+    riscv::paging::switch_page_table(root);
+    return ErrorCode::SUCCESS;
+}
+
+error
+create_address_space(riscv::address_space* ret)
+{
+    if (ret == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    *ret = riscv::address_space{ nullptr };
+    return riscv::paging::create_root(&ret->root, kernel_root);
+}
+
+void
+destroy_address_space(riscv::address_space* space,
+                      riscv::paging::unmap_callback on_unmap,
+                      void* context)
+{
+    riscv::paging::destroy_root(space->root, on_unmap, context);
+    space->root = nullptr;
+}
+
+error
+reserve_region(size_t size, size_t alignment, vaddr_t* ret)
+{
+    if (ret == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    *ret = 0;
+    alignment = (alignment < riscv::paging::PAGE_SIZE) ? riscv::paging::PAGE_SIZE : alignment;
+    if ((alignment & (alignment - 1)) != 0 || alignment > WINDOW_END - WINDOW_BASE) {
+        return ErrorCode::KVSPACE_BAD_ALIGN;
+    }
+    if (size > WINDOW_END - WINDOW_BASE) {
+        return ErrorCode::KVSPACE_OUT_OF_SPACE;
+    }
+    size = align_up(size, riscv::paging::PAGE_SIZE) + GUARD_SIZE;
+
+    error err = refill_range_allocator();
+    if (err.is_err()) {
+        return err;
+    }
+    va_range* range = best_fit(size, alignment);
+    if (range == nullptr) {
+        return ErrorCode::KVSPACE_OUT_OF_SPACE;
+    }
+
+    va_range* region = carve(range, size, alignment);
+    reserved.insert(region);
+    *ret = region->base;
+    return ErrorCode::SUCCESS;
+}
+
+error
+map_region(vaddr_t region_base, size_t size)
+{
+    if (!is_aligned(region_base, riscv::paging::PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+
+    // One walk for the whole region and a single TLB flush at the end. The pages aren't
+    // contiguous, so they are allocated one by one as the walk reaches them. On failure the walk
+    // unmaps what it did and hands every page back to free_page.
+    u64 flags = riscv::paging::TEF_READ | riscv::paging::TEF_WRITE | KERNEL_FLAGS;
+    return riscv::paging::map_range(kernel_root,
+                                    region_base,
+                                    align_up(size, riscv::paging::PAGE_SIZE),
+                                    flags,
+                                    alloc_page,
+                                    free_page,
+                                    nullptr);
+}
+
+error
+reserve_and_map_region(size_t size, size_t alignment, vaddr_t* ret)
+{
+    error err = reserve_region(size, alignment, ret);
+    if (err.is_err()) {
+        return err;
+    }
+    err = map_region(*ret, align_up(size, riscv::paging::PAGE_SIZE));
+    if (err.is_err()) {
+        error undo = release_region(*ret, size);
+        assert_err(undo);
+        *ret = 0;
+    }
+    return err;
+}
+
+error
+reallocate(vaddr_t region_base,
+           size_t old_size,
+           size_t new_size,
+           size_t new_reserved,
+           vaddr_t* ret)
+{
+    if (ret == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    *ret = region_base;
+    va_range* region = reserved.find(region_base);
+    size_t reserved_size = (region != nullptr) ? region->length - GUARD_SIZE : 0;
+    old_size = align_up(old_size, riscv::paging::PAGE_SIZE);
+    new_size = align_up(new_size, riscv::paging::PAGE_SIZE);
+    if (region == nullptr || old_size > reserved_size) {
+        return ErrorCode::KVSPACE_NOT_RESERVED;
+    }
+
+    if (new_size <= old_size) {
+        return unmap_region(region_base + new_size, old_size - new_size);
+    }
+    if (new_size <= reserved_size) {
+        return map_region(region_base + old_size, new_size - old_size);
+    }
+
+    vaddr_t new_base;
+    new_reserved = num::max(new_reserved, new_size);
+    error err = reserve_region(new_reserved, riscv::paging::PAGE_SIZE, &new_base);
+    if (err.is_err()) {
+        return err;
+    }
+    // The old pages are mapped a second time at the new base, then unmapped from the old one
+    // without freeing them.
+    u64 flags = riscv::paging::TEF_READ | riscv::paging::TEF_WRITE | KERNEL_FLAGS;
+    err = riscv::paging::map_range(kernel_root,
+                                   new_base,
+                                   old_size,
+                                   flags,
+                                   moved_page,
+                                   nullptr,
+                                   &region_base);
+    if (err.is_ok()) {
+        err = map_region(new_base + old_size, new_size - old_size);
+        if (err.is_err()) {
+            error undo = riscv::paging::unmap_range(kernel_root, new_base, old_size);
+            assert_err(undo);
+        }
+    }
+    if (err.is_err()) {
+        error undo = release_region(new_base, new_reserved);
+        assert_err(undo);
+        return err;
+    }
+
+    err = riscv::paging::unmap_range(kernel_root, region_base, old_size);
+    assert_err(err);
+    err = release_region(region_base, reserved_size);
+    assert_err(err);
+    *ret = new_base;
+    return ErrorCode::SUCCESS;
+}
+
+error
+unmap_region(vaddr_t region_base, size_t size)
+{
+    // The pages are freed before unmap_range flushes the TLB. Only the region itself still
+    // translates to them until then, and the caller is done with it.
+    return riscv::paging::unmap_range(kernel_root, region_base, size, free_page, nullptr);
+}
+
+error
+release_region(vaddr_t region_base, size_t size)
+{
+    va_range* region = reserved.find(region_base);
+    if (region == nullptr ||
+        region->length != align_up(size, riscv::paging::PAGE_SIZE) + GUARD_SIZE) {
+        return ErrorCode::KVSPACE_NOT_RESERVED;
+    }
+    reserved.remove(region);
+    give_back(region);
+    return ErrorCode::SUCCESS;
+}
+
+error
+vmalloc(size_t size, void** ret)
+{
+    if (ret == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    vaddr_t base;
+    error err = reserve_and_map_region(size, riscv::paging::PAGE_SIZE, &base);
+    *ret = reinterpret_cast<void*>(base);
+    return err;
+}
+
+error
+vfree(void* ptr)
+{
+    if (ptr == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    vaddr_t base = reinterpret_cast<vaddr_t>(ptr);
+    va_range* region = reserved.find(base);
+    if (region == nullptr) {
+        return ErrorCode::KVSPACE_NOT_RESERVED;
+    }
+    size_t size = region->length - GUARD_SIZE;
+    error err = unmap_region(base, size);
+    if (err.is_err()) {
+        return err;
+    }
+    return release_region(base, size);
+}
+
+} // namespace kvspace
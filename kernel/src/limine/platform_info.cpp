@@ -3,6 +3,7 @@
 #include <fmt/assert.h>
 #include <limine/platform_info.h>
 #include <types/error.h>
+#include <types/str_view.h>
 
 namespace limine {
 
@@ -21,11 +22,15 @@ LIMINE_REQ volatile limine_framebuffer_request framebuffer_req = {
     .response = nullptr,
 };
 
-/// Paging Mode request
+/// Paging Mode request. The kernel tables only work in the mode they are built for, so it is also
+/// the only one accepted.
 LIMINE_REQ volatile limine_paging_mode_request paging_mode_req = {
     .id = LIMINE_PAGING_MODE_REQUEST,
+    .revision = 1,
     .response = nullptr,
-    .mode = LIMINE_PAGING_MODE_RISCV_SV39
+    .mode = KERNEL_PAGING_MODE,
+    .max_mode = KERNEL_PAGING_MODE,
+    .min_mode = KERNEL_PAGING_MODE,
 };
 
 /// Memory Map request
@@ -40,6 +45,13 @@ LIMINE_REQ volatile limine_dtb_request dtb_req = {
     .response = nullptr,
 };
 
+/// Module request, used for the optional device tree cache
+LIMINE_REQ volatile limine_module_request module_req = {
+    .id = LIMINE_MODULE_REQUEST,
+    .revision = 0,
+    .response = nullptr,
+};
+
 /// HigherHalf Direct Mapping request
 LIMINE_REQ volatile limine_hhdm_request hhdm_req = {
     .id = LIMINE_HHDM_REQUEST,
@@ -47,6 +59,13 @@ LIMINE_REQ volatile limine_hhdm_request hhdm_req = {
     .response = nullptr,
 };
 
+/// Kernel Address request, to map the kernel image in our own page tables
+LIMINE_REQ volatile limine_kernel_address_request kernel_address_req = {
+    .id = LIMINE_KERNEL_ADDRESS_REQUEST,
+    .revision = 0,
+    .response = nullptr,
+};
+
 /// End Marker for the Limine Request Section
 LIMINE_END volatile LIMINE_REQUESTS_END_MARKER;
 
@@ -61,6 +80,7 @@ parse_platform_info()
     assert(memmap_req.response != nullptr, error(ErrorCode::LIMINE_REQUEST_ERROR));
     assert(dtb_req.response != nullptr, error(ErrorCode::LIMINE_REQUEST_ERROR));
     assert(hhdm_req.response != nullptr, error(ErrorCode::LIMINE_REQUEST_ERROR));
+    assert(kernel_address_req.response != nullptr, error(ErrorCode::LIMINE_REQUEST_ERROR));
 
     pinfo = {
         .framebuffer_count = framebuffer_req.response->framebuffer_count,
@@ -69,8 +89,22 @@ parse_platform_info()
         .memmap_count = memmap_req.response->entry_count,
         .memmap = *memmap_req.response->entries,
         .device_tree_blob = dtb_req.response->dtb_ptr,
+        .device_tree_cache = nullptr,
+        .device_tree_cache_size = 0,
         .hhdm_base = hhdm_req.response->offset,
+        .kernel_physical_base = kernel_address_req.response->physical_base,
+        .kernel_virtual_base = kernel_address_req.response->virtual_base,
     };
+
+    if (module_req.response != nullptr) {
+        for (u64 i = 0; i < module_req.response->module_count; i++) {
+            limine_file* module = module_req.response->modules[i];
+            if (str_view::compare(str_view::from_null_term(module->cmdline), "dt-cache") == 0) {
+                pinfo.device_tree_cache = module->address;
+                pinfo.device_tree_cache_size = module->size;
+            }
+        }
+    }
     return &pinfo;
 }
 
@@ -1,10 +1,62 @@
 #include <memory.h>
 
 namespace mem {
+
+namespace {
+
+/// A u64 which may alias any other type, used by the word-at-a-time routines.
+using word_t = u64 __attribute__((may_alias));
+
+constexpr size_t WORD_SIZE = sizeof(u64);
+constexpr u64 LOW_BITS = 0x0101010101010101ULL;
+constexpr u64 HIGH_BITS = 0x8080808080808080ULL;
+
+/// Returns a mask of all bytes of the aligned word containing `ptr` that precede `ptr`. The scans
+/// OR this into their first word so that those bytes never match.
+inline u64
+leading_bytes_mask(const void* ptr)
+{
+    size_t offset = reinterpret_cast<size_t>(ptr) & (WORD_SIZE - 1);
+    return (u64(1) << (8 * offset)) - 1;
+}
+
+/// Returns the aligned word containing `ptr`. Aligned loads never cross a page boundary, so reading
+/// the bytes around a string or view is always safe.
+inline const word_t*
+containing_word(const void* ptr)
+{
+    return reinterpret_cast<const word_t*>(align_down(reinterpret_cast<size_t>(ptr), WORD_SIZE));
+}
+
+/// Marks the routines that read around their input through `containing_word`, which
+/// AddressSanitizer (in host builds, see kernel/host) would otherwise report as overflows.
+#define READS_CONTAINING_WORDS __attribute__((no_sanitize("address")))
+
+} // namespace
+
 void
 fill(void* dest, u8 c, size_t count)
 {
     u8* dst = reinterpret_cast<u8*>(dest);
+    for (; count > 0 && !is_aligned(dst, WORD_SIZE); count--) {
+        *dst++ = c;
+    }
+
+    // The bulk is stored a word at a time, four words per iteration to keep the loop overhead out
+    // of page-sized fills.
+    word_t* word = reinterpret_cast<word_t*>(dst);
+    u64 pattern = LOW_BITS * c;
+    for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE, word += 4) {
+        word[0] = pattern;
+        word[1] = pattern;
+        word[2] = pattern;
+        word[3] = pattern;
+    }
+    for (; count >= WORD_SIZE; count -= WORD_SIZE) {
+        *word++ = pattern;
+    }
+
+    dst = reinterpret_cast<u8*>(word);
     for (size_t i = 0; i < count; i++) {
         dst[i] = c;
     }
@@ -33,13 +85,29 @@ copy(const void* src, void* dst, size_t count)
     const u8* src_u8 = static_cast<const u8*>(src);
     u8* dst_u8 = static_cast<u8*>(dst);
 
+    // If both pointers share the same offset within a word, copy the bulk a word at a time.
+    if (is_aligned(src_u8 - dst_u8, WORD_SIZE)) {
+        for (; count > 0 && !is_aligned(src_u8, WORD_SIZE); count--) {
+            *dst_u8++ = *src_u8++;
+        }
+        const word_t* src_word = reinterpret_cast<const word_t*>(src_u8);
+        word_t* dst_word = reinterpret_cast<word_t*>(dst_u8);
+        for (; count >= WORD_SIZE; count -= WORD_SIZE) {
+            *dst_word++ = *src_word++;
+        }
+        src_u8 = reinterpret_cast<const u8*>(src_word);
+        dst_u8 = reinterpret_cast<u8*>(dst_word);
+    }
+
     for (size_t i = 0; i < count; i++) {
         dst_u8[i] = src_u8[i];
     }
 }
 
+namespace {
+
 size_t
-strlen(const char* src)
+strlen_bytewise(const char* src)
 {
     size_t len = 0;
     while (src[len] != '\0') {
@@ -47,4 +115,256 @@ strlen(const char* src)
     }
     return len;
 }
+
+size_t
+find_byte_bytewise(const void* src, u8 c, size_t count)
+{
+    const u8* bytes = static_cast<const u8*>(src);
+    for (size_t i = 0; i < count; i++) {
+        if (bytes[i] == c) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/// Sets the high bit of every zero byte in `word`. Bytes above the first zero byte may be false
+/// positives because of borrow propagation, the lowest set bit is always exact.
+inline u64
+swar_zero_bytes(u64 word)
+{
+    return (word - LOW_BITS) & ~word & HIGH_BITS;
+}
+
+/// Returns the index of the lowest byte flagged by `swar_zero_bytes`. Uses a multiply instead of
+/// `__builtin_ctzll`, which would become a libgcc call on harts without Zbb.
+inline size_t
+swar_first_byte(u64 mask)
+{
+    u64 lowest = (mask & -mask) >> 7;
+    return (lowest * 0x0001020304050607ULL) >> 56;
+}
+
+READS_CONTAINING_WORDS size_t
+strlen_swar(const char* src)
+{
+    const word_t* word = containing_word(src);
+    u64 zeros = swar_zero_bytes(*word | leading_bytes_mask(src));
+    while (zeros == 0) {
+        zeros = swar_zero_bytes(*++word);
+    }
+    return reinterpret_cast<const char*>(word) + swar_first_byte(zeros) - src;
+}
+
+READS_CONTAINING_WORDS size_t
+find_byte_swar(const void* src, u8 c, size_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const u8* bytes = static_cast<const u8*>(src);
+    const word_t* word = containing_word(bytes);
+    const word_t* last = containing_word(bytes + count - 1);
+    u64 pattern = LOW_BITS * c;
+    u64 zeros = swar_zero_bytes((*word ^ pattern) | leading_bytes_mask(bytes));
+    while (zeros == 0 && word != last) {
+        zeros = swar_zero_bytes(*++word ^ pattern);
+    }
+    if (zeros == 0) {
+        return count;
+    }
+
+    // A match in the bytes past the end of the final word is clamped away.
+    size_t index = reinterpret_cast<const u8*>(word) + swar_first_byte(zeros) - bytes;
+    return num::min(index, count);
+}
+
+// The Zbb and RVV routines only exist in the kernel itself. Host builds (see kernel/host) keep the
+// portable ones.
+#if defined(__riscv)
+
+/// Zbb `orc.b`: maps every zero byte to 0x00 and every non-zero byte to 0xFF.
+inline u64
+zbb_orc_b(u64 word)
+{
+    u64 ret;
+    asm(".option push\n"
+        ".option arch, +zbb\n"
+        "orc.b %0, %1\n"
+        ".option pop"
+        : "=r"(ret)
+        : "r"(word));
+    return ret;
+}
+
+/// Zbb `ctz`: counts the trailing zero bits of `word`.
+inline u64
+zbb_ctz(u64 word)
+{
+    u64 ret;
+    asm(".option push\n"
+        ".option arch, +zbb\n"
+        "ctz %0, %1\n"
+        ".option pop"
+        : "=r"(ret)
+        : "r"(word));
+    return ret;
+}
+
+READS_CONTAINING_WORDS size_t
+strlen_zbb(const char* src)
+{
+    const word_t* word = containing_word(src);
+    u64 nonzero = zbb_orc_b(*word | leading_bytes_mask(src));
+    while (nonzero == ~u64(0)) {
+        nonzero = zbb_orc_b(*++word);
+    }
+    return reinterpret_cast<const char*>(word) + zbb_ctz(~nonzero) / 8 - src;
+}
+
+READS_CONTAINING_WORDS size_t
+find_byte_zbb(const void* src, u8 c, size_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const u8* bytes = static_cast<const u8*>(src);
+    const word_t* word = containing_word(bytes);
+    const word_t* last = containing_word(bytes + count - 1);
+    u64 pattern = LOW_BITS * c;
+    u64 nonzero = zbb_orc_b((*word ^ pattern) | leading_bytes_mask(bytes));
+    while (nonzero == ~u64(0) && word != last) {
+        nonzero = zbb_orc_b(*++word ^ pattern);
+    }
+    if (nonzero == ~u64(0)) {
+        return count;
+    }
+
+    size_t index = reinterpret_cast<const u8*>(word) + zbb_ctz(~nonzero) / 8 - bytes;
+    return num::min(index, count);
+}
+
+// The kernel is compiled without the V extension, so the compiler never allocates vector
+// registers and the ones used below don't need to be listed as clobbers.
+
+size_t
+strlen_rvv(const char* src)
+{
+    const char* curr = src;
+    size_t vl;
+    i64 first;
+    // `vle8ff` only faults on the first element, so loads running past the terminator are safe.
+    asm volatile(".option push\n"
+                 ".option arch, +v\n"
+                 "1:\n"
+                 "vsetvli %[vl], zero, e8, m8, ta, ma\n"
+                 "vle8ff.v v8, (%[curr])\n"
+                 "csrr %[vl], vl\n"
+                 "vmseq.vi v0, v8, 0\n"
+                 "vfirst.m %[first], v0\n"
+                 "add %[curr], %[curr], %[vl]\n"
+                 "bltz %[first], 1b\n"
+                 "sub %[curr], %[curr], %[vl]\n"
+                 "add %[curr], %[curr], %[first]\n"
+                 ".option pop"
+                 : [curr] "+r"(curr), [vl] "=&r"(vl), [first] "=&r"(first)
+                 :
+                 : "memory");
+    return curr - src;
+}
+
+size_t
+find_byte_rvv(const void* src, u8 c, size_t count)
+{
+    const u8* curr = static_cast<const u8*>(src);
+    size_t remaining = count;
+    size_t vl;
+    i64 first = -1;
+    asm volatile(".option push\n"
+                 ".option arch, +v\n"
+                 "beqz %[remaining], 2f\n"
+                 "1:\n"
+                 "vsetvli %[vl], %[remaining], e8, m8, ta, ma\n"
+                 "vle8.v v8, (%[curr])\n"
+                 "vmseq.vx v0, v8, %[c]\n"
+                 "vfirst.m %[first], v0\n"
+                 "bgez %[first], 2f\n"
+                 "add %[curr], %[curr], %[vl]\n"
+                 "sub %[remaining], %[remaining], %[vl]\n"
+                 "bnez %[remaining], 1b\n"
+                 "2:\n"
+                 ".option pop"
+                 : [curr] "+r"(curr),
+                   [remaining] "+r"(remaining),
+                   [vl] "=&r"(vl),
+                   [first] "+r"(first)
+                 : [c] "r"(c)
+                 : "memory");
+    if (first < 0) {
+        return count;
+    }
+    return curr + first - static_cast<const u8*>(src);
+}
+
+#endif
+
+/// The implementation currently selected by `select_string_impl`.
+string_impl selected_impl = string_impl::SWAR;
+size_t (*strlen_impl)(const char*) = strlen_swar;
+size_t (*find_byte_impl)(const void*, u8, size_t) = find_byte_swar;
+
+} // namespace
+
+size_t
+strlen(const char* src)
+{
+    return strlen_impl(src);
+}
+
+size_t
+find_byte(const void* src, u8 c, size_t count)
+{
+    return find_byte_impl(src, c, count);
+}
+
+void
+select_string_impl(string_impl impl)
+{
+    switch (impl) {
+        case string_impl::BYTEWISE:
+            strlen_impl = strlen_bytewise;
+            find_byte_impl = find_byte_bytewise;
+            break;
+        case string_impl::SWAR:
+            strlen_impl = strlen_swar;
+            find_byte_impl = find_byte_swar;
+            break;
+#if defined(__riscv)
+        case string_impl::ZBB:
+            strlen_impl = strlen_zbb;
+            find_byte_impl = find_byte_zbb;
+            break;
+        case string_impl::RVV:
+            strlen_impl = strlen_rvv;
+            find_byte_impl = find_byte_rvv;
+            break;
+#else
+        case string_impl::ZBB:
+        case string_impl::RVV:
+            strlen_impl = strlen_swar;
+            find_byte_impl = find_byte_swar;
+            impl = string_impl::SWAR;
+            break;
+#endif
+    }
+    selected_impl = impl;
+}
+
+string_impl
+current_string_impl()
+{
+    return selected_impl;
+}
 } // namespace mem
@@ -3,27 +3,52 @@
 #include <cstring>
 #include <fmt/assert.h>
 #include <fmt/print.h>
+#include <limine/platform_info.h>
 #include <memory.h>
 #include <pmm.h>
-#include <riscv/sv39.h>
+#include <riscv/paging.h>
 #include <types/error.h>
+#include <types/intrusive_list.h>
 #include <types/number.h>
+#include <types/rb_tree.h>
 
 namespace pmm {
 
-/// Individual chunks of free memory within a memory region.
+/// Individual chunks of memory within a memory region. Free blocks are linked into their region's
+/// address-ordered list and tree, allocated blocks into the allocation tree.
 struct memory_block
 {
     paddr_t base;
     size_t length;
-    memory_block* next;
+    /// Link in the owning region's free list.
+    list_node link;
+    /// Node in the owning region's free tree while free, or in the allocation tree while allocated.
+    rb_node by_base;
 };
 
+/// Orders memory blocks by base address.
+struct block_order
+{
+    static bool less(const memory_block& lhs, const memory_block& rhs)
+    {
+        return lhs.base < rhs.base;
+    }
+    static int compare(paddr_t key, const memory_block& block)
+    {
+        return (key < block.base) ? -1 : (key > block.base);
+    }
+};
+
+using block_list = intrusive_list<memory_block, &memory_block::link>;
+using block_tree = rb_tree<memory_block, &memory_block::by_base, block_order>;
+
 // Buffer used to initialize the block allocator.
 constexpr size_t INITIAL_MEM_BLOCK_COUNT = 64;
 constexpr size_t BLOCK_BUF_ALIGN = slab_alloc<memory_block>::region_align();
 constexpr size_t BLOCK_BUF_SIZE = slab_alloc<memory_block>::region_size(INITIAL_MEM_BLOCK_COUNT);
 alignas(BLOCK_BUF_ALIGN) constinit u8 BLOCK_BUF[BLOCK_BUF_SIZE] = { 0 };
+/// The block allocator is refilled with a fresh page once it drops below this many free blocks.
+constexpr size_t BLOCK_REFILL_THRESHOLD = 16;
 
 /// A contiguous chunk of memory which has been added to the physical memory manager.
 struct memory_region
@@ -31,7 +56,10 @@ struct memory_region
     paddr_t base;
     size_t length;
     size_t free_bytes;
-    memory_block* free_blocks;
+    /// Free blocks in address order, walked by the allocation policies.
+    block_list free_blocks;
+    /// The same free blocks indexed by base address, used to find neighbours when freeing.
+    block_tree free_tree;
 };
 static constexpr size_t REGION_COUNT = 16;
 
@@ -44,7 +72,9 @@ size_t free_bytes = 0;
 /// Number of regions in the region list
 size_t region_count = 0;
 /// List of contiguous regions from which memory can be allocated
-memory_region regions[REGION_COUNT] = { { 0, 0, 0, nullptr } };
+memory_region regions[REGION_COUNT] = {};
+/// Live allocations indexed by base address, so `free` can recover their size.
+block_tree allocated = {};
 /// Slab allocator for memory_block structs.
 slab_alloc<memory_block> block_allocator = {};
 
@@ -66,35 +96,36 @@ add_region(paddr_t region_base, size_t region_size)
     }
 
     // Check that the aligned base and size region is at least BASE_PAGE_SIZE
-    size_t aligned_base = align_up(region_base, riscv::sv39::PAGE_SIZE);
+    size_t aligned_base = align_up(region_base, riscv::paging::PAGE_SIZE);
     size_t aligned_size =
-      align_down(region_size - (aligned_base - region_base), riscv::sv39::PAGE_SIZE);
+      align_down(region_size - (aligned_base - region_base), riscv::paging::PAGE_SIZE);
     bool ALIGNED_REGION_FITS = aligned_base + aligned_size <= region_base + region_size;
-    bool NEW_SIZE_NON_ZERO = aligned_size >= riscv::sv39::PAGE_SIZE;
+    bool NEW_SIZE_NON_ZERO = aligned_size >= riscv::paging::PAGE_SIZE;
     if (!ALIGNED_REGION_FITS || !NEW_SIZE_NON_ZERO) {
         return ErrorCode::PMM_REGION_TOO_SMALL;
     }
 
     // Check if this region overlaps with a managed region.
     for (size_t i = 0; i < region_count; i++) {
-        bool LOWER_BOUND = regions[i].base <= aligned_base;
-        bool UPPER_BOUND = aligned_base <= regions[i].base + regions[i].length;
+        bool LOWER_BOUND = regions[i].base < aligned_base + aligned_size;
+        bool UPPER_BOUND = aligned_base < regions[i].base + regions[i].length;
         if (LOWER_BOUND && UPPER_BOUND) {
             return ErrorCode::PMM_REGION_MANAGED;
         }
     }
 
     // Create and instantiate the region struct
-    struct memory_block* free_block = block_allocator.alloc();
-    assert(free_block != nullptr);
-    regions[region_count].base = aligned_base;
-    regions[region_count].length = aligned_size;
-    regions[region_count].free_bytes = aligned_size;
-    regions[region_count].free_blocks = block_allocator.alloc();
+    memory_block* free_block = block_allocator.alloc();
     assert(free_block != nullptr);
-    regions[region_count].free_blocks->base = aligned_base;
-    regions[region_count].free_blocks->length = aligned_size;
-    regions[region_count].free_blocks->next = nullptr;
+    free_block->base = aligned_base;
+    free_block->length = aligned_size;
+
+    memory_region& region = regions[region_count];
+    region.base = aligned_base;
+    region.length = aligned_size;
+    region.free_bytes = aligned_size;
+    region.free_blocks.push_back(free_block);
+    region.free_tree.insert(free_block);
     region_count++;
 
     total_bytes += aligned_size;
@@ -110,14 +141,84 @@ remove_region(paddr_t region_base, size_t region_size)
     return ErrorCode::NOT_IMPLEMENTED;
 }
 
+/// Removes [base, base + size) from the free block `block` of `region`. The range must lie within
+/// the block.
+static void
+carve_block(memory_region& region, memory_block* block, paddr_t base, size_t size)
+{
+    paddr_t block_end = block->base + block->length;
+    bool EXISTS_PRECEEDING = block->base != base;
+    bool EXISTS_POSTCEEDING = block_end > base + size;
+    if (EXISTS_PRECEEDING && EXISTS_POSTCEEDING) {
+        // Need a new block
+        memory_block* extra = block_allocator.alloc();
+        assert(extra != nullptr);
+        extra->base = base + size;
+        extra->length = block_end - (base + size);
+        block->length = base - block->base;
+        region.free_blocks.insert_after(block, extra);
+        region.free_tree.insert(extra);
+    } else if (EXISTS_PRECEEDING) {
+        block->length = base - block->base;
+    } else if (EXISTS_POSTCEEDING) {
+        // The block keeps its place in the address order, so the tree needs no update.
+        block->base = base + size;
+        block->length = block_end - (base + size);
+    } else {
+        region.free_blocks.remove(block);
+        region.free_tree.remove(block);
+        error err = block_allocator.free(block);
+        assert(err.is_ok());
+    }
+
+    region.free_bytes -= size;
+    free_bytes -= size;
+}
+
+/// Finds and carves out a free range using the current policy. The range is not recorded as an
+/// allocation. Returns 0 if nothing fits.
+static paddr_t
+take_range(size_t size, size_t alignment)
+{
+    for (size_t i = 0; i < region_count; i++) {
+        memory_region& region = regions[i];
+        if (region.free_bytes < size) {
+            continue;
+        }
+
+        for (memory_block& block : region.free_blocks) {
+            paddr_t aligned_base = align_up(block.base, alignment);
+            if (aligned_base + size > block.base + block.length) [[likely]] {
+                continue;
+            }
+            carve_block(region, &block, aligned_base, size);
+            return aligned_base;
+        }
+    }
+    return 0;
+}
+
+/// Keeps the memory_block slab allocator stocked by feeding it pages taken straight from the free
+/// lists. These pages are never returned.
+static void
+refill_block_allocator()
+{
+    if (block_allocator.free_count() >= BLOCK_REFILL_THRESHOLD) [[likely]] {
+        return;
+    }
+    paddr_t page = take_range(riscv::paging::PAGE_SIZE, riscv::paging::PAGE_SIZE);
+    assert(page != 0, "pmm: out of memory while refilling the memory_block allocator");
+    block_allocator.grow(limine::hhdm_phys_to_virt(page), riscv::paging::PAGE_SIZE);
+}
+
 error
 alloc_aligned(size_t size, size_t alignment, paddr_t* ret)
 {
-    size = align_up(size, riscv::sv39::PAGE_SIZE);
+    size = align_up(size, riscv::paging::PAGE_SIZE);
     if (ret == nullptr) {
         return ErrorCode::NULL_ARGUMENT;
     }
-    if (alignment < riscv::sv39::PAGE_SIZE || (alignment & (alignment - 1)) != 0) {
+    if (alignment < riscv::paging::PAGE_SIZE || (alignment & (alignment - 1)) != 0) {
         *ret = 0;
         return ErrorCode::PMM_BAD_ALIGN;
     }
@@ -126,68 +227,28 @@ alloc_aligned(size_t size, size_t alignment, paddr_t* ret)
         return ErrorCode::PMM_OUT_OF_MEM;
     }
 
-    // Check if we need to fill up the memory_block allocator
-    if (block_allocator.free_count() < 16) {
-        todo("memory_block slab allocator is out of memory!!! Need to implement refilling!!!");
-    }
+    refill_block_allocator();
 
     if (pol != Policy::FIRST_FIT) {
         todo("policy: ", pol, " is not implemented");
     }
 
-    for (size_t i = 0; i < region_count; i++) {
-        memory_region& region = regions[i];
-        if (region.free_bytes < size) {
-            continue;
-        }
-
-        memory_block* curr = region.free_blocks;
-        memory_block* prev = nullptr;
-        while (curr != nullptr) {
-            size_t curr_base = curr->base;
-            size_t curr_len = curr->length;
-            size_t aligned_base = align_up(curr_base, alignment);
-            if (curr_base + curr_len < aligned_base + size) [[likely]] {
-                prev = curr;
-                curr = curr->next;
-            }
-
-            size_t offset = aligned_base - curr_base;
-            bool EXISTS_PRECEEDING = curr_base != aligned_base;
-            bool EXISTS_POSTCEEDING = curr_base + curr_len > aligned_base + size;
-            if (EXISTS_PRECEEDING && EXISTS_POSTCEEDING) {
-                // Need a new block
-                curr->length = offset;
-                memory_block* extra = block_allocator.alloc();
-                assert(extra != nullptr);
-                extra->base = aligned_base + size;
-                extra->length = curr_base + curr_len - (aligned_base + size);
-                extra->next = curr->next;
-            } else if (EXISTS_PRECEEDING) {
-                curr->length = offset;
-            } else if (EXISTS_POSTCEEDING) {
-                curr->base = aligned_base + size;
-                curr->length = curr_base + curr_len - (aligned_base + size);
-            } else if (prev == nullptr) {
-                region.free_blocks = curr->next;
-            } else {
-                prev->next = curr->next;
-                error err = block_allocator.free(curr);
-                assert(err.is_ok());
-            }
-
-            region.free_bytes -= size;
-            free_bytes -= size;
-            *ret = aligned_base;
-
-            // Zero out the page being given out.
-            mem::fill(reinterpret_cast<void*>(aligned_base), 0, size);
-            return ErrorCode::SUCCESS;
-        }
+    paddr_t base = take_range(size, alignment);
+    if (base == 0) {
+        *ret = 0;
+        return ErrorCode::PMM_OUT_OF_MEM;
     }
 
-    *ret = 0;
-    return ErrorCode::PMM_OUT_OF_MEM;
+    memory_block* record = block_allocator.alloc();
+    assert(record != nullptr);
+    record->base = base;
+    record->length = size;
+    allocated.insert(record);
+
+    // Zero out the page being given out.
+    mem::fill(limine::hhdm_phys_to_virt(base), 0, size);
+    *ret = base;
+    return ErrorCode::SUCCESS;
 }
 
 paddr_t
@@ -202,20 +263,59 @@ alloc_aligned_noerr(size_t size, size_t alignment)
 error
 alloc(size_t size, paddr_t* ret)
 {
-    return alloc_aligned(size, riscv::sv39::PAGE_SIZE, ret);
+    return alloc_aligned(size, riscv::paging::PAGE_SIZE, ret);
 }
 
 paddr_t
 alloc_noerr(size_t size)
 {
-    return alloc_aligned_noerr(size, riscv::sv39::PAGE_SIZE);
+    return alloc_aligned_noerr(size, riscv::paging::PAGE_SIZE);
 }
 
 error
 free(paddr_t ret)
 {
-    (void)ret;
-    fmt::println("Need to implement the pmm free function.");
+    memory_block* record = allocated.find(ret);
+    if (record == nullptr) {
+        return ErrorCode::PMM_NOT_ALLOCATED;
+    }
+    allocated.remove(record);
+
+    memory_region* region = nullptr;
+    for (size_t i = 0; i < region_count; i++) {
+        if (regions[i].base <= ret && ret < regions[i].base + regions[i].length) {
+            region = &regions[i];
+            break;
+        }
+    }
+    assert(region != nullptr);
+    size_t length = record->length;
+
+    // The record becomes a free block again, merged with its neighbours where they touch.
+    memory_block* next = region->free_tree.lower_bound(ret);
+    memory_block* prev = (next != nullptr) ? region->free_blocks.prev(next)
+                                           : region->free_blocks.back();
+    memory_block* merged;
+    if (prev != nullptr && prev->base + prev->length == ret) {
+        prev->length += length;
+        merged = prev;
+        error err = block_allocator.free(record);
+        assert(err.is_ok());
+    } else {
+        region->free_blocks.insert_before(next, record);
+        region->free_tree.insert(record);
+        merged = record;
+    }
+    if (next != nullptr && merged->base + merged->length == next->base) {
+        merged->length += next->length;
+        region->free_blocks.remove(next);
+        region->free_tree.remove(next);
+        error err = block_allocator.free(next);
+        assert(err.is_ok());
+    }
+
+    region->free_bytes += length;
+    free_bytes += length;
     return ErrorCode::SUCCESS;
 }
 
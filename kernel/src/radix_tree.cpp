@@ -0,0 +1,43 @@
+#include <allocators/slab.h>
+#include <fmt/assert.h>
+#include <limine/platform_info.h>
+#include <pmm.h>
+#include <riscv/paging.h>
+#include <types/radix_tree.h>
+
+namespace radix_details {
+
+/// Nodes of every radix tree come from this allocator. Its memory is never returned to the pmm.
+slab_alloc<node> node_allocator = {};
+/// Amount of memory the node allocator grows by. The slab walks its regions linearly, so it grows
+/// in large chunks rather than single pages.
+constexpr size_t NODE_CHUNK_SIZE = 16 * riscv::paging::PAGE_SIZE;
+
+node*
+alloc_node(u8 shift)
+{
+    node* n = node_allocator.alloc();
+    if (n == nullptr) {
+        paddr_t chunk;
+        error err = pmm::alloc(NODE_CHUNK_SIZE, &chunk);
+        if (err.is_err()) {
+            return nullptr;
+        }
+        node_allocator.grow(limine::hhdm_phys_to_virt(chunk), NODE_CHUNK_SIZE);
+        n = node_allocator.alloc();
+    }
+
+    // The slab hands out zeroed memory, so every slot is already empty.
+    n->shift = shift;
+    n->count = 0;
+    return n;
+}
+
+void
+free_node(node* n)
+{
+    error err = node_allocator.free(n);
+    assert(err.is_ok());
+}
+
+} // namespace radix_details
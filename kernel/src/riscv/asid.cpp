@@ -0,0 +1,111 @@
+#include <limine/platform_info.h>
+#include <riscv/asid.h>
+#include <riscv/csr.h>
+#include <riscv/paging.h>
+#include <types/bitmap.h>
+#include <types/number.h>
+
+namespace riscv {
+
+namespace {
+
+constexpr size_t SATP_ASID_SHIFT = 44;
+constexpr size_t SATP_MAX_ASID_BITS = 16;
+constexpr u64 SATP_ASID_MASK = ((1ULL << SATP_MAX_ASID_BITS) - 1) << SATP_ASID_SHIFT;
+
+/// ASID 0 is never handed out: it is what the kernel table runs with, and a context of 0 must
+/// never look current.
+constexpr u64 RESERVED_ASID = 0;
+
+size_t s_asid_bits = 0;
+/// Number of implemented ASIDs, 1 << s_asid_bits.
+u64 s_asid_count = 1;
+/// The current generation, in the bits above the ASID. It never is 0, so neither is a context.
+u64 s_generation = 1;
+/// The ASIDs handed out in the current generation.
+bitmap<1 << SATP_MAX_ASID_BITS> s_used;
+/// Where the search for a free ASID resumes.
+size_t s_next = 1;
+
+/// Starts a new generation, in which every ASID is free again. The caller must flush the TLB once
+/// the new ASID is in `satp`: flushing earlier would let the hart refill entries tagged with the
+/// outgoing ASID, which the new generation may hand to someone else.
+void
+new_generation()
+{
+    s_generation += s_asid_count;
+    s_used.clear_all();
+    s_used.set(RESERVED_ASID);
+    s_next = 1;
+}
+
+/// Returns a context of the current generation with an ASID nobody else has in it. Sets
+/// `*rolled_over` if it had to start a new generation.
+u64
+allocate_context(bool* rolled_over)
+{
+    size_t asid = s_used.find_next_zero(s_next);
+    if (asid >= s_asid_count) {
+        asid = s_used.find_next_zero(1);
+    }
+    *rolled_over = asid >= s_asid_count;
+    if (*rolled_over) {
+        new_generation();
+        asid = s_used.find_next_zero(1);
+    }
+    s_used.set(asid);
+    s_next = asid + 1;
+    return s_generation | asid;
+}
+
+} // namespace
+
+void
+initialize_asids()
+{
+    u64 satp = csrr<csr::satp>();
+    csrw<csr::satp>(satp | SATP_ASID_MASK);
+    u64 asids = (csrr<csr::satp>() & SATP_ASID_MASK) >> SATP_ASID_SHIFT;
+    csrw<csr::satp>(satp);
+
+    // The field is WARL and implementations keep its low bits, so the ones that stuck are a prefix.
+    s_asid_bits = 0;
+    while (s_asid_bits < SATP_MAX_ASID_BITS && ((asids >> s_asid_bits) & 1) != 0) s_asid_bits++;
+    s_asid_count = 1ULL << s_asid_bits;
+    s_generation = s_asid_count;
+    s_used.clear_all();
+    s_used.set(RESERVED_ASID);
+    s_next = 1;
+}
+
+size_t
+asid_bits()
+{
+    return s_asid_bits;
+}
+
+void
+switch_address_space(address_space* space)
+{
+    paddr_t root = limine::hhdm_virt_to_phys(space->root);
+    if (s_asid_count <= 1) {
+        // Everything runs with ASID 0, so the previous address space's entries have to go.
+        csrw<csr::satp>(paging::SATP_MODE | (root >> 12));
+        paging::flush_tlb_all();
+        return;
+    }
+
+    bool rolled_over = false;
+    if ((space->context & ~(s_asid_count - 1)) != s_generation) {
+        space->context = allocate_context(&rolled_over);
+    }
+    u64 asid = space->context & (s_asid_count - 1);
+    csrw<csr::satp>(paging::SATP_MODE | asid << SATP_ASID_SHIFT | (root >> 12));
+    // Otherwise the ASID is either the one `space` already had, whose entries are its own, or one
+    // unused since the last full flush, which the TLB holds nothing for.
+    if (rolled_over) {
+        paging::flush_tlb_all();
+    }
+}
+
+} // namespace riscv
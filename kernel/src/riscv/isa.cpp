@@ -0,0 +1,115 @@
+#include <riscv/isa.h>
+
+// The CSR accessors only exist in the kernel itself. Host builds (see kernel/host) only get the
+// device tree parsing.
+#if defined(__riscv)
+#include <riscv/csr.h>
+#endif
+
+namespace riscv {
+
+namespace {
+
+bool
+equals(str_view lhs, str_view rhs)
+{
+    return str_view::compare(lhs, rhs) == 0;
+}
+
+/// Returns the bit of the extension called `name`, or 0 if the kernel has no use for it.
+u32
+extension_bit(str_view name)
+{
+    if (equals(name, "zbb")) {
+        return ISA_ZBB;
+    }
+    if (equals(name, "v")) {
+        return ISA_V;
+    }
+    return 0;
+}
+
+/// Returns true if `c` starts a multi-letter extension (supervisor, custom or standard `z*`).
+bool
+starts_multi_letter(char c)
+{
+    return c == 's' || c == 'x' || c == 'z';
+}
+
+/// Returns the mask of the extensions of one cpu node. `riscv,isa-extensions` supersedes the older
+/// `riscv,isa` when a node has both.
+u32
+cpu_isa_extensions(fdt::node cpu)
+{
+    fdt::property extensions = cpu.find_property("riscv,isa-extensions");
+    if (extensions) {
+        u32 mask = 0;
+        extensions.for_each_string([&](str_view name) { mask |= extension_bit(name); });
+        return mask;
+    }
+    fdt::property isa = cpu.find_property("riscv,isa");
+    return isa ? parse_isa_string(isa.as_string()) : 0;
+}
+
+} // namespace
+
+u32
+parse_isa_string(str_view isa)
+{
+    if (isa.length() < 4 || !equals(isa.substr(0, 2), "rv")) {
+        return 0;
+    }
+
+    // Single letter extensions come first, right after the base. Version numbers (`v1p0`) are
+    // made of digits and `p`, neither of which names an extension the kernel uses.
+    u32 mask = 0;
+    size_t i = 4;
+    for (; i < isa.length() && isa[i] != '_' && !starts_multi_letter(isa[i]); i++) {
+        mask |= extension_bit(isa.substr(i, 1));
+    }
+
+    // The first multi-letter extension may directly follow them, the others are separated by
+    // underscores.
+    while (i < isa.length()) {
+        size_t end = isa.find('_', i);
+        end = (end == str_view::s_sentinel) ? isa.length() : end;
+        mask |= extension_bit(isa.substr(i, end - i));
+        i = end + 1;
+    }
+    return mask;
+}
+
+u32
+common_isa_extensions(const fdt::blob& blob)
+{
+    fdt::node cpus = blob.find_path("/cpus");
+    if (!cpus) {
+        return 0;
+    }
+
+    u32 mask = ~u32(0);
+    bool found = false;
+    cpus.for_each_child([&](fdt::node child) {
+        // `/cpus` also holds nodes such as `cpu-map`, which aren't harts.
+        fdt::property type = child.find_property("device_type");
+        if (!type || !equals(type.as_string(), "cpu") || !child.is_enabled()) {
+            return;
+        }
+        mask &= cpu_isa_extensions(child);
+        found = true;
+    });
+    return found ? mask : 0;
+}
+
+#if defined(__riscv)
+
+void
+enable_vector_unit()
+{
+    constexpr u64 SSTATUS_VS_INITIAL = 1ULL << 9;
+    csrw<csr::sstatus>(csrr<csr::sstatus>() | SSTATUS_VS_INITIAL);
+}
+
+#endif
+
+} // namespace riscv
@@ -0,0 +1,708 @@
+#include <fmt/assert.h>
+#include <limine/platform_info.h>
+#include <riscv/paging.h>
+#include <riscv/table_pool.h>
+#include <types/error.h>
+#include <types/number.h>
+
+// The CSR accessors only exist in the kernel itself, host builds (see kernel/host) only get the
+// walks.
+#if defined(__riscv)
+#include <riscv/csr.h>
+#endif
+
+namespace riscv::paging {
+
+namespace {
+
+/// Returns the page table a non-leaf entry points to, through the hhdm.
+page_table*
+next_table(table_entry pte)
+{
+    return static_cast<page_table*>(limine::hhdm_phys_to_virt(pte.get_address()));
+}
+
+/// Points `pte`, an entry of `table`, at a new empty table.
+error
+add_table(page_table* table, table_entry* pte)
+{
+    page_table* child;
+    error err = table_pool::alloc(&child);
+    if (err.is_err())
+        return err;
+    *pte = table_entry(limine::hhdm_virt_to_phys(child), TableEntryFlags::TEF_VALID);
+    table_pool::entry_added(table);
+    return ErrorCode::SUCCESS;
+}
+
+/// Sets `pte`, an empty entry of `table`, to a leaf.
+void
+add_leaf(page_table* table, table_entry* pte, paddr_t pa, u64 flags)
+{
+    *pte = table_entry(pa, flags | TEF_VALID);
+    table_pool::entry_added(table);
+}
+
+/// Returns the table `pte`, an entry of `table`, points to, allocating it first if `pte` is empty.
+/// Fails with PAGING_MAP_EXISTS if `pte` is a leaf, a larger page covering the range below it.
+error
+get_or_alloc_table(page_table* table, table_entry* pte, page_table** next)
+{
+    if (!pte->is_valid()) {
+        error err = add_table(table, pte);
+        if (err.is_err())
+            return err;
+    } else if (pte->is_leaf()) {
+        return ErrorCode::PAGING_MAP_EXISTS;
+    }
+    *next = next_table(*pte);
+    return ErrorCode::SUCCESS;
+}
+
+/// Installs a leaf entry at `level` mapping `va` to `pa` below `table`, which is at `Level`,
+/// creating the tables in between as needed.
+template<int Level>
+error
+map_page(page_table* table, vaddr_t va, paddr_t pa, u64 flags, int level)
+{
+    table_entry& pte = (*table)[vpn(va, Level)];
+    if constexpr (Level > 0) {
+        if (Level != level) {
+            page_table* next;
+            error err = get_or_alloc_table(table, &pte, &next);
+            if (err.is_err())
+                return err;
+            return map_page<Level - 1>(next, va, pa, flags, level);
+        }
+    }
+
+    // For a superpage, a valid non-leaf entry is a table of smaller mappings in the way.
+    if (pte.is_valid())
+        return ErrorCode::PAGING_MAP_EXISTS;
+    add_leaf(table, &pte, pa, flags);
+    return ErrorCode::SUCCESS;
+}
+
+/// Checks the arguments of a single page mapping, then maps it in the `Levels` deep `root`.
+template<int Levels>
+error
+map_single_page(page_table* root, vaddr_t va, paddr_t pa, u64 flags, int level)
+{
+    size_t page_size = level_page_size(level);
+    if (!is_aligned(va, page_size) || !is_aligned(pa, page_size)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (!is_canonical(va, Levels)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+    // Without R or X the entry would read as a pointer to a table, and W alone is reserved.
+    if ((flags & (TEF_READ | TEF_EXECUTE)) == 0) {
+        return ErrorCode::PAGING_INVALID_FLAGS;
+    }
+    return map_page<Levels - 1>(root, va, pa, flags, level);
+}
+
+/// Collects the TLB flushes and table frees of a range operation so that they happen once, when
+/// it is done.
+struct range_batch
+{
+    /// Past this many changed leaves, one full flush is cheaper than flushing them one by one. The
+    /// same threshold Linux uses on RISC-V.
+    static constexpr size_t s_FLUSH_ALL_THRESHOLD = 64;
+
+    vaddr_t pages[s_FLUSH_ALL_THRESHOLD];
+    size_t n_pages = 0;
+    /// Emptied intermediate tables, linked through their first entry. They may still be cached by
+    /// the page walker until the flush, so they are only freed after it.
+    page_table* free_tables = nullptr;
+
+    void flush_later(vaddr_t va)
+    {
+        if (n_pages < s_FLUSH_ALL_THRESHOLD) {
+            pages[n_pages] = va;
+        }
+        n_pages++;
+    }
+
+    void free_later(page_table* table)
+    {
+        *reinterpret_cast<page_table**>(table) = free_tables;
+        free_tables = table;
+    }
+
+    void finish()
+    {
+        // A per-page sfence.vma only drops leaf entries, freed tables need the full flush.
+        if (n_pages > s_FLUSH_ALL_THRESHOLD || free_tables != nullptr) {
+            flush_tlb_all();
+        } else {
+            for (size_t i = 0; i < n_pages; i++) flush_tlb_page(pages[i]);
+        }
+        while (free_tables != nullptr) {
+            page_table* table = free_tables;
+            free_tables = *reinterpret_cast<page_table**>(table);
+            // The link was the only non-zero word, the pool wants the table clear.
+            (*table)[0] = NULL_TABLE_ENTRY;
+            table_pool::free(table);
+        }
+    }
+};
+
+/// Checks that [va, va + size) is a non-empty range of canonical addresses of the `Levels` deep
+/// mode that doesn't cross from one half of the address space to the other.
+template<int Levels>
+bool
+valid_range(vaddr_t va, size_t size)
+{
+    vaddr_t last = va + size - 1;
+    return size != 0 && last >= va && is_canonical(va, Levels) && is_canonical(last, Levels) &&
+           ((va ^ last) & (1ULL << (va_bits(Levels) - 1))) == 0;
+}
+
+/// Returns the bytes from `va` to the end of the entry covering it at `level`, at most `size`.
+size_t
+chunk_size(vaddr_t va, size_t size, int level)
+{
+    size_t page_size = level_page_size(level);
+    return num::min(page_size - (va & (page_size - 1)), size);
+}
+
+/// Replaces the superpage leaf `pte` at `level` with a table of the next smaller pages mapping the
+/// same range with the same flags.
+error
+split_leaf(table_entry* pte, int level)
+{
+    page_table* table;
+    error err = table_pool::alloc(&table);
+    if (err.is_err())
+        return err;
+
+    size_t child_size = level_page_size(level - 1);
+    for (size_t i = 0; i < TABLE_ENTRY_COUNT; i++) {
+        (*table)[i] = table_entry(pte->get_address() + i * child_size, pte->get_flags());
+    }
+    table_pool::set_entry_count(table, TABLE_ENTRY_COUNT);
+    *pte = table_entry(limine::hhdm_virt_to_phys(table), TableEntryFlags::TEF_VALID);
+    return ErrorCode::SUCCESS;
+}
+
+/// Maps [va, va + size), which lies within the span of `table` at `Level`, to `pa`. Entries that
+/// the range covers whole and both addresses are aligned for become leaves, the rest recurses into
+/// the next level. `*mapped` counts the bytes mapped so far.
+template<int Level>
+error
+map_walk(page_table* table,
+         vaddr_t va,
+         paddr_t pa,
+         size_t size,
+         u64 flags,
+         range_batch* batch,
+         size_t* mapped)
+{
+    constexpr size_t page_size = level_page_size(Level);
+    while (size != 0) {
+        size_t chunk = chunk_size(va, size, Level);
+        table_entry& pte = (*table)[vpn(va, Level)];
+        if (chunk == page_size && is_aligned(pa, page_size)) {
+            // For a superpage, a valid non-leaf entry is a table of smaller mappings in the way.
+            if (pte.is_valid())
+                return ErrorCode::PAGING_MAP_EXISTS;
+            add_leaf(table, &pte, pa, flags);
+            batch->flush_later(va);
+            *mapped += chunk;
+        } else if constexpr (Level > 0) {
+            page_table* next;
+            error err = get_or_alloc_table(table, &pte, &next);
+            if (err.is_err())
+                return err;
+            err = map_walk<Level - 1>(next, va, pa, chunk, flags, batch, mapped);
+            if (err.is_err())
+                return err;
+        }
+        va += chunk;
+        pa += chunk;
+        size -= chunk;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Maps [va, va + size), which lies within the span of `table` at `Level`, with small pages from
+/// `source`. `*mapped` counts the bytes mapped so far, which is also the offset of the next page.
+template<int Level>
+error
+map_pages_walk(page_table* table,
+               vaddr_t va,
+               size_t size,
+               u64 flags,
+               page_source source,
+               unmap_callback on_unmap,
+               void* context,
+               range_batch* batch,
+               size_t* mapped)
+{
+    while (size != 0) {
+        size_t chunk = chunk_size(va, size, Level);
+        table_entry& pte = (*table)[vpn(va, Level)];
+        if constexpr (Level == 0) {
+            paddr_t pa;
+            error err = source(*mapped, &pa, context);
+            if (err.is_err())
+                return err;
+            if (pte.is_valid()) {
+                // The page is the caller's until it's mapped, give it back as well.
+                if (on_unmap != nullptr)
+                    on_unmap(pa, PAGE_SIZE, context);
+                return ErrorCode::PAGING_MAP_EXISTS;
+            }
+            add_leaf(table, &pte, pa, flags);
+            batch->flush_later(va);
+            *mapped += PAGE_SIZE;
+        } else {
+            page_table* next;
+            error err = get_or_alloc_table(table, &pte, &next);
+            if (err.is_err())
+                return err;
+            err = map_pages_walk<Level - 1>(
+              next, va, chunk, flags, source, on_unmap, context, batch, mapped);
+            if (err.is_err())
+                return err;
+        }
+        va += chunk;
+        size -= chunk;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Unmaps [va, va + size), which lies within the span of `table` at `Level`, freeing the tables
+/// below it that become empty.
+template<int Level>
+error
+unmap_walk(page_table* table,
+           vaddr_t va,
+           size_t size,
+           range_batch* batch,
+           unmap_callback on_unmap,
+           void* context)
+{
+    constexpr size_t page_size = level_page_size(Level);
+    while (size != 0) {
+        size_t chunk = chunk_size(va, size, Level);
+        table_entry& pte = (*table)[vpn(va, Level)];
+        if (pte.is_valid() && pte.is_leaf() && chunk != page_size) {
+            error err = split_leaf(&pte, Level);
+            if (err.is_err())
+                return err;
+        }
+
+        if (!pte.is_valid()) {
+            // Holes are skipped.
+        } else if (pte.is_leaf()) {
+            if (on_unmap != nullptr)
+                on_unmap(pte.get_address(), page_size, context);
+            pte = NULL_TABLE_ENTRY;
+            table_pool::entry_removed(table);
+            batch->flush_later(va);
+        } else if constexpr (Level > 0) {
+            page_table* child = next_table(pte);
+            error err = unmap_walk<Level - 1>(child, va, chunk, batch, on_unmap, context);
+            if (err.is_err())
+                return err;
+            if (table_pool::entry_count(child) == 0) {
+                batch->free_later(child);
+                pte = NULL_TABLE_ENTRY;
+                table_pool::entry_removed(table);
+            }
+        }
+        va += chunk;
+        size -= chunk;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Sets the flags of the leaves in [va, va + size), which lies within the span of `table` at
+/// `Level`.
+template<int Level>
+error
+protect_walk(page_table* table, vaddr_t va, size_t size, u64 flags, range_batch* batch)
+{
+    constexpr size_t page_size = level_page_size(Level);
+    while (size != 0) {
+        size_t chunk = chunk_size(va, size, Level);
+        table_entry& pte = (*table)[vpn(va, Level)];
+        if (pte.is_valid() && pte.is_leaf() && chunk != page_size) {
+            error err = split_leaf(&pte, Level);
+            if (err.is_err())
+                return err;
+        }
+
+        if (!pte.is_valid()) {
+            // Holes are skipped.
+        } else if (pte.is_leaf()) {
+            pte = table_entry(pte.get_address(), flags | TEF_VALID);
+            batch->flush_later(va);
+        } else if constexpr (Level > 0) {
+            error err = protect_walk<Level - 1>(next_table(pte), va, chunk, flags, batch);
+            if (err.is_err())
+                return err;
+        }
+        va += chunk;
+        size -= chunk;
+    }
+    return ErrorCode::SUCCESS;
+}
+
+/// Returns the physical address `va` translates to below `table`, which is at `Level`, or
+/// ((paddr_t)-1).
+template<int Level>
+paddr_t
+translate(const page_table* table, vaddr_t va)
+{
+    const table_entry& pte = (*table)[vpn(va, Level)];
+    if (!pte.is_valid())
+        return static_cast<paddr_t>(-1);
+    if (pte.is_leaf())
+        return pte.get_address() | (va & (level_page_size(Level) - 1));
+    if constexpr (Level > 0) {
+        return translate<Level - 1>(next_table(pte), va);
+    }
+    // A level 0 entry that isn't a leaf is malformed.
+    return static_cast<paddr_t>(-1);
+}
+
+/// Returns the level 0 entry mapping `va` below `table`, which is at `Level`, or nullptr if a
+/// table on the way is missing or a superpage maps `va`.
+template<int Level>
+table_entry*
+find_small_page(page_table* table, vaddr_t va)
+{
+    table_entry& pte = (*table)[vpn(va, Level)];
+    if constexpr (Level == 0) {
+        return &pte;
+    } else {
+        if (!pte.is_valid() || pte.is_leaf())
+            return nullptr;
+        return find_small_page<Level - 1>(next_table(pte), va);
+    }
+}
+
+/// Clears every entry of `table`, which is at `Level`, and of the tables below it, handing the
+/// leaves to `on_unmap` and the tables to `batch`.
+template<int Level>
+void
+destroy_walk(page_table* table, range_batch* batch, unmap_callback on_unmap, void* context)
+{
+    for (size_t i = 0; i < TABLE_ENTRY_COUNT; i++) {
+        table_entry& pte = (*table)[i];
+        if (!pte.is_valid()) {
+            continue;
+        }
+        if (pte.is_leaf()) {
+            if (on_unmap != nullptr)
+                on_unmap(pte.get_address(), level_page_size(Level), context);
+        } else if constexpr (Level > 0) {
+            destroy_walk<Level - 1>(next_table(pte), batch, on_unmap, context);
+        }
+        pte = NULL_TABLE_ENTRY;
+    }
+    table_pool::set_entry_count(table, 0);
+    batch->free_later(table);
+}
+
+/// Returns the index of the first upper-half entry of a `Levels` deep root.
+template<int Levels>
+constexpr size_t
+kernel_half_start()
+{
+    return vpn(upper_half_base(Levels), Levels - 1);
+}
+
+/// Undoes the first pass of `pin_tables` over the entries [first, last) of `root`: the tables it
+/// added are still empty and unpinned, and go to `batch`. The tables that were there already have
+/// entries or a pin of their own, and stay.
+void
+drop_empty_tables(page_table* root, size_t first, size_t last, range_batch* batch)
+{
+    for (size_t i = first; i < last; i++) {
+        table_entry& pte = (*root)[i];
+        page_table* table = next_table(pte);
+        if (table_pool::entry_count(table) == 0) {
+            batch->free_later(table);
+            pte = NULL_TABLE_ENTRY;
+            table_pool::entry_removed(root);
+        }
+    }
+}
+
+} // namespace
+
+template<int Levels>
+error
+map_small_page(page_table* root, vaddr_t va, paddr_t pa, u64 flags)
+{
+    return map_single_page<Levels>(root, va, pa, flags, 0);
+}
+
+template<int Levels>
+error
+map_megapage(page_table* root, vaddr_t va, paddr_t pa, u64 flags)
+{
+    return map_single_page<Levels>(root, va, pa, flags, 1);
+}
+
+template<int Levels>
+error
+map_gigapage(page_table* root, vaddr_t va, paddr_t pa, u64 flags)
+{
+    return map_single_page<Levels>(root, va, pa, flags, 2);
+}
+
+template<int Levels>
+error
+map_range(page_table* root, vaddr_t va, paddr_t pa, size_t size, u64 flags)
+{
+    if (!is_aligned(va, PAGE_SIZE) || !is_aligned(pa, PAGE_SIZE) || !is_aligned(size, PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (size == 0) {
+        return ErrorCode::SUCCESS;
+    }
+    if (!valid_range<Levels>(va, size)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+    if ((flags & (TEF_READ | TEF_EXECUTE)) == 0) {
+        return ErrorCode::PAGING_INVALID_FLAGS;
+    }
+
+    range_batch batch;
+    size_t mapped = 0;
+    error err = map_walk<Levels - 1>(root, va, pa, size, flags, &batch, &mapped);
+    if (err.is_err() && mapped != 0) {
+        // The walk maps in address order, so what it did is the prefix of the range.
+        error undo = unmap_walk<Levels - 1>(root, va, mapped, &batch, nullptr, nullptr);
+        assert_err(undo);
+    }
+    batch.finish();
+    return err;
+}
+
+template<int Levels>
+error
+map_range(page_table* root,
+          vaddr_t va,
+          size_t size,
+          u64 flags,
+          page_source source,
+          unmap_callback on_unmap,
+          void* context)
+{
+    if (!is_aligned(va, PAGE_SIZE) || !is_aligned(size, PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (source == nullptr) {
+        return ErrorCode::NULL_ARGUMENT;
+    }
+    if (size == 0) {
+        return ErrorCode::SUCCESS;
+    }
+    if (!valid_range<Levels>(va, size)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+    if ((flags & (TEF_READ | TEF_EXECUTE)) == 0) {
+        return ErrorCode::PAGING_INVALID_FLAGS;
+    }
+
+    range_batch batch;
+    size_t mapped = 0;
+    error err = map_pages_walk<Levels - 1>(
+      root, va, size, flags, source, on_unmap, context, &batch, &mapped);
+    if (err.is_err() && mapped != 0) {
+        error undo = unmap_walk<Levels - 1>(root, va, mapped, &batch, on_unmap, context);
+        assert_err(undo);
+    }
+    batch.finish();
+    return err;
+}
+
+template<int Levels>
+error
+unmap_range(page_table* root, vaddr_t va, size_t size, unmap_callback on_unmap, void* context)
+{
+    if (!is_aligned(va, PAGE_SIZE) || !is_aligned(size, PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (size == 0) {
+        return ErrorCode::SUCCESS;
+    }
+    if (!valid_range<Levels>(va, size)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+
+    range_batch batch;
+    error err = unmap_walk<Levels - 1>(root, va, size, &batch, on_unmap, context);
+    batch.finish();
+    return err;
+}
+
+template<int Levels>
+error
+protect_range(page_table* root, vaddr_t va, size_t size, u64 flags)
+{
+    if (!is_aligned(va, PAGE_SIZE) || !is_aligned(size, PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (size == 0) {
+        return ErrorCode::SUCCESS;
+    }
+    if (!valid_range<Levels>(va, size)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+    if ((flags & (TEF_READ | TEF_EXECUTE)) == 0) {
+        return ErrorCode::PAGING_INVALID_FLAGS;
+    }
+
+    range_batch batch;
+    error err = protect_walk<Levels - 1>(root, va, size, flags, &batch);
+    batch.finish();
+    return err;
+}
+
+template<int Levels>
+paddr_t
+virt_to_phys(page_table* root, vaddr_t va)
+{
+    if (!is_canonical(va, Levels))
+        return static_cast<paddr_t>(-1);
+    return translate<Levels - 1>(root, va);
+}
+
+template<int Levels>
+error
+unmap_small_page(page_table* root, vaddr_t va, paddr_t* pa)
+{
+    if (!is_aligned(va, PAGE_SIZE)) {
+        return ErrorCode::PAGING_UNALIGNED_ADDR;
+    }
+    if (!is_canonical(va, Levels)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+
+    table_entry* pte = find_small_page<Levels - 1>(root, va);
+    if (pte == nullptr || !pte->is_valid())
+        return ErrorCode::PAGING_NOT_MAPPED;
+    if (pa != nullptr)
+        *pa = pte->get_address();
+
+    // The range walk also gives back the tables the page was the last entry of.
+    range_batch batch;
+    error err = unmap_walk<Levels - 1>(root, va, PAGE_SIZE, &batch, nullptr, nullptr);
+    batch.finish();
+    return err;
+}
+
+error
+create_root(page_table** root)
+{
+    return table_pool::alloc(root);
+}
+
+template<int Levels>
+error
+create_root(page_table** root, const page_table* kernel_root)
+{
+    error err = table_pool::alloc(root);
+    if (err.is_err())
+        return err;
+    u32 count = 0;
+    for (size_t i = kernel_half_start<Levels>(); i < TABLE_ENTRY_COUNT; i++) {
+        (**root)[i] = (*kernel_root)[i];
+        count += (*kernel_root)[i].is_valid();
+    }
+    table_pool::set_entry_count(*root, count);
+    return ErrorCode::SUCCESS;
+}
+
+template<int Levels>
+error
+pin_tables(page_table* root, vaddr_t va, size_t size)
+{
+    if (size == 0) {
+        return ErrorCode::SUCCESS;
+    }
+    if (!valid_range<Levels>(va, size)) {
+        return ErrorCode::PAGING_INVALID_RANGE;
+    }
+
+    // Every table is in place before the first pin, so a failure has no pins to take back.
+    size_t first = vpn(va, Levels - 1);
+    size_t last = vpn(va + size - 1, Levels - 1);
+    for (size_t i = first; i <= last; i++) {
+        page_table* table;
+        error err = get_or_alloc_table(root, &(*root)[i], &table);
+        if (err.is_err()) {
+            range_batch batch;
+            drop_empty_tables(root, first, i, &batch);
+            batch.finish();
+            return err;
+        }
+    }
+    for (size_t i = first; i <= last; i++) {
+        table_pool::pin(next_table((*root)[i]));
+    }
+    return ErrorCode::SUCCESS;
+}
+
+template<int Levels>
+void
+destroy_root(page_table* root, unmap_callback on_unmap, void* context)
+{
+    // Dropping the kernel's entries leaves the walk only the lower half, which is this root's own.
+    for (size_t i = kernel_half_start<Levels>(); i < TABLE_ENTRY_COUNT; i++) {
+        (*root)[i] = NULL_TABLE_ENTRY;
+    }
+    range_batch batch;
+    destroy_walk<Levels - 1>(root, &batch, on_unmap, context);
+    batch.finish();
+}
+
+// Every mode is instantiated, so all of them keep building whichever one the kernel runs in.
+#define INSTANTIATE_PAGING(levels)                                                                 \
+    template error map_small_page<levels>(page_table*, vaddr_t, paddr_t, u64);                     \
+    template error map_megapage<levels>(page_table*, vaddr_t, paddr_t, u64);                       \
+    template error map_gigapage<levels>(page_table*, vaddr_t, paddr_t, u64);                       \
+    template error map_range<levels>(page_table*, vaddr_t, paddr_t, size_t, u64);                  \
+    template error map_range<levels>(                                                              \
+      page_table*, vaddr_t, size_t, u64, page_source, unmap_callback, void*);                      \
+    template error unmap_range<levels>(page_table*, vaddr_t, size_t, unmap_callback, void*);       \
+    template error protect_range<levels>(page_table*, vaddr_t, size_t, u64);                       \
+    template paddr_t virt_to_phys<levels>(page_table*, vaddr_t);                                   \
+    template error unmap_small_page<levels>(page_table*, vaddr_t, paddr_t*);                       \
+    template error create_root<levels>(page_table**, const page_table*);                           \
+    template error pin_tables<levels>(page_table*, vaddr_t, size_t);                               \
+    template void destroy_root<levels>(page_table*, unmap_callback, void*);
+
+INSTANTIATE_PAGING(3)
+INSTANTIATE_PAGING(4)
+INSTANTIATE_PAGING(5)
+
+#undef INSTANTIATE_PAGING
+
+#if defined(__riscv)
+
+page_table*
+current_page_table()
+{
+    u64 satp = csrr<csr::satp>();
+    u64 ppn = satp & 0x0FFFFFFFFFFF;
+    return static_cast<page_table*>(limine::hhdm_phys_to_virt(ppn << 12));
+}
+
+void
+switch_page_table(page_table* root)
+{
+    paddr_t pa = limine::hhdm_virt_to_phys(root);
+    csrw<csr::satp>(SATP_MODE | (pa >> 12));
+    flush_tlb_all();
+}
+
+#endif
+}
@@ -0,0 +1,178 @@
+#include <fmt/assert.h>
+#include <limine/platform_info.h>
+#include <pmm.h>
+#include <riscv/paging.h>
+#include <riscv/table_pool.h>
+#include <types/number.h>
+
+namespace riscv::paging::table_pool {
+
+namespace {
+
+/// The first page of a chunk.
+struct chunk_header
+{
+    /// Chunks with free tables, a doubly linked list so that any chunk can leave it in O(1).
+    chunk_header* next;
+    chunk_header* prev;
+    /// Bit i is set if page i is free. The header's own bit is never set.
+    u64 free_mask;
+    /// Valid entries in each page in use, and PINNED for the pinned ones.
+    u16 entry_counts[CHUNK_PAGES];
+};
+static_assert(CHUNK_PAGES == 64, "free_mask holds one bit per page");
+static_assert(sizeof(chunk_header) <= PAGE_SIZE);
+
+/// Every page of a chunk but the header.
+constexpr u64 ALL_TABLES = ~1ULL;
+
+/// Flag of `entry_counts` marking a pinned table, above the count itself.
+constexpr u16 PINNED = 0x8000;
+
+chunk_header* s_partial_chunks = nullptr;
+size_t s_free_tables = 0;
+
+chunk_header*
+chunk_of(const page_table* table)
+{
+    vaddr_t base = align_down(reinterpret_cast<vaddr_t>(table), CHUNK_SIZE);
+    return reinterpret_cast<chunk_header*>(base);
+}
+
+size_t
+index_of(const page_table* table)
+{
+    return (reinterpret_cast<vaddr_t>(table) & (CHUNK_SIZE - 1)) / PAGE_SIZE;
+}
+
+void
+link(chunk_header* chunk)
+{
+    chunk->prev = nullptr;
+    chunk->next = s_partial_chunks;
+    if (s_partial_chunks != nullptr)
+        s_partial_chunks->prev = chunk;
+    s_partial_chunks = chunk;
+}
+
+void
+unlink(chunk_header* chunk)
+{
+    if (chunk->prev != nullptr)
+        chunk->prev->next = chunk->next;
+    else
+        s_partial_chunks = chunk->next;
+    if (chunk->next != nullptr)
+        chunk->next->prev = chunk->prev;
+}
+
+error
+add_chunk()
+{
+    paddr_t pa;
+    error err = pmm::alloc_aligned(CHUNK_SIZE, CHUNK_SIZE, &pa);
+    if (err.is_err())
+        return err.push(ErrorCode::PAGING_ALLOC_FAILED);
+
+    // The pmm hands the chunk out zeroed, which makes the header empty and every table clear.
+    auto* chunk = static_cast<chunk_header*>(limine::hhdm_phys_to_virt(pa));
+    chunk->free_mask = ALL_TABLES;
+    link(chunk);
+    s_free_tables += CHUNK_PAGES - 1;
+    return ErrorCode::SUCCESS;
+}
+
+} // namespace
+
+error
+alloc(page_table** table)
+{
+    if (s_partial_chunks == nullptr) {
+        error err = add_chunk();
+        if (err.is_err())
+            return err;
+    }
+
+    chunk_header* chunk = s_partial_chunks;
+    size_t index = num::count_trailing_zeros(chunk->free_mask);
+    chunk->free_mask &= ~(1ULL << index);
+    chunk->entry_counts[index] = 0;
+    if (chunk->free_mask == 0)
+        unlink(chunk);
+    s_free_tables--;
+
+    *table = reinterpret_cast<page_table*>(reinterpret_cast<u8*>(chunk) + index * PAGE_SIZE);
+    return ErrorCode::SUCCESS;
+}
+
+void
+free(page_table* table)
+{
+    chunk_header* chunk = chunk_of(table);
+    size_t index = index_of(table);
+    assert(index != 0 && (chunk->free_mask & (1ULL << index)) == 0, "table_pool: bad free");
+    assert(chunk->entry_counts[index] == 0, "table_pool: freeing a table still in use");
+
+    if (chunk->free_mask == 0)
+        link(chunk);
+    chunk->free_mask |= 1ULL << index;
+    s_free_tables++;
+
+    // Keep one chunk around so that a table freed and allocated again doesn't bounce to the pmm.
+    if (chunk->free_mask == ALL_TABLES && s_free_tables > CHUNK_PAGES - 1) {
+        unlink(chunk);
+        s_free_tables -= CHUNK_PAGES - 1;
+        // The header is the only part that isn't zero, and the pmm zeroes on allocation anyway.
+        error err = pmm::free(limine::hhdm_virt_to_phys(chunk));
+        assert_err(err);
+    }
+}
+
+/// Returns what `entry_count` reports for the `entry_counts` value `count`.
+u32
+reported_count(u16 count)
+{
+    return (count & ~PINNED) + ((count & PINNED) != 0);
+}
+
+u32
+entry_count(const page_table* table)
+{
+    return reported_count(chunk_of(table)->entry_counts[index_of(table)]);
+}
+
+void
+entry_added(page_table* table)
+{
+    u16& count = chunk_of(table)->entry_counts[index_of(table)];
+    assert((count & ~PINNED) < TABLE_ENTRY_COUNT);
+    count++;
+}
+
+u32
+entry_removed(page_table* table)
+{
+    u16& count = chunk_of(table)->entry_counts[index_of(table)];
+    assert((count & ~PINNED) > 0);
+    return reported_count(--count);
+}
+
+void
+pin(page_table* table)
+{
+    chunk_of(table)->entry_counts[index_of(table)] |= PINNED;
+}
+
+void
+set_entry_count(page_table* table, u32 count)
+{
+    chunk_of(table)->entry_counts[index_of(table)] = static_cast<u16>(count);
+}
+
+size_t
+free_tables()
+{
+    return s_free_tables;
+}
+
+} // namespace riscv::paging::table_pool
@@ -0,0 +1,117 @@
+#include <types/error.h>
+
+// The table is only ever read on error paths, so it lives here once instead of in every
+// translation unit that includes error.h. Without ENABLE_ERROR_STRINGS only the code names are
+// kept, which drops the descriptions from the kernel image.
+#if defined(ENABLE_ERROR_STRINGS)
+#define ERROR_STRING(code, description) [static_cast<u8>(ErrorCode::code)] = #code ": " description
+#else
+#define ERROR_STRING(code, description) [static_cast<u8>(ErrorCode::code)] = #code
+#endif
+
+static const str_view error_strings[] = {
+    ERROR_STRING(SUCCESS, "No error."),
+    ERROR_STRING(NOT_IMPLEMENTED, "This function has not been implemented."),
+    ERROR_STRING(NULL_ARGUMENT, "Pointer argument to function was NULL."),
+    ERROR_STRING(SLAB_REGION_TOO_SMALL,
+                 "Region added to slab_alloc is too small to allocate a block from."),
+    ERROR_STRING(SLAB_BAD_ALIGN, "Region added to slab_alloc is not aligned properly."),
+    ERROR_STRING(SLAB_NOT_OWNED, "Object returned to slab_alloc was not allocated from it."),
+
+    ERROR_STRING(LIMINE_REQUEST_ERROR, "Limine requests failed."),
+
+    ERROR_STRING(PMM_REGION_TOO_SMALL,
+                 "Added a region that was smaller than system BASE_PAGE_SIZE."),
+    ERROR_STRING(PMM_REGION_LIST_FULL, "Region list is full, can't add more regions."),
+    ERROR_STRING(PMM_REGION_MANAGED, "Added a region that was already being managed."),
+    ERROR_STRING(PMM_REGION_NOT_MANAGED, "Removed a region that was not being managed."),
+    ERROR_STRING(PMM_BAD_ALIGN,
+                 "Alignment must be a power of two and at least system BASE_PAGE_SIZE."),
+    ERROR_STRING(PMM_OUT_OF_MEM,
+                 "There is not enough free memory to satisfy the allocation request."),
+    ERROR_STRING(PMM_NOT_ALLOCATED, "Freed an address that isn't the base of a live allocation."),
+
+    ERROR_STRING(ELF_MAGIC_NUMBER,
+                 "Invalid magic number found in file header, file may not be an ELF file."),
+    ERROR_STRING(ELF_CLASS_32BIT,
+                 "System only supports 64-bit ELF files, but a 32-bit ELF file was found."),
+    ERROR_STRING(ELF_ENDIANNESS, "System only supports little-endian ELF files."),
+    ERROR_STRING(ELF_WRONG_VERSION, "ELF file is compiled with non-current ELF version."),
+    ERROR_STRING(ELF_NON_SYSVABI, "ELF file is compiled with an ABI that isn't System-V."),
+    ERROR_STRING(ELF_WRONG_ABI_VERSION, "Elf file was not compiled for System-V version 3."),
+    ERROR_STRING(ELF_UNSUPPORTED_TYPE,
+                 "Elf file type is not one-of: { Relocatable, Executable, SharedObject, "
+                 "CoreDump }."),
+    ERROR_STRING(ELF_UNSUPPORTED_MACHINE, "Elf file was not compiled for RISC-V."),
+
+    ERROR_STRING(PAGING_UNALIGNED_ADDR,
+                 "Attempted to install a page table with an unaligned vaddr_t or paddr_t."),
+    ERROR_STRING(PAGING_ALLOC_FAILED,
+                 "Physical paging allocation for intermediate page table failed."),
+    ERROR_STRING(PAGING_MAP_EXISTS, "Attempted to install a mapping where one already exists."),
+    ERROR_STRING(PAGING_NOT_MAPPED, "Attempted to remove a mapping that doesn't exist."),
+    ERROR_STRING(PAGING_INVALID_FLAGS,
+                 "Attempted to install a leaf mapping that is neither readable nor executable."),
+    ERROR_STRING(PAGING_INVALID_RANGE,
+                 "Attempted to map a range that isn't within one half of the address space."),
+
+    ERROR_STRING(KVSPACE_OUT_OF_SPACE,
+                 "There is not enough kernel virtual address space left to reserve the region."),
+    ERROR_STRING(KVSPACE_BAD_ALIGN,
+                 "Attempted to reserve kernel virtual address space with a bad alignment."),
+    ERROR_STRING(KVSPACE_NOT_RESERVED,
+                 "Attempted to release kernel virtual address space that isn't reserved."),
+
+    ERROR_STRING(DYN_ARR_REALLOC_FAILURE, "Failed to grow a dynamic array."),
+    ERROR_STRING(DYN_ARR_ALLOC_FAILURE, "Failed to allocate initial memory for dynamic array."),
+    ERROR_STRING(DYN_ARR_RESERVATION_FULL,
+                 "Dynamic array outgrew its reserved virtual address range."),
+
+    ERROR_STRING(RADIX_ALLOC_FAILED, "Failed to allocate memory for a radix tree node."),
+    ERROR_STRING(RADIX_INDEX_PRESENT,
+                 "Attempted to insert into a radix tree index that already holds a value."),
+
+    ERROR_STRING(DT_MAGIC_NUMBER,
+                 "The device tree blob magic number is invalid. Expected 0xD00DFEED."),
+    ERROR_STRING(DT_UNSUPPORTED_VERSION,
+                 "The device tree blob version is too old, at least version 17 is required."),
+    ERROR_STRING(DT_NO_NODES, "The parsed device tree blob was empty."),
+    ERROR_STRING(DT_MALFORMED,
+                 "The device tree blob is truncated, or its structure block is malformed."),
+    ERROR_STRING(DT_BAD_PROPERTY,
+                 "A device tree property value has the wrong length for its type."),
+    ERROR_STRING(DT_REWRITE_FAILED,
+                 "Failed to rewrite device tree properties, either due to an unsupported property "
+                 "type or a malformed DTB."),
+    ERROR_STRING(DT_INDEX_FAILED,
+                 "Failed to build the device tree phandle, path or compatible indexes."),
+    ERROR_STRING(DT_CACHE_INVALID, "The device tree cache image is malformed or truncated."),
+    ERROR_STRING(DT_CACHE_STALE,
+                 "The device tree cache image was built from a different device tree blob."),
+    ERROR_STRING(DT_CACHE_BUFFER_TOO_SMALL,
+                 "The buffer is too small to hold the device tree cache image."),
+    ERROR_STRING(DT_ADDRESS_CELLS_TOO_LARGE,
+                 "Failed to parse device tree, #address-cells property encountered with a value "
+                 "larger than 3."),
+    ERROR_STRING(DT_SIZE_CELLS_TOO_LARGE,
+                 "Failed to parse device tree, #size-cells property encountered with a value "
+                 "larger than 2."),
+    ERROR_STRING(DT_INTERRUPT_CELLS_TOO_LARGE,
+                 "Failed to parse device tree, #interrupt-cells property encountered with a value "
+                 "larger than 4."),
+    ERROR_STRING(DT_BAD_INTERRUPTS,
+                 "Failed to resolve device tree interrupts, an interrupts, interrupts-extended or "
+                 "interrupt-map property names a missing interrupt parent or is truncated."),
+};
+
+#undef ERROR_STRING
+
+static_assert(sizeof(error_strings) / sizeof(error_strings[0]) ==
+                static_cast<u8>(ErrorCode::ERROR_CODE_GUARD_VALUE),
+              "Error strings array must match the number of ErrorCode values.");
+
+str_view
+error_string(ErrorCode code)
+{
+    return error_strings[static_cast<u8>(code)];
+}